@@ -0,0 +1,190 @@
+#include "ConversionCache.h"
+
+#include <algorithm>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+#include "utils/DependencyChecker.h"
+#include "utils/FileUtils.h"
+
+
+ConversionCache::ConversionCache(const QString& directory, qint64 maxSize, QObject* parent)
+: QObject(parent), directory_(directory), maxSize_(maxSize), valid_(QDir().mkpath(directory))
+{
+    if (valid_) { loadEntries(); }
+}
+
+ConversionCache::~ConversionCache()
+{
+    // queued callbacks are dropped with this object but hashing threads have to end first
+    hashPool_.waitForDone();
+}
+
+void ConversionCache::computeKey(const QString& inputFilePath, const QStringList& keyArgs,
+                                 std::function<void(const QString& key)> callback)
+{
+    QFileInfo info(inputFilePath);
+    const QString path = info.absoluteFilePath();
+    const qint64 size = info.size();
+    const QDateTime modified = info.lastModified();
+
+    // callback is always called from event loop, also when hash is already known
+    auto it = hashedFiles_.constFind(path);
+    if (it != hashedFiles_.constEnd() && it->size == size && it->modified == modified) {
+        QString key = makeKey(it->hash, keyArgs);
+        QMetaObject::invokeMethod(this, [callback, key]() { callback(key); }, Qt::QueuedConnection);
+        return;
+    }
+
+    hashPool_.start([this, path, size, modified, keyArgs, callback]() {
+        QByteArray hash = hashFile(path);
+
+        QMetaObject::invokeMethod(this, [this, path, size, modified, hash, keyArgs, callback]() {
+            if (hash.isEmpty()) {
+                callback(QString());
+                return;
+            }
+            hashedFiles_.insert(path, {size, modified, hash});
+            callback(makeKey(hash, keyArgs));
+        }, Qt::QueuedConnection);
+    });
+}
+
+bool ConversionCache::restore(const QString& key, const QString& outputFilePath)
+{
+    QString entry = entryPath(key);
+    if (!valid_) { return false; }
+    if (!QFile::exists(entry)) {
+        forget(key);
+        return false;
+    }
+
+    // modification time tells when entry was used last. output is never a hardlink of the
+    // entry, so the time of outputs stays what probe cache and journal have seen
+    QFile file(entry);
+    if (file.open(QIODevice::ReadOnly)) {
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+        file.close();
+    }
+    touch(key, QFileInfo(entry).size());
+
+    return FileUtils::cloneOrCopy(entry, outputFilePath);
+}
+
+void ConversionCache::store(const QString& key, const QString& outputFilePath)
+{
+    QString entry = entryPath(key);
+    if (!valid_ || QFile::exists(entry)) { return; }
+    if (!QDir().mkpath(QFileInfo(entry).absolutePath())) { return; }
+
+    // entry appears at once so other converters never see half copied file. hardlink would let
+    // later in place edits of the output (metadata removal) change the entry too
+    QString temporary = entry + ".tmp";
+    if (!FileUtils::cloneOrCopy(outputFilePath, temporary)) {
+        QFile::remove(temporary);
+        return;
+    }
+    if (!QFile::rename(temporary, entry)) {
+        QFile::remove(temporary);
+        return;
+    }
+
+    touch(key, QFileInfo(entry).size());
+    evict();
+}
+
+QStringList ConversionCache::normalizeArgs(const QStringList& args, const QString& inputFilePath,
+                                           const QString& outputFilePath)
+{
+    // output suffix stays as ffmpeg picks the container from it
+    QString outputPlaceholder = "{output}." + QFileInfo(outputFilePath).suffix().toLower();
+
+    QStringList normalized;
+    for (const QString& arg : args) {
+        if (arg == inputFilePath) {
+            normalized << "{input}";
+        } else if (arg == outputFilePath) {
+            normalized << outputPlaceholder;
+        } else {
+            normalized << arg;
+        }
+    }
+    return normalized;
+}
+
+QString ConversionCache::entryPath(const QString& key) const
+{
+    // entries are spread to subfolders so single folder doesn't grow huge
+    return QDir(directory_).filePath(key.left(2) + "/" + key);
+}
+
+void ConversionCache::loadEntries()
+{
+    // modification times of earlier runs give the starting order
+    QVector<QFileInfo> found;
+    QDirIterator it(directory_, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QFileInfo info(it.next());
+        if (info.suffix() == "tmp") { continue; }
+        found.append(info);
+    }
+    std::sort(found.begin(), found.end(), [](const QFileInfo& a, const QFileInfo& b) {
+        return a.lastModified() < b.lastModified();
+    });
+    for (const QFileInfo& info : std::as_const(found)) {
+        touch(info.fileName(), info.size());
+    }
+}
+
+void ConversionCache::touch(const QString& key, qint64 size)
+{
+    forget(key);
+    entries_.insert(key, {size, ++lastUse_});
+    usedEntries_.insert(lastUse_, key);
+    totalSize_ += size;
+}
+
+void ConversionCache::forget(const QString& key)
+{
+    auto it = entries_.constFind(key);
+    if (it == entries_.constEnd()) { return; }
+    usedEntries_.remove(it->use);
+    totalSize_ -= it->size;
+    entries_.erase(it);
+}
+
+void ConversionCache::evict()
+{
+    // entry is dropped from index even if removing fails, other converter may have removed it
+    while (totalSize_ > maxSize_ && !usedEntries_.isEmpty()) {
+        const QString key = usedEntries_.first();
+        QFile::remove(entryPath(key));
+        forget(key);
+    }
+}
+
+QByteArray ConversionCache::hashFile(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) { return {}; }
+
+    QCryptographicHash hash(QCryptographicHash::Blake2b_256);
+    if (!hash.addData(&file)) { return {}; }
+    return hash.result();
+}
+
+QString ConversionCache::makeKey(const QByteArray& contentHash, const QStringList& keyArgs)
+{
+    QCryptographicHash hash(QCryptographicHash::Blake2b_256);
+    hash.addData(contentHash);
+    hash.addData(DependencyChecker::ffmpegVersion().toUtf8());
+    for (const QString& arg : keyArgs) {
+        hash.addData(QByteArrayView("\0", 1));
+        hash.addData(arg.toUtf8());
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
\ No newline at end of file
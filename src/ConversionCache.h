@@ -0,0 +1,80 @@
+#ifndef FORMAT_CONVERTER_CONVERSIONCACHE_H
+#define FORMAT_CONVERTER_CONVERSIONCACHE_H
+
+#include <functional>
+
+#include <QDateTime>
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+
+// on-disk cache of conversion outputs. key is a hash of input content, conversion arguments
+// (with paths replaced by placeholders) and ffmpeg version, so same conversion of same file
+// is served from the cache even if the file has moved. outputs are given back as reflinks when
+// filesystem allows it and copied otherwise, never hardlinked, so entries and outputs can be
+// changed independently. least recently used outputs are evicted over size limit
+class ConversionCache : public QObject {
+    Q_OBJECT
+
+public:
+
+    ConversionCache(const QString& directory, qint64 maxSize, QObject* parent = nullptr);
+    ~ConversionCache() override;
+
+    bool isValid() const { return valid_; }
+    QString directory() const { return directory_; }
+
+    // input is hashed in a worker thread, callback is called in this thread with the key.
+    // key is empty if input couldn't be read
+    void computeKey(const QString& inputFilePath, const QStringList& keyArgs,
+                    std::function<void(const QString& key)> callback);
+
+    // links cached output to outputFilePath, false if key isn't cached
+    bool restore(const QString& key, const QString& outputFilePath);
+    void store(const QString& key, const QString& outputFilePath);
+
+    // conversion arguments without file paths
+    static QStringList normalizeArgs(const QStringList& args, const QString& inputFilePath,
+                                     const QString& outputFilePath);
+
+private:
+
+    // same file isn't hashed again while its size and modification time stay the same
+    struct HashedFile {
+        qint64 size = 0;
+        QDateTime modified;
+        QByteArray hash;
+    };
+
+    // order in which entries were used, oldest first
+    struct Entry {
+        qint64 size = 0;
+        qint64 use = 0;
+    };
+
+    QString directory_;
+    qint64 maxSize_;
+    bool valid_;
+    QHash<QString, HashedFile> hashedFiles_;
+    QThreadPool hashPool_;
+
+    // index of entries by key is read from disk once, entries are evicted from it
+    QHash<QString, Entry> entries_;
+    QMap<qint64, QString> usedEntries_;
+    qint64 totalSize_ = 0;
+    qint64 lastUse_ = 0;
+
+    QString entryPath(const QString& key) const;
+    void loadEntries();
+    void touch(const QString& key, qint64 size);
+    void forget(const QString& key);
+    void evict();
+
+    static QByteArray hashFile(const QString& filePath);
+    static QString makeKey(const QByteArray& contentHash, const QStringList& keyArgs);
+};
+
+
+#endif //FORMAT_CONVERTER_CONVERSIONCACHE_H
\ No newline at end of file
@@ -1,6 +1,9 @@
 #include "Converter.h"
+#include "FormatRegistry.h"
 #include "utils/CommonEnums.h"
 #include "utils/ConverterArguments.h"
+#include "utils/DependencyChecker.h"
+#include "utils/FileUtils.h"
 #include "ProgressHandler.h"
 
 #include <iostream>
@@ -8,218 +11,1233 @@
 #include <QFileInfo>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QThread>
 
+#include <algorithm>
 
-Converter::Converter(QObject* parent) : QObject(parent)
+
+Converter::Converter(QObject* parent)
+: QObject(parent), maxWorkers_(QThread::idealThreadCount()), mediaProbe_(new MediaProbe(this))
+{
+    connect(mediaProbe_, &MediaProbe::probed, this, &Converter::probeFinished);
+    setDefaultEngine(Engine::DEFAULT);
+
+#ifdef FORMAT_CONVERTER_LIBAV
+    // engine signals come from worker threads and are queued to this thread
+    libavEngine_ = new LibavEngine(this);
+    connect(libavEngine_, &LibavEngine::progress, this, [this](int jobId, qint64 outTimeUs, qint64 totalSize) {
+        if (!libavJobs_.contains(jobId)) { return; }
+        if (ProgressHandler* progressHandler = progressHandlers_.value(jobId)) {
+            progressHandler->handleEngineProgress(outTimeUs, totalSize);
+        }
+    });
+    connect(libavEngine_, &LibavEngine::logMessage, this, [this](int jobId, const QString& message) {
+        if (libavJobs_.contains(jobId)) { logMessage(jobId, message); }
+    });
+    connect(libavEngine_, &LibavEngine::finished, this, &Converter::libavFinished);
+#endif
+    metadataStripper_ = new MetadataStripper(this);
+    connect(metadataStripper_, &MetadataStripper::finished, this, &Converter::stripperFinished);
+
+#ifdef FORMAT_CONVERTER_IMAGE_ENGINE
+    imageEngine_ = new ImageEngine(this);
+    connect(imageEngine_, &ImageEngine::finished, this, &Converter::imageFinished);
+#endif
+
+    // if error during run we log error message and end that job. cancelled job can still get
+    // errors from its process so those are ignored
+    connect(this, &Converter::error, this, [this](int jobId, const QString& message) {
+        auto it = jobs_.find(jobId);
+        if (it == jobs_.end() || it->isFinished()) { return; }
+        logMessage(jobId, message);
+        finishJob(jobId, false);
+    });
+}
+
+int Converter::runConverter(const QString& inputFilePath, const QString& outputFilePath, bool saveMetadata,
+                            Engine engine)
+{
+    ConversionJob job;
+    job.type = JobType::CONVERT;
+    job.inputFilePath = inputFilePath;
+    job.outputFilePath = outputFilePath;
+    job.saveMetadata = saveMetadata;
+    job.engine = engine;
+    job.profile = profile_;
+    job.priority = priority_;
+    return enqueueJob(job);
+}
+
+int Converter::runMetadataRemover(const QString& inputFilePath, const QString& outputFilePath)
+{
+    ConversionJob job;
+    job.type = JobType::REMOVE_METADATA;
+    job.inputFilePath = inputFilePath;
+    job.outputFilePath = outputFilePath;
+    job.priority = priority_;
+    return enqueueJob(job);
+}
+
+int Converter::runFanOut(const QString& inputFilePath, const QStringList& outputFilePaths, bool saveMetadata)
+{
+    ConversionJob job;
+    job.type = JobType::FAN_OUT;
+    job.inputFilePath = inputFilePath;
+    job.outputFilePath = outputFilePaths.value(0);
+    job.extraOutputFilePaths = outputFilePaths.mid(1);
+    job.saveMetadata = saveMetadata;
+    job.engine = Engine::PROCESS;
+    job.profile = profile_;
+    job.priority = priority_;
+    return enqueueJob(job);
+}
+
+int Converter::runLadder(const QString& inputFilePath, const QStringList& outputFilePaths,
+                         const QList<Rendition>& renditions, bool saveMetadata)
+{
+    ConversionJob job;
+    job.type = JobType::LADDER;
+    job.inputFilePath = inputFilePath;
+    job.outputFilePath = outputFilePaths.value(0);
+    job.extraOutputFilePaths = outputFilePaths.mid(1);
+    job.renditions = renditions;
+    job.saveMetadata = saveMetadata;
+    job.engine = Engine::PROCESS;
+    job.profile = profile_;
+    job.priority = priority_;
+    return enqueueJob(job);
+}
+
+int Converter::runJob(ConversionJob job)
+{
+    if (job.profile.isEmpty()) {
+        job.profile = profile_;
+    }
+    return enqueueJob(job);
+}
+
+QString Converter::renditionFilePath(const QString& outputFilePath, const Rendition& rendition)
+{
+    QFileInfo info(outputFilePath);
+    return info.dir().filePath(QString("%1_%2p.%3").arg(info.completeBaseName()).arg(rendition.height)
+                               .arg(info.suffix()));
+}
+
+void Converter::cancelJob(int jobId)
+{
+    auto it = jobs_.find(jobId);
+    if (it == jobs_.end() || it->isFinished()) { return; }
+
+    // queued job hasn't taken a worker yet
+    if (it->state == State::QUEUED) {
+        pendingJobs_.removeOne(jobId);
+        emit error(jobId, "Job cancelled!");
+        return;
+    }
+
+    // killed ffmpeg leaves partial output behind
+    if (SegmentedEncoder* encoder = segmentedEncoders_.take(jobId)) {
+        encoder->cancel();
+        encoder->deleteLater();
+        QFile::remove(it->outputFilePath);
+    }
+    if (QProcess* process = processes_.take(jobId)) {
+        process->kill();
+        if (it->type != JobType::REMOVE_METADATA) {
+            QFile::remove(it->outputFilePath);
+            for (const QString& extraOutputFilePath : std::as_const(it->extraOutputFilePaths)) {
+                QFile::remove(extraOutputFilePath);
+            }
+        }
+    }
+#ifdef FORMAT_CONVERTER_LIBAV
+    if (libavJobs_.remove(jobId)) {
+        libavEngine_->cancel(jobId);
+    }
+#endif
+    if (stripperJobs_.remove(jobId)) {
+        metadataStripper_->cancel(jobId);
+    }
+    // session can't drop a command it has started, output written after this is removed when
+    // the command ends. metadata removed in place has no partial output
+    if (exifToolCommands_.remove(jobId) && !it->finalOutputFilePath.isEmpty()) {
+        cancelledExifToolOutputs_.insert(jobId, it->outputFilePath);
+    }
+#ifdef FORMAT_CONVERTER_IMAGE_ENGINE
+    // engine removes output of cancelled image itself
+    if (imageJobs_.remove(jobId)) {
+        imageEngine_->cancel(jobId);
+    }
+#endif
+
+    // probe results of the job are ignored when they arrive
+    emit error(jobId, "Job cancelled!");
+}
+
+bool Converter::setCache(const QString& directory, qint64 maxSize)
+{
+    delete conversionCache_;
+    conversionCache_ = nullptr;
+    if (directory.isEmpty()) { return true; }
+
+    conversionCache_ = new ConversionCache(directory, maxSize, this);
+    if (!conversionCache_->isValid()) {
+        delete conversionCache_;
+        conversionCache_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool Converter::setProbeCache(const QString& filePath, QString* errorMessage)
+{
+    return mediaProbe_->setCacheFile(filePath, errorMessage);
+}
+
+bool Converter::setJournal(const QString& filePath, QString* errorMessage)
+{
+    journal_.reset();
+    if (filePath.isEmpty()) { return true; }
+
+    auto journal = std::make_unique<JobJournal>(filePath);
+    QString journalError;
+    if (!journal->open(&journalError)) {
+        if (errorMessage) { *errorMessage = journalError; }
+        return false;
+    }
+    journal_ = std::move(journal);
+    return true;
+}
+
+int Converter::resumeJournal()
+{
+    if (!journal_) { return 0; }
+
+    const QList<ConversionJob> unfinishedJobs = journal_->unfinishedJobs();
+    for (const ConversionJob& job : unfinishedJobs) {
+        enqueueJob(job);
+    }
+    return unfinishedJobs.size();
+}
+
+void Converter::setSegmentedEncoding(int segments, double minDuration)
+{
+    segments_ = segments;
+    segmentMinDuration_ = minDuration;
+}
+
+void Converter::setDefaultEngine(Engine engine)
+{
+    // image engine is only picked when no engine was asked for
+    engineChosen_ = engine != Engine::DEFAULT;
+    if (engine == Engine::DEFAULT) {
+#ifdef FORMAT_CONVERTER_LIBAV_DEFAULT
+        engine = Engine::LIBAV;
+#else
+        engine = Engine::PROCESS;
+#endif
+    }
+    defaultEngine_ = engine;
+}
+
+Engine Converter::jobEngine(const ConversionJob& job) const
+{
+    return job.engine == Engine::DEFAULT ? defaultEngine_ : job.engine;
+}
+
+bool Converter::isEngineAvailable(Engine engine)
+{
+#ifdef FORMAT_CONVERTER_LIBAV
+    Q_UNUSED(engine);
+    return true;
+#else
+    return engine != Engine::LIBAV;
+#endif
+}
+
+void Converter::setCpuAffinity(const QList<int>& cpus)
+{
+    cpus_ = cpus;
+
+    // probes and exiftool sessions are shared by jobs of every class so they only get the cores
+    mediaProbe_->setProcessPriority(sharedProcessPriority());
+    for (ExifToolSession* session : std::as_const(exifToolSessions_)) {
+        session->setProcessPriority(sharedProcessPriority());
+    }
+}
+
+ProcessPriority Converter::sharedProcessPriority() const
+{
+    ProcessPriority priority;
+    priority.cpus = cpus_;
+    return priority;
+}
+
+void Converter::setMaxWorkers(int maxWorkers)
+{
+    maxWorkers_ = qMax(1, maxWorkers);
+    startNextJobs();
+}
+
+int Converter::enqueueJob(ConversionJob job)
+{
+    job.id = nextJobId_++;
+    job.state = State::QUEUED;
+    jobs_.insert(job.id, job);
+
+    // job goes after every pending job of the same or more urgent class
+    auto next = std::find_if(pendingJobs_.begin(), pendingJobs_.end(), [this, &job](int pendingJobId) {
+        return jobs_.value(pendingJobId).priority > job.priority;
+    });
+    pendingJobs_.insert(next, job.id);
+    startStage(job.id);
+    if (journal_) { journal_->record(job, State::QUEUED); }
+
+    // probe result is ready when a worker takes the job
+    FileType outputType = FormatRegistry::fromPath(job.outputFilePath).fileType;
+    if (job.type != JobType::REMOVE_METADATA && (outputType == FileType::AUDIO || outputType == FileType::VIDEO)) {
+        mediaProbe_->prefetch(job.inputFilePath);
+    }
+
+    // jobs are started from event loop so caller always gets job id before any job signal
+    QMetaObject::invokeMethod(this, &Converter::startNextJobs, Qt::QueuedConnection);
+    return job.id;
+}
+
+void Converter::startNextJobs()
+{
+    while (runningJobs_ < maxWorkers_ && !pendingJobs_.isEmpty()) {
+        startJob(pendingJobs_.dequeue());
+    }
+}
+
+void Converter::startJob(int jobId)
+{
+    // copy as starting can finish the job and modify jobs_
+    ConversionJob job = jobs_.value(jobId);
+    runningJobs_++;
+    finishStage(jobId, "queue");
+    setJobState(jobId, State::RUNNING);
+    createProgressHandler(jobId);
+    emit jobStarted(jobId);
+
+    if (journal_ && journal_->isDone(job)) {
+        logMessage(jobId, "Output is already complete according to job journal, skipping");
+        finishJob(jobId, true);
+        return;
+    }
+
+    // output is written under hidden name and renamed when job succeeds, so a crash or kill
+    // never leaves partial file that looks complete
+    if (job.inputFilePath != job.outputFilePath) {
+        job.finalOutputFilePath = job.outputFilePath;
+        job.outputFilePath = FileUtils::partialFilePath(job.finalOutputFilePath);
+        jobs_[jobId].outputFilePath = job.outputFilePath;
+        jobs_[jobId].finalOutputFilePath = job.finalOutputFilePath;
+    }
+    if (!job.extraOutputFilePaths.isEmpty()) {
+        job.finalExtraOutputFilePaths = job.extraOutputFilePaths;
+        for (QString& extraOutputFilePath : job.extraOutputFilePaths) {
+            extraOutputFilePath = FileUtils::partialFilePath(extraOutputFilePath);
+        }
+        jobs_[jobId].extraOutputFilePaths = job.extraOutputFilePaths;
+        jobs_[jobId].finalExtraOutputFilePaths = job.finalExtraOutputFilePaths;
+    }
+    if (journal_) { journal_->record(job, State::RUNNING); }
+
+    switch (job.type) {
+        case JobType::CONVERT:          startConverter(job);        break;
+        case JobType::REMOVE_METADATA:  startMetadataRemover(job);  break;
+        case JobType::FAN_OUT:
+        case JobType::LADDER:           startMultiOutput(job);      break;
+    }
+}
+
+ProgressHandler* Converter::createProgressHandler(int jobId)
 {
+    ProgressHandler* progressHandler = new ProgressHandler(this);
+    progressHandlers_.insert(jobId, progressHandler);
+
     // passing progress handler signals to main window
-    connect(&progressHandler_, &ProgressHandler::updateProgress, this, &Converter::onUpdateProgress);
-    connect(&progressHandler_, &ProgressHandler::logMessage, this, &Converter::onLogMessage);
-    connect(&progressHandler_, &ProgressHandler::finished, this, &Converter::onFinished);
+    connect(progressHandler, &ProgressHandler::updateProgress, this, [this, jobId](int percent) {
+        auto it = jobs_.find(jobId);
+        if (it == jobs_.end() || it->isFinished()) { return; }
+        it->percent = percent;
+        emit jobProgress(jobId, percent);
+        updateOverallProgress();
 
-    // signal when full conversion is ended (example ffmpeg + exiftool encoding + metadata move)
-    connect(&progressHandler_, &ProgressHandler::allDone, this, &Converter::conversionEnded);
+        // output files are only read for their size while ffmpeg writes them
+        if (it->extraOutputFilePaths.isEmpty()) { return; }
+        emit jobOutputProgress(jobId, it->finalOutputFilePath, percent, QFileInfo(it->outputFilePath).size());
+        for (int i = 0; i < it->extraOutputFilePaths.size(); i++) {
+            emit jobOutputProgress(jobId, it->finalExtraOutputFilePaths.value(i), percent,
+                                   QFileInfo(it->extraOutputFilePaths[i]).size());
+        }
+    });
+    connect(progressHandler, &ProgressHandler::logMessage, this, [this, jobId](const QString& message) {
+        logMessage(jobId, message);
+    });
+    connect(progressHandler, &ProgressHandler::statsUpdated, this, [this, jobId](const FfmpegStats& stats) {
+        emit jobStats(jobId, stats);
+    });
+    connect(progressHandler, &ProgressHandler::stageFinished, this,
+        [this](const QString& processName, double seconds, const FfmpegStats& stats) {
+        metrics_.observeStage(processName.toLower().replace(' ', '_'), seconds);
+        metrics_.observeSpeed(stats.speed);
+    });
+    connect(progressHandler, &ProgressHandler::finished, this, &Converter::onFinished);
 
-    // if error during run we log error message and end conversion
-    connect(this, &Converter::error, this, [this](const QString& message) {
-        emit onLogMessage(message);
-        conversionEnded();
+    // signal when full job is ended (example ffmpeg + exiftool encoding + metadata move)
+    connect(progressHandler, &ProgressHandler::allDone, this, [this, jobId]() {
+        finishJob(jobId, true);
     });
+
+    return progressHandler;
+}
+
+void Converter::startStage(int jobId)
+{
+    stageTimers_[jobId].start();
 }
 
-void Converter::runConverter(const QString& inputFilePath, const QString& outputFilePath, bool saveMetadata)
+void Converter::finishStage(int jobId, const QString& stage)
 {
-    if (state_ != State::IDLE) {
+    auto it = stageTimers_.find(jobId);
+    if (it == stageTimers_.end() || !it->isValid()) { return; }
+    metrics_.observeStage(stage, it->nsecsElapsed() / 1e9);
+    it->invalidate();
+}
+
+void Converter::finishJob(int jobId, bool success)
+{
+    auto it = jobs_.find(jobId);
+    if (it == jobs_.end() || it->isFinished()) { return; }
+
+    // cancelled queued job never took a worker
+    if (it->state != State::QUEUED) {
+        runningJobs_--;
+    }
+
+    for (int i = 0; i < it->finalExtraOutputFilePaths.size(); i++) {
+        const QString& finalExtraOutputFilePath = it->finalExtraOutputFilePaths[i];
+        if (success && !FileUtils::replaceFile(it->extraOutputFilePaths[i], finalExtraOutputFilePath)) {
+            logMessage(jobId, "Output couldn't be moved to " + finalExtraOutputFilePath);
+            success = false;
+        }
+        if (!success) {
+            QFile::remove(it->extraOutputFilePaths[i]);
+        }
+    }
+    if (!it->finalExtraOutputFilePaths.isEmpty()) {
+        it->extraOutputFilePaths = it->finalExtraOutputFilePaths;
+        it->finalExtraOutputFilePaths.clear();
+    }
+    if (!it->finalOutputFilePath.isEmpty()) {
+        if (success && !FileUtils::replaceFile(it->outputFilePath, it->finalOutputFilePath)) {
+            logMessage(jobId, "Output couldn't be moved to " + it->finalOutputFilePath);
+            success = false;
+        }
+        if (!success) {
+            QFile::remove(it->outputFilePath);
+        }
+        it->outputFilePath = it->finalOutputFilePath;
+        it->finalOutputFilePath.clear();
+    }
+    it->state = success ? State::DONE : State::FAILED;
+    if (journal_) { journal_->record(*it, it->state); }
+    it->percent = 100;
+
+    if (ProgressHandler* progressHandler = progressHandlers_.take(jobId)) {
+        progressHandler->deleteLater();
+    }
+    releaseCacheKey(jobId, success);
+
+    stageTimers_.remove(jobId);
+    metrics_.addJob(jobTypeToString(it->type), success);
+    if (success) {
+        qint64 outputBytes = QFileInfo(it->outputFilePath).size();
+        for (const QString& extraOutputFilePath : std::as_const(it->extraOutputFilePaths)) {
+            outputBytes += QFileInfo(extraOutputFilePath).size();
+        }
+        metrics_.addBytes(QFileInfo(it->inputFilePath).size(), outputBytes);
+    }
+
+    emit jobFinished(jobId, success);
+    updateOverallProgress();
+
+    if (isIdle()) {
+        jobs_.clear();
+        emit allDone();
         return;
     }
-    state_ = State::RUNNING;
-    emit onLogMessage("\nStarting format converter...");
-    if (!checkInputAndOutput(inputFilePath, outputFilePath)) { return; }
 
-    FormatInfo format = getFileFormat(outputFilePath);
+    // next jobs are started from event loop so long failing batches don't grow the stack
+    QMetaObject::invokeMethod(this, &Converter::startNextJobs, Qt::QueuedConnection);
+}
+
+void Converter::logMessage(int jobId, const QString& message)
+{
+    emit jobLogMessage(jobId, message);
+    emit onLogMessage(message);
+}
+
+void Converter::setJobState(int jobId, State state)
+{
+    auto it = jobs_.find(jobId);
+    if (it != jobs_.end() && !it->isFinished()) {
+        it->state = state;
+    }
+}
+
+void Converter::updateOverallProgress()
+{
+    if (jobs_.isEmpty()) { return; }
+
+    int percentSum = 0;
+    int finishedJobs = 0;
+    for (const ConversionJob& job : std::as_const(jobs_)) {
+        percentSum += job.percent;
+        if (job.isFinished()) { finishedJobs++; }
+    }
+
+    emit queueProgress(finishedJobs, jobs_.size());
+    emit onUpdateProgress(percentSum / jobs_.size(), finishedJobs == jobs_.size());
+}
 
-    // building arguments depending on filetype and format
-    QStringList args = Arguments::converter(inputFilePath, outputFilePath, format);
+void Converter::startConverter(const ConversionJob& job)
+{
+    logMessage(job.id, "\nStarting format converter...");
+    if (!checkInputAndOutput(job.id, job.inputFilePath, job.outputFilePath)) { return; }
+
+    FormatInfo format = FormatRegistry::fromPath(job.outputFilePath);
+
+    // images are always encoded so only audio and video are probed
+    if (format.fileType == FileType::AUDIO || format.fileType == FileType::VIDEO) {
+        startStage(job.id);
+        mediaProbe_->probe(job.id, job.inputFilePath);
+        return;
+    }
+
+    runConversion(job, format, MediaInfo());
+}
+
+void Converter::probeFinished(int jobId, const MediaInfo& info)
+{
+    auto it = jobs_.find(jobId);
+    if (it == jobs_.end() || it->isFinished()) { return; }
+    const ConversionJob job = *it;
+    finishStage(jobId, "probe");
+
+    if (info.valid) {
+        if (ProgressHandler* progressHandler = progressHandlers_.value(jobId)) {
+            progressHandler->setTotalDuration(info.duration);
+        }
+    } else {
+        logMessage(jobId, "Probing input failed!");
+    }
+
+    switch (job.type) {
+        case JobType::CONVERT:
+            runConversion(job, FormatRegistry::fromPath(job.outputFilePath), info);
+            break;
+        case JobType::REMOVE_METADATA:
+            ffmpegMetadataRemoval(jobId, job.inputFilePath, job.outputFilePath,
+                                  FormatRegistry::detect(job.inputFilePath));
+            break;
+        case JobType::FAN_OUT:
+            runFanOutConversion(job, info);
+            break;
+        case JobType::LADDER:
+            runLadderConversion(job, info);
+            break;
+    }
+}
+
+void Converter::startMultiOutput(const ConversionJob& job)
+{
+    logMessage(job.id, job.type == JobType::LADDER ? "\nStarting rendition ladder..."
+                                                   : "\nStarting fan-out converter...");
+    if (!checkInputAndOutput(job.id, job.inputFilePath, job.outputFilePath)) { return; }
+    for (const QString& extraOutputFilePath : job.extraOutputFilePaths) {
+        if (!checkInputAndOutput(job.id, job.inputFilePath, extraOutputFilePath)) { return; }
+    }
+
+    // probe gives duration for progress and codecs for stream copy of each output
+    startStage(job.id);
+    mediaProbe_->probe(job.id, job.inputFilePath);
+}
+
+void Converter::runFanOutConversion(const ConversionJob& job, const MediaInfo& info)
+{
+    logMessage(job.id, "Encoder profile: " + job.profile);
+
+    QList<FFmpeg::Converter::FanOutput> outputs;
+    for (const QString& outputFilePath : QStringList{job.outputFilePath} + job.extraOutputFilePaths) {
+        FormatInfo format = FormatRegistry::fromPath(outputFilePath);
+        if (format.fileType != FileType::AUDIO) {
+            emit error(job.id, "Fan-out output " + outputFilePath + " isn't an audio format!");
+            return;
+        }
+
+        FFmpeg::Converter::FanOutput output;
+        output.filePath = outputFilePath;
+        output.enumValue = format.enumValue;
+        output.settings = encoderProfiles_.settings(job.profile, format);
+        output.plan = FFmpeg::StreamCopy::streamPlan(format, info);
+        if (job.saveMetadata) {
+            output.outputOptions = FFmpeg::Converter::metadataArgs(format, info);
+        }
+        if (info.valid) {
+            logMessage(job.id, format.label + ": " + FFmpeg::StreamCopy::describe(output.plan, format.fileType));
+        }
+        outputs.append(output);
+    }
+
+    runProcess(job.id, ProcessType::FFMPEG, FFmpeg::Converter::fanOutArgs(job.inputFilePath, outputs));
+}
+
+void Converter::runLadderConversion(const ConversionJob& job, const MediaInfo& info)
+{
+    // scaling needs a video stream, ffmpeg would only fail on the filter graph
+    if (!info.valid || !info.firstStream("video")) {
+        emit error(job.id, "Ladder input has no video stream!");
+        return;
+    }
+
+    const QStringList outputFilePaths = QStringList{job.outputFilePath} + job.extraOutputFilePaths;
+    if (outputFilePaths.size() != job.renditions.size()) {
+        emit error(job.id, "Ladder needs one output for each rendition!");
+        return;
+    }
+
+    // every rendition is encoded with the same codec so all outputs are in one format
+    FormatInfo format = FormatRegistry::fromPath(job.outputFilePath);
+    for (const QString& outputFilePath : outputFilePaths) {
+        FormatInfo outputFormat = FormatRegistry::fromPath(outputFilePath);
+        if (outputFormat.fileType != FileType::VIDEO || outputFormat.enumValue != format.enumValue) {
+            emit error(job.id, "Ladder outputs must be in the same video format!");
+            return;
+        }
+    }
+
+    logMessage(job.id, "Encoder profile: " + job.profile);
+    EncoderSettings settings = encoderProfiles_.settings(job.profile, format);
+    bool copyAudio = FFmpeg::StreamCopy::streamPlan(format, info).copyAudio;
+
+    QList<FFmpeg::Converter::LadderOutput> outputs;
+    for (int i = 0; i < outputFilePaths.size(); i++) {
+        FFmpeg::Converter::LadderOutput output;
+        output.filePath = outputFilePaths[i];
+        output.height = job.renditions[i].height;
+        output.bitrate = job.renditions[i].bitrate;
+        output.copyAudio = copyAudio;
+        if (job.saveMetadata) {
+            output.outputOptions = FFmpeg::Converter::metadataArgs(format, info);
+        }
+        logMessage(job.id, output.bitrate > 0
+                           ? QString("Rendition %1p, at most %2 kbit/s").arg(output.height).arg(output.bitrate)
+                           : QString("Rendition %1p").arg(output.height));
+        outputs.append(output);
+    }
+
+    bool hasAudio = info.firstStream("audio") != nullptr;
+    runProcess(job.id, ProcessType::FFMPEG,
+               FFmpeg::Converter::ladderArgs(job.inputFilePath, format.enumValue, settings, outputs, hasAudio));
+}
+
+void Converter::runConversion(const ConversionJob& job, FormatInfo format, const MediaInfo& info)
+{
+    // streams which already fit target container are copied
+    FFmpeg::Converter::StreamPlan plan = FFmpeg::StreamCopy::streamPlan(format, info);
+    if (info.valid) {
+        logMessage(job.id, FFmpeg::StreamCopy::describe(plan, format.fileType));
+    }
+
+    // audio and video metadata is moved by ffmpeg during encoding
+    QStringList outputOptions;
+    if (job.saveMetadata && format.fileType != FileType::IMAGE) {
+        outputOptions = FFmpeg::Converter::metadataArgs(format, info);
+    }
+
+    // building arguments depending on filetype, format and encoder profile
+    logMessage(job.id, "Encoder profile: " + job.profile);
+    EncoderSettings settings = encoderProfiles_.settings(job.profile, format);
+    QStringList args = Arguments::converter(job.inputFilePath, job.outputFilePath, format, settings,
+                                            plan, outputOptions);
 
     // if args are empty stop running
     if (args.empty()) {
-        emit error("File type unknown!");
+        emit error(job.id, "File type unknown!");
         return;
     }
 
-    // if metadata isn't saved we only run ffmpeg and end
-    if (!saveMetadata) {
-        runProcess(ProcessType::FFMPEG, args, true);
+    // encoding is delayed when cache has to be checked first
+    auto encode = [this, job, format, info, plan, settings, outputOptions, args]() {
+        if (useSegments(job, format, plan, info)) {
+            SegmentedEncoding encoding;
+            encoding.inputFilePath = job.inputFilePath;
+            encoding.outputFilePath = job.outputFilePath;
+            encoding.format = format;
+            encoding.settings = settings;
+            encoding.plan = plan;
+            encoding.outputOptions = outputOptions;
+            encoding.hasAudio = info.firstStream("audio") != nullptr;
+            encoding.duration = info.duration;
+            encoding.segments = segments_;
+
+            // cores are shared with the other running jobs and segments split the share of this
+            // job, so the encoder threads of all segments don't oversubscribe the machine
+            int cores = qMax(1, QThread::idealThreadCount() / qMax(1, runningJobs_));
+            encoding.parallel = qMin(qMax(2, segments_), cores);
+            int segmentThreads = qMax(1, cores / encoding.parallel);
+            if (encoding.settings.threads <= 0 || encoding.settings.threads > segmentThreads) {
+                encoding.settings.threads = segmentThreads;
+            }
+            encoding.processPriority = ProcessPriorities::forJob(job.priority, cpus_);
+            runSegmented(job, encoding);
+            return;
+        }
+
+        // ffmpeg can't carry image metadata (EXIF, XMP, ICC) so it is moved with exiftool afterwards
+        if (!job.saveMetadata || format.fileType != FileType::IMAGE) {
+            runEncoder(job, format, settings, args, true);
+            return;
+        }
+
+        if (!DependencyChecker::isExifToolAvailable()) {
+            logMessage(job.id, "ExifTool is not installed, image metadata can't be preserved");
+            runEncoder(job, format, settings, args, true);
+            return;
+        }
+
+        runEncoder(job, format, settings, args, false);
+        copyMetadata(job.id, job.inputFilePath, job.outputFilePath);
+    };
+
+    if (!conversionCache_ || job.inputFilePath == job.outputFilePath) {
+        encode();
         return;
     }
+    lookupCache(job, args, encode);
+}
+
+void Converter::lookupCache(const ConversionJob& job, const QStringList& args, std::function<void()> encode)
+{
+    // everything that changes the output is part of the key
+    QStringList keyArgs = ConversionCache::normalizeArgs(args, job.inputFilePath, job.outputFilePath);
+    keyArgs << QString("metadata=%1").arg(job.saveMetadata)
+            << QString("engine=%1").arg(useImageEngine(job) ? "image"
+                                        : jobEngine(job) == Engine::LIBAV ? "libav" : "process");
+
+    const int jobId = job.id;
+    const QString outputFilePath = job.outputFilePath;
+    startStage(jobId);
+    conversionCache_->computeKey(job.inputFilePath, keyArgs,
+        [this, jobId, outputFilePath, encode](const QString& key) {
+        // job can be cancelled while input is hashed
+        auto it = jobs_.find(jobId);
+        if (it == jobs_.end() || it->isFinished()) { return; }
+        finishStage(jobId, "hash");
+
+        if (key.isEmpty()) {
+            encode();
+            return;
+        }
+
+        bool restored = conversionCache_->restore(key, outputFilePath);
+        metrics_.addCacheLookup(restored);
+        if (restored) {
+            logMessage(jobId, "Cache hit, output linked from " + conversionCache_->directory());
+            if (ProgressHandler* progressHandler = progressHandlers_.value(jobId)) {
+                progressHandler->progressFinished("Cache", true);
+            }
+            return;
+        }
+
+        jobCacheKeys_.insert(jobId, key);
 
-    // if metadata is saved we first run ffmpeg and after exiftool
-    runProcess(ProcessType::FFMPEG, args, false);
-    copyMetadata(inputFilePath, outputFilePath, format.fileType);
+        // identical conversion is already running, this job gets its output when it is ready
+        if (cacheLeaders_.contains(key)) {
+            logMessage(jobId, "Same conversion is already running, waiting for its output");
+            cacheWaiting_.insert(jobId, encode);
+            return;
+        }
+
+        cacheLeaders_.insert(key, jobId);
+        // exiftool refuses to write over an existing file, so output left by an earlier run is removed first
+        if (!removeExistingOutput(jobId, outputFilePath)) { return; }
+        encode();
+    });
 }
 
-void Converter::copyMetadata(const QString &inputFilePath, const QString &outputFilePath, FileType type)
+void Converter::releaseCacheKey(int jobId, bool success)
 {
-    connect(&progressHandler_, &ProgressHandler::finished, this,
-    [this, outputFilePath, inputFilePath, type]() {
+    if (!jobCacheKeys_.contains(jobId)) { return; }
+    QString key = jobCacheKeys_.take(jobId);
+
+    // waiting job only leaves the line
+    if (cacheWaiting_.remove(jobId)) { return; }
 
-        // BMP is not supported by ExifTool (it doesn't include metadata anyway)
-        // images and audio metadata is moved with ExifTool
-        if (type == FileType::IMAGE || type == FileType::AUDIO) {
-            QStringList args = ExifTool::CopyMetadata::standardArgs(inputFilePath, outputFilePath);
-            runProcess(ProcessType::EXIFTOOL, args, true);
+    cacheLeaders_.remove(key);
+    if (success) {
+        conversionCache_->store(key, jobs_.value(jobId).outputFilePath);
+    }
+
+    // waiting jobs continue from event loop so this job is fully finished first
+    QMetaObject::invokeMethod(this, [this, key]() { serveWaitingJobs(key); }, Qt::QueuedConnection);
+}
+
+void Converter::serveWaitingJobs(const QString& key)
+{
+    QList<int> waitingJobs;
+    for (auto it = cacheWaiting_.cbegin(); it != cacheWaiting_.cend(); ++it) {
+        if (jobCacheKeys_.value(it.key()) == key) { waitingJobs << it.key(); }
+    }
+    std::sort(waitingJobs.begin(), waitingJobs.end());
 
-        // video metadata
-        } else if (type == FileType::VIDEO) {
-            emit error("Metadata transfer for videos isn't yet implemented");
+    for (int jobId : std::as_const(waitingJobs)) {
+        std::function<void()> encode = cacheWaiting_.take(jobId);
+        const QString outputFilePath = jobs_.value(jobId).outputFilePath;
+
+        if (conversionCache_->restore(key, outputFilePath)) {
+            jobCacheKeys_.remove(jobId);
+            logMessage(jobId, "Output linked from identical conversion");
+            if (ProgressHandler* progressHandler = progressHandlers_.value(jobId)) {
+                progressHandler->progressFinished("Cache", true);
+            }
+            continue;
+        }
+
+        // earlier run failed so first waiting job converts the file itself, others keep waiting
+        if (cacheLeaders_.contains(key)) {
+            cacheWaiting_.insert(jobId, encode);
+            continue;
         }
+        cacheLeaders_.insert(key, jobId);
+        if (!removeExistingOutput(jobId, outputFilePath)) { continue; }
+        encode();
+    }
+}
+
+void Converter::copyMetadata(int jobId, const QString &inputFilePath, const QString &outputFilePath)
+{
+    ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+    if (!progressHandler) { return; }
+
+    // BMP is not supported by ExifTool (it doesn't include metadata anyway)
+    connect(progressHandler, &ProgressHandler::finished, this, [this, jobId, outputFilePath, inputFilePath]() {
+        QStringList args = ExifTool::CopyMetadata::standardArgs(inputFilePath, outputFilePath);
+        runProcess(jobId, ProcessType::EXIFTOOL, args, true);
     }, Qt::SingleShotConnection);
 }
 
-void Converter::runMetadataRemover(const QString& inputFilePath, const QString& outputFilePath)
+void Converter::startMetadataRemover(const ConversionJob& job)
 {
-    if (state_ != State::IDLE) {
-        return;
+    logMessage(job.id, "\nStarting metadata remover...");
+    if (!checkInputAndOutput(job.id, job.inputFilePath, job.outputFilePath)) { return; }
+
+    // content decides which remover is used, suffix of the file may be wrong
+    FormatInfo format = FormatRegistry::detect(job.inputFilePath);
+
+    // exiftool refuses to replace existing file and ffmpeg would write through a hardlink
+    // of the output, so existing output is removed first
+    if (job.inputFilePath != job.outputFilePath) {
+        if (!removeExistingOutput(job.id, job.outputFilePath)) { return; }
     }
-    state_ = State::RUNNING;
-    emit onLogMessage("\nStarting metadata remover...");
-    if (!checkInputAndOutput(inputFilePath, outputFilePath)) { return; }
 
-    FormatInfo format = getFileFormat(inputFilePath);
+    // containers the native stripper can parse don't need external processes
+    if (MetadataStripper::canStrip(format)) {
+        runStripper(job, format);
+        return;
+    }
+    runProcessRemover(job, format);
+}
 
-    QStringList args = Arguments::metadataRemoval(outputFilePath, format);
+void Converter::runProcessRemover(const ConversionJob& job, FormatInfo format)
+{
+    QStringList args = Arguments::metadataRemoval(job.inputFilePath, job.outputFilePath, format);
 
-    // if args are empty we need to use ffmpeg. ffmpeg overrides file if needed.
+    // if args are empty we need to use ffmpeg. input is probed first for duration of the progress
     if (args.empty()){
-        ffmpegMetadataRemoval(inputFilePath, outputFilePath, format);
+        startStage(job.id);
+        mediaProbe_->probe(job.id, job.inputFilePath);
         return;
     }
-    // exiftool edits file so we need to copy input to output and then edit output
-    if (inputFilePath != outputFilePath) {
-        if (!copyAndReplaceFile(inputFilePath, outputFilePath)) { return; }
-    }
-    runProcess(ProcessType::EXIFTOOL, args);
+    runProcess(job.id, ProcessType::EXIFTOOL, args);
 }
 
-bool Converter::copyAndReplaceFile(const QString &inputFilePath, const QString &outputFilePath)
+bool Converter::removeExistingOutput(int jobId, const QString &outputFilePath)
 {
-    // if outputfile exists it gets removed
-    if (QFile::exists(outputFilePath)) {
-        emit onLogMessage("Overwriting...");
-        QFile::remove(outputFilePath);
-    }
+    if (!QFile::exists(outputFilePath)) { return true; }
 
-    // and we copy our input file to output
-    if (!QFile::copy(inputFilePath, outputFilePath)) {
-        emit onLogMessage("\nFailed to make copy of the original file!\n");
+    logMessage(jobId, "Overwriting...");
+    if (!QFile::remove(outputFilePath)) {
+        emit error(jobId, "\nFailed to remove existing output file!\n");
         return false;
     }
 
     return true;
 }
 
-bool Converter::checkInputAndOutput(const QString &inputFilePath, const QString &outputFilePath)
+bool Converter::checkInputAndOutput(int jobId, const QString &inputFilePath, const QString &outputFilePath)
 {
     if (!QFileInfo::exists(inputFilePath)) {
-        emit error("Input file: " + inputFilePath + " does not exist!");
+        emit error(jobId, "Input file: " + inputFilePath + " does not exist!");
         return false;
     }
 
     QString dir = QFileInfo(outputFilePath).absolutePath();
     if (!QDir().mkpath(dir)) {
-        emit error("Output folder " + dir + " is missing and creation was unsuccessful!");
+        emit error(jobId, "Output folder " + dir + " is missing and creation was unsuccessful!");
         return false;
     }
 
     return true;
 }
 
-void Converter::ffmpegMetadataRemoval(const QString& inputFilePath, const QString& outputFilePath, FormatInfo format)
+void Converter::ffmpegMetadataRemoval(int jobId, const QString& inputFilePath, const QString& outputFilePath, FormatInfo format)
 {
     QStringList args;
     // empty args can be unknown filetype OR filetypes not working with ExifTool
     switch (format.fileType) {
+        // mp3 tags are cut by the native stripper, this remux is left for files it rejects
         case FileType::AUDIO:
             args = FFmpeg::RemoveMetadata::mp3Args(inputFilePath, outputFilePath);
             break;
 
+        // quicktime family is rewritten by the native stripper, other containers are remuxed
         case FileType::VIDEO:
-            // TEST MP4 FRAGMENTATION
             args = FFmpeg::RemoveMetadata::mkvArgs(inputFilePath, outputFilePath);
             break;
 
         // all image formats are taken care with exiftool so shouldn't have any here
         case FileType::IMAGE:
         case FileType::UNKNOWN:
-            emit error("File type unknown!");
+            emit error(jobId, "File type unknown!");
             return;
     }
-    runProcess(ProcessType::FFMPEG, args);
+    runProcess(jobId, ProcessType::FFMPEG, args);
+}
+
+void Converter::runStripper(const ConversionJob& job, FormatInfo format)
+{
+    ProgressHandler* progressHandler = progressHandlers_.value(job.id);
+    if (!progressHandler) { return; }
+
+    setJobState(job.id, State::STRIPPER_RUNNING);
+    progressHandler->progressStarted("Metadata stripper");
+
+    stripperJobs_.insert(job.id, format);
+    metadataStripper_->start(job.id, job.inputFilePath, job.outputFilePath, format);
 }
 
-void Converter::runProcess(ProcessType processType, const QStringList& args, bool lastConversion)
+void Converter::stripperFinished(int jobId, bool success, const QString& errorMessage)
 {
+    // cancelled jobs are already removed
+    if (!stripperJobs_.contains(jobId)) { return; }
+    FormatInfo format = stripperJobs_.take(jobId);
+
+    ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+    if (!progressHandler) { return; }
+
+    if (success) {
+        progressHandler->progressFinished("Metadata stripper", true);
+        return;
+    }
+
+    // files the stripper doesn't understand are left to exiftool, nothing was written
+    progressHandler->progressFailed("Metadata stripper");
+    logMessage(jobId, "Metadata stripper: " + errorMessage);
+    runProcessRemover(jobs_.value(jobId), format);
+}
+
+bool Converter::useImageEngine(const ConversionJob& job) const
+{
+#ifdef FORMAT_CONVERTER_IMAGE_ENGINE
+    if (engineChosen_ || job.engine != Engine::DEFAULT || job.type != JobType::CONVERT) { return false; }
+
+    // output may be partial file, its suffix is still the target format
+    return ImageEngine::canConvert(FormatRegistry::detect(job.inputFilePath),
+                                   FormatRegistry::fromPath(job.outputFilePath));
+#else
+    Q_UNUSED(job);
+    return false;
+#endif
+}
+
+void Converter::runEncoder(const ConversionJob& job, FormatInfo format, const EncoderSettings& settings,
+                           const QStringList& args, bool lastConversion)
+{
+#ifdef FORMAT_CONVERTER_IMAGE_ENGINE
+    if (format.fileType == FileType::IMAGE && useImageEngine(job)) {
+        runImageEngine(job, format, settings, lastConversion);
+        return;
+    }
+#else
+    Q_UNUSED(format);
+    Q_UNUSED(settings);
+#endif
+
+    Engine engine = jobEngine(job);
+
+#ifdef FORMAT_CONVERTER_LIBAV
+    if (engine == Engine::LIBAV) {
+        runLibav(job.id, args, lastConversion);
+        return;
+    }
+#else
+    if (engine == Engine::LIBAV) {
+        logMessage(job.id, "libav engine isn't built in, using FFmpeg process");
+    }
+#endif
+
+    runProcess(job.id, ProcessType::FFMPEG, args, lastConversion);
+}
+
+bool Converter::useSegments(const ConversionJob& job, FormatInfo format, FFmpeg::Converter::StreamPlan plan,
+                            const MediaInfo& info) const
+{
+    // only re-encoded video of long enough file is worth of splitting
+    if (segments_ < 2 || format.fileType != FileType::VIDEO || plan.copyVideo) { return false; }
+    if (!info.valid || !info.firstStream("video") || info.duration < segmentMinDuration_) { return false; }
+
+    return jobEngine(job) == Engine::PROCESS;
+}
+
+void Converter::runSegmented(const ConversionJob& job, const SegmentedEncoding& encoding)
+{
+    ProgressHandler* progressHandler = progressHandlers_.value(job.id);
+    if (!progressHandler) { return; }
+
+    setJobState(job.id, State::FFMPEG_RUNNING);
+    progressHandler->progressStarted("FFmpeg segments");
+
+    SegmentedEncoder* encoder = new SegmentedEncoder(job.id, progressHandler, this);
+    segmentedEncoders_.insert(job.id, encoder);
+
+    connect(encoder, &SegmentedEncoder::logMessage, this, &Converter::logMessage);
+    connect(encoder, &SegmentedEncoder::finished, this, [this](int jobId, bool success, const QString& message) {
+        SegmentedEncoder* encoder = segmentedEncoders_.take(jobId);
+        if (!encoder) { return; }
+        encoder->deleteLater();
+
+        ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+        if (!progressHandler) { return; }
+
+        if (!success) {
+            progressHandler->progressFailed("FFmpeg segments");
+            emit error(jobId, message);
+            return;
+        }
+        progressHandler->progressFinished("FFmpeg segments", true);
+    });
+
+    encoder->start(encoding);
+}
+
+void Converter::runProcess(int jobId, ProcessType processType, const QStringList& args, bool lastConversion)
+{
+    // job cancelled while its previous step was running
+    ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+    if (!progressHandler) { return; }
+
     switch (processType) {
-        case ProcessType::FFMPEG:   state_ = State::FFMPEG_RUNNING;     break;
-        case ProcessType::EXIFTOOL: state_ = State::EXIFTOOL_RUNNING;   break;
+        case ProcessType::FFMPEG:   setJobState(jobId, State::FFMPEG_RUNNING);     break;
+        case ProcessType::EXIFTOOL: setJobState(jobId, State::EXIFTOOL_RUNNING);   break;
     }
 
     QString processName = processTypeToString(processType);
-    progressHandler_.progressStarted(processName);
+    progressHandler->progressStarted(processName);
+
+    // exiftool isn't started for every file, commands go to already running session
+    if (processType == ProcessType::EXIFTOOL) {
+        runExifTool(jobId, args, lastConversion);
+        return;
+    }
+
+    // ffmpeg reports progress as key=value blocks instead of stats line
+    const QStringList processArgs = FFmpeg::progressArgs() + args;
 
     QProcess* qProcess = new QProcess(this);
+    ProcessPriorities::apply(qProcess, ProcessPriorities::forJob(jobs_.value(jobId).priority, cpus_));
 /*
     // FOR ARGUMENT TESTING
     connect(qProcess, &QProcess::readyReadStandardError, [qProcess]() {
         std::cerr << qProcess->readAllStandardError().toStdString() << std::endl;
     });
 */
-    connectProcesses(qProcess, processType, lastConversion);
+    connectProcesses(jobId, qProcess, processType, lastConversion);
+    processes_.insert(jobId, qProcess);
+
+    // time from start call until the program is running
+    QElapsedTimer spawnTimer;
+    spawnTimer.start();
+    connect(qProcess, &QProcess::started, this, [this, spawnTimer, processName]() {
+        metrics_.observeStage(processName.toLower() + "_spawn", spawnTimer.nsecsElapsed() / 1e9);
+    });
 
-    qProcess->start(processName.toLower(), args);
+    qProcess->start(processName.toLower(), processArgs);
 }
 
-void Converter::connectProcesses(QProcess *process, ProcessType processType, bool lastConversion)
+void Converter::connectProcesses(int jobId, QProcess *process, ProcessType processType, bool lastConversion)
 {
     QString processName = processTypeToString(processType);
-    // connecting progress updates
-    connect(process, &QProcess::readyReadStandardError, [process, this, processType]() {
+    ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+
+    // connecting progress updates, ffmpeg writes its progress blocks to stdout
+    connect(process, &QProcess::readyReadStandardOutput, progressHandler, [process, progressHandler, processType]() {
+        if (processType == ProcessType::FFMPEG) {
+            progressHandler->handleFfmpegProgress(process->readAllStandardOutput());
+        }
+    });
+    connect(process, &QProcess::readyReadStandardError, progressHandler, [process, progressHandler, processType]() {
         switch (processType) {
             case ProcessType::FFMPEG:
-                progressHandler_.handleFfmpegProgress(process->readAllStandardError().trimmed());
+                progressHandler->handleFfmpegOutput(process->readAllStandardError());
                 break;
             case ProcessType::EXIFTOOL:
-                progressHandler_.handleExifToolProgress(process->readAllStandardError().trimmed());
+                progressHandler->handleExifToolProgress(process->readAllStandardError().trimmed());
                 break;
         }
     });
 
-    // emitting error signal
-    connect(process, &QProcess::errorOccurred, [this, processName]() {
-        progressHandler_.progressFailed(processName);
+    // process that can't be started never emits finished so job is failed here
+    connect(process, &QProcess::errorOccurred, this,
+        [this, jobId, process, processName](QProcess::ProcessError processError) {
+        if (ProgressHandler* progressHandler = progressHandlers_.value(jobId)) {
+            progressHandler->progressFailed(processName);
+        }
+        if (processError == QProcess::FailedToStart) {
+            processes_.remove(jobId);
+            process->deleteLater();
+            emit error(jobId, processName + " couldn't be started!");
+        }
     });
 
     // emitting finished signal
-    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-        [this, processName, lastConversion] () {
-        progressHandler_.progressFinished(processName, lastConversion);
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+        [this, jobId, process, processName, lastConversion](int exitCode, QProcess::ExitStatus exitStatus) {
+        processes_.remove(jobId);
+        process->deleteLater();
+        if (exitStatus != QProcess::NormalExit || exitCode != 0) {
+            emit error(jobId, processName + " exited with code " + QString::number(exitCode) + "!");
+            return;
+        }
+        if (ProgressHandler* progressHandler = progressHandlers_.value(jobId)) {
+            progressHandler->progressFinished(processName, lastConversion);
+        }
     });
 }
 
-FormatInfo Converter::getFileFormat(const QString& filePath)
+void Converter::runExifTool(int jobId, const QStringList& args, bool lastConversion)
+{
+    exifToolCommands_.insert(jobId, lastConversion);
+    exifToolSession()->execute(jobId, args);
+}
+
+void Converter::exifToolFinished(int jobId, bool success, const QString& output)
 {
-    QString suffix = QFileInfo(filePath).suffix();
-    for (const FormatInfo& it : fileFormats) {
-        if (it.label == suffix) {
-            // always finds correct it as only supported suffixes are given previously
-            return it;
+    if (!exifToolCommands_.contains(jobId)) {
+        if (cancelledExifToolOutputs_.contains(jobId)) {
+            QFile::remove(cancelledExifToolOutputs_.take(jobId));
         }
+        return;
+    }
+    bool lastConversion = exifToolCommands_.take(jobId);
+
+    ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+    if (!progressHandler) { return; }
+
+    if (!output.isEmpty()) {
+        progressHandler->handleExifToolProgress(output);
+    }
+    if (!success) {
+        progressHandler->progressFailed(processTypeToString(ProcessType::EXIFTOOL));
+        emit error(jobId, "ExifTool couldn't process the file!");
+        return;
     }
-    return {FileType::UNKNOWN};
+    progressHandler->progressFinished(processTypeToString(ProcessType::EXIFTOOL), lastConversion);
 }
 
-void Converter::conversionEnded()
+ExifToolSession* Converter::exifToolSession()
 {
-    state_ = State::IDLE;
+    // least busy session is used, new session is started only if all of them are busy
+    ExifToolSession* session = nullptr;
+    for (ExifToolSession* it : std::as_const(exifToolSessions_)) {
+        if (!session || it->pendingCommands() < session->pendingCommands()) {
+            session = it;
+        }
+    }
+
+    if (!session || (session->pendingCommands() > 0 && exifToolSessions_.size() < maxWorkers_)) {
+        session = new ExifToolSession(this);
+        session->setProcessPriority(sharedProcessPriority());
+        connect(session, &ExifToolSession::commandFinished, this, &Converter::exifToolFinished);
+        exifToolSessions_.append(session);
+    }
+    return session;
 }
 
+#ifdef FORMAT_CONVERTER_LIBAV
+void Converter::runLibav(int jobId, const QStringList& args, bool lastConversion)
+{
+    ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+    if (!progressHandler) { return; }
+
+    setJobState(jobId, State::LIBAV_RUNNING);
+    progressHandler->progressStarted("libav");
+
+    // same arguments as ffmpeg process gets, without progress arguments
+    libavJobs_.insert(jobId, lastConversion);
+    libavEngine_->start(jobId, args);
+}
+
+void Converter::libavFinished(int jobId, bool success, const QString& errorMessage)
+{
+    // cancelled jobs are already removed
+    if (!libavJobs_.contains(jobId)) { return; }
+    bool lastConversion = libavJobs_.take(jobId);
+
+    ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+    if (!progressHandler) { return; }
+
+    if (!success) {
+        progressHandler->progressFailed("libav");
+        emit error(jobId, "libav: " + errorMessage);
+        return;
+    }
+    progressHandler->progressFinished("libav", lastConversion);
+}
+#endif
+
+#ifdef FORMAT_CONVERTER_IMAGE_ENGINE
+void Converter::runImageEngine(const ConversionJob& job, FormatInfo format, const EncoderSettings& settings,
+                               bool lastConversion)
+{
+    ProgressHandler* progressHandler = progressHandlers_.value(job.id);
+    if (!progressHandler) { return; }
+
+    setJobState(job.id, State::IMAGE_RUNNING);
+    progressHandler->progressStarted("Qt image");
+
+    imageJobs_.insert(job.id, lastConversion);
+    imageEngine_->start(job.id, job.inputFilePath, job.outputFilePath, format, settings);
+}
+
+void Converter::imageFinished(int jobId, bool success, const QString& errorMessage)
+{
+    // cancelled jobs are already removed
+    if (!imageJobs_.contains(jobId)) { return; }
+    bool lastConversion = imageJobs_.take(jobId);
+
+    ProgressHandler* progressHandler = progressHandlers_.value(jobId);
+    if (!progressHandler) { return; }
+
+    if (!success) {
+        progressHandler->progressFailed("Qt image");
+        emit error(jobId, "Qt image: " + errorMessage);
+        return;
+    }
+    progressHandler->progressFinished("Qt image", lastConversion);
+}
+#endif
\ No newline at end of file
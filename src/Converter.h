@@ -1,17 +1,31 @@
 #ifndef FORMAT_CONVERTER_CONVERTER_H
 #define FORMAT_CONVERTER_CONVERTER_H
+#include <functional>
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QHash>
 #include <QProcess>
+#include <QQueue>
 #include <QString>
 
+#include "ConversionCache.h"
+#include "EncoderProfiles.h"
+#include "ExifToolSession.h"
+#ifdef FORMAT_CONVERTER_IMAGE_ENGINE
+#include "ImageEngine.h"
+#endif
+#include "JobJournal.h"
+#ifdef FORMAT_CONVERTER_LIBAV
+#include "LibavEngine.h"
+#endif
+#include "MediaProbe.h"
+#include "MetadataStripper.h"
+#include "Metrics.h"
 #include "ProgressHandler.h"
+#include "SegmentedEncoder.h"
 #include "utils/CommonEnums.h"
-
-enum class State {
-    IDLE,
-    RUNNING,            // some function is running
-    FFMPEG_RUNNING,     // while FFmpeg running in QProcess
-    EXIFTOOL_RUNNING    // while ExifTool running in QProcess
-};
+#include "utils/ConversionJob.h"
 
 class Converter : public QObject {
     Q_OBJECT
@@ -21,33 +35,209 @@ public:
     Converter(QObject* parent = nullptr);
     ~Converter() = default;
 
-    void runConverter(const QString& inputFilePath, const QString& outputFilePath, bool saveMetadata);
-    void runMetadataRemover(const QString& inputFilePath, const QString& outputFilePath);
+    // jobs are queued and started when there is a free worker. returns id of the queued job
+    int runConverter(const QString& inputFilePath, const QString& outputFilePath, bool saveMetadata,
+                     Engine engine = Engine::DEFAULT);
+    int runMetadataRemover(const QString& inputFilePath, const QString& outputFilePath);
+    // audio input is decoded once and encoded to every output, format comes from output suffix
+    int runFanOut(const QString& inputFilePath, const QStringList& outputFilePaths, bool saveMetadata);
+    // video input is decoded once and scaled to every rendition, outputs are in rendition order
+    int runLadder(const QString& inputFilePath, const QStringList& outputFilePaths,
+                  const QList<Rendition>& renditions, bool saveMetadata);
+    // queues job built by the caller with its own priority, engine and profile. empty profile
+    // uses the current one
+    int runJob(ConversionJob job);
+    // output of one rendition next to outputFilePath, for example video_720p.mp4
+    static QString renditionFilePath(const QString& outputFilePath, const Rendition& rendition);
+
+    // queued job is dropped and running job is stopped, partial output is removed by engine
+    void cancelJob(int jobId);
+
+    // engine used by jobs which don't ask for specific one
+    void setDefaultEngine(Engine engine);
+    Engine defaultEngine() const { return defaultEngine_; }
+    static bool isEngineAvailable(Engine engine);
+
+    // finished outputs are kept in directory and identical conversions are linked from there.
+    // empty directory disables cache, returns false if directory can't be used
+    bool setCache(const QString& directory, qint64 maxSize);
+
+    // ffprobe results are kept in this file so repeated batches over same files aren't probed
+    // again. empty path keeps them only in memory
+    bool setProbeCache(const QString& filePath, QString* errorMessage = nullptr);
+
+    // job states are appended to journal file so work survives a crash. jobs whose output is
+    // complete for the same input are skipped. empty path disables journal
+    bool setJournal(const QString& filePath, QString* errorMessage = nullptr);
+    // queues jobs which were unfinished in the journal, returns their count
+    int resumeJournal();
+
+    // long videos are cut to segments which are encoded at the same time. segments below 2
+    // disables it and videos shorter than minDuration (seconds) are encoded as one
+    void setSegmentedEncoding(int segments, double minDuration = 300.0);
+    int segments() const { return segments_; }
+
+    // encoder profile used by jobs queued after this call
+    void setProfile(const QString& profile) { profile_ = profile; }
+    QString profile() const { return profile_; }
+    EncoderProfiles& encoderProfiles() { return encoderProfiles_; }
+
+    // class of jobs queued after this call. queue is ordered by class, and processes of normal
+    // and background jobs are run with lower cpu and io priority
+    void setPriority(JobPriority priority) { priority_ = priority; }
+    JobPriority priority() const { return priority_; }
+
+    // cores every spawned process may run on, empty allows all
+    void setCpuAffinity(const QList<int>& cpus);
+    const QList<int>& cpuAffinity() const { return cpus_; }
+
+    // how many jobs can run at the same time, defaults to core count
+    void setMaxWorkers(int maxWorkers);
+    int maxWorkers() const { return maxWorkers_; }
+
+    bool isIdle() const { return pendingJobs_.isEmpty() && runningJobs_ == 0; }
+
+    // stage durations, bytes and speeds of finished jobs
+    const Metrics& metrics() const { return metrics_; }
 
 private:
 
-    // keeps track on converter state. new calls are accepted when state is idle
-    State state_ = State::IDLE;
-    ProgressHandler progressHandler_;
-
-    void copyMetadata(const QString& inputFilePath, const QString& outputFilePath, FileType type);
-    bool checkInputAndOutput(const QString& inputFilePath, const QString& outputFilePath);
-    bool copyAndReplaceFile(const QString &inputFilePath, const QString &outputFilePath);
-    void ffmpegMetadataRemoval(const QString& inputFilePath, const QString& outputFilePath, FormatInfo format);
-
-    void runProcess(ProcessType processType, const QStringList& args, bool lastConversion = true);
-    void connectProcesses(QProcess* process, ProcessType processType, bool lastConversion);
-
-    static FormatInfo getFileFormat(const QString& filePath);
-
-private slots:
-    void conversionEnded();
+    int maxWorkers_;
+    int runningJobs_ = 0;
+    int nextJobId_ = 1;
+
+    // jobs of the current batch. batch is cleared when all of its jobs are finished
+    QHash<int, ConversionJob> jobs_;
+    QQueue<int> pendingJobs_;
+
+    // every running job has its own progress state
+    QHash<int, ProgressHandler*> progressHandlers_;
+
+    // exiftool commands are streamed to long running sessions, at most one per worker.
+    // job id is used as command id and mapped to lastConversion of that command
+    QVector<ExifToolSession*> exifToolSessions_;
+    QHash<int, bool> exifToolCommands_;
+    // partial outputs of cancelled jobs whose command was still in a session, removed when
+    // the command ends so exiftool can't leave them behind
+    QHash<int, QString> cancelledExifToolOutputs_;
+
+    // native metadata removal runs in a thread pool, job id mapped to detected format so
+    // failed files can be given to exiftool or ffmpeg
+    MetadataStripper* metadataStripper_;
+    QHash<int, FormatInfo> stripperJobs_;
+
+    // ffmpeg processes of running jobs, killed on cancel
+    QHash<int, QProcess*> processes_;
+
+    Engine defaultEngine_;
+    bool engineChosen_ = false;
+    int segments_ = 0;
+    double segmentMinDuration_ = 300.0;
+    QHash<int, SegmentedEncoder*> segmentedEncoders_;
+
+    // first job of each cache key converts the file, jobs with same key wait for its output
+    ConversionCache* conversionCache_ = nullptr;
+    QHash<QString, int> cacheLeaders_;
+    QHash<int, QString> jobCacheKeys_;
+    QHash<int, std::function<void()>> cacheWaiting_;
+
+    std::unique_ptr<JobJournal> journal_;
+
+    EncoderProfiles encoderProfiles_;
+    QString profile_ = EncoderProfiles::defaultProfile();
+
+    JobPriority priority_ = JobPriority::NORMAL;
+    QList<int> cpus_;
+#ifdef FORMAT_CONVERTER_LIBAV
+    // job id mapped to lastConversion like exiftool commands
+    LibavEngine* libavEngine_;
+    QHash<int, bool> libavJobs_;
+#endif
+#ifdef FORMAT_CONVERTER_IMAGE_ENGINE
+    ImageEngine* imageEngine_;
+    QHash<int, bool> imageJobs_;
+#endif
+
+    // each job has one measured stage at a time (queue, probe, hash), processes are measured
+    // by their progress handlers
+    Metrics metrics_;
+    QHash<int, QElapsedTimer> stageTimers_;
+
+    // audio and video inputs are probed before conversion to find streams that can be copied.
+    // inputs of queued jobs are probed ahead while workers are busy
+    MediaProbe* mediaProbe_;
+
+    int enqueueJob(ConversionJob job);
+    void startNextJobs();
+    void startJob(int jobId);
+    void finishJob(int jobId, bool success);
+    void setJobState(int jobId, State state);
+    void logMessage(int jobId, const QString& message);
+    void updateOverallProgress();
+    ProgressHandler* createProgressHandler(int jobId);
+    void startStage(int jobId);
+    ProcessPriority sharedProcessPriority() const;
+    void finishStage(int jobId, const QString& stage);
+
+    void startConverter(const ConversionJob& job);
+    void startMultiOutput(const ConversionJob& job);
+    void runFanOutConversion(const ConversionJob& job, const MediaInfo& info);
+    void runLadderConversion(const ConversionJob& job, const MediaInfo& info);
+    void probeFinished(int jobId, const MediaInfo& info);
+    void runConversion(const ConversionJob& job, FormatInfo format, const MediaInfo& info);
+    void startMetadataRemover(const ConversionJob& job);
+    void runProcessRemover(const ConversionJob& job, FormatInfo format);
+    void runStripper(const ConversionJob& job, FormatInfo format);
+    void stripperFinished(int jobId, bool success, const QString& errorMessage);
+
+    void copyMetadata(int jobId, const QString& inputFilePath, const QString& outputFilePath);
+    bool checkInputAndOutput(int jobId, const QString& inputFilePath, const QString& outputFilePath);
+    bool removeExistingOutput(int jobId, const QString &outputFilePath);
+    void ffmpegMetadataRemoval(int jobId, const QString& inputFilePath, const QString& outputFilePath, FormatInfo format);
+
+    void lookupCache(const ConversionJob& job, const QStringList& args, std::function<void()> encode);
+    void releaseCacheKey(int jobId, bool success);
+    void serveWaitingJobs(const QString& key);
+
+    Engine jobEngine(const ConversionJob& job) const;
+    bool useImageEngine(const ConversionJob& job) const;
+    void runEncoder(const ConversionJob& job, FormatInfo format, const EncoderSettings& settings,
+                    const QStringList& args, bool lastConversion);
+    bool useSegments(const ConversionJob& job, FormatInfo format, FFmpeg::Converter::StreamPlan plan,
+                     const MediaInfo& info) const;
+    void runSegmented(const ConversionJob& job, const SegmentedEncoding& encoding);
+    void runProcess(int jobId, ProcessType processType, const QStringList& args, bool lastConversion = true);
+    void connectProcesses(int jobId, QProcess* process, ProcessType processType, bool lastConversion);
+    void runExifTool(int jobId, const QStringList& args, bool lastConversion);
+    void exifToolFinished(int jobId, bool success, const QString& output);
+    ExifToolSession* exifToolSession();
+#ifdef FORMAT_CONVERTER_LIBAV
+    void runLibav(int jobId, const QStringList& args, bool lastConversion);
+    void libavFinished(int jobId, bool success, const QString& errorMessage);
+#endif
+#ifdef FORMAT_CONVERTER_IMAGE_ENGINE
+    void runImageEngine(const ConversionJob& job, FormatInfo format, const EncoderSettings& settings,
+                        bool lastConversion);
+    void imageFinished(int jobId, bool success, const QString& errorMessage);
+#endif
 
 signals:
     void allDone();
-    void error(const QString& message);
+    void error(int jobId, const QString& message);
+
+    // per job signals
+    void jobStarted(int jobId);
+    void jobProgress(int jobId, int percent);
+    void jobFinished(int jobId, bool success);
+    void jobLogMessage(int jobId, const QString& message);
+    void jobStats(int jobId, const FfmpegStats& stats);
+    // outputs of multi-output jobs share the decode position, bytes are written size of each
+    void jobOutputProgress(int jobId, const QString& outputFilePath, int percent, qint64 bytes);
+
+    // finished and total job count of the current batch
+    void queueProgress(int finishedJobs, int totalJobs);
 
-    // pass trought signals from progress handler to main window
+    // pass trought signals from progress handlers to main window. progress is for whole batch
     void onUpdateProgress(int percent, bool isFinished = false);
     void onLogMessage(const QString& message);
     void onFinished();
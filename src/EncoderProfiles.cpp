@@ -0,0 +1,158 @@
+#include "EncoderProfiles.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QStandardPaths>
+
+#include "FormatRegistry.h"
+
+
+EncoderProfiles::EncoderProfiles()
+{
+    // archive keeps the settings converter has always used, others trade quality for speed
+    addProfile("archive", {
+        {"mp4",  {.preset = "slow", .crf = 18}},
+        {"webm", {.crf = 30, .rowMt = true}},
+        {"avi",  {.quality = 2}},
+        {"mpeg", {.quality = 2}},
+        {"mp3",  {.quality = 0}},
+        {"ogg",  {.quality = 6}},
+        {"jpeg", {.quality = 1}},
+        {"heif", {.lossless = true}},
+        {"webp", {.lossless = true}},
+    });
+    addProfile("balanced", {
+        {"mp4",  {.preset = "medium", .crf = 20}},
+        {"webm", {.crf = 32, .cpuUsed = 2, .rowMt = true}},
+        {"avi",  {.quality = 3}},
+        {"mpeg", {.quality = 3}},
+        {"mp3",  {.quality = 2}},
+        {"ogg",  {.quality = 5}},
+        {"jpeg", {.quality = 2}},
+        {"heif", {.preset = "medium", .crf = 20}},
+        {"webp", {.quality = 95, .compressionLevel = 4}},
+    });
+    addProfile("fast", {
+        {"mp4",  {.preset = "veryfast", .crf = 23}},
+        {"webm", {.crf = 34, .cpuUsed = 4, .rowMt = true, .deadline = "good"}},
+        {"avi",  {.quality = 4}},
+        {"mpeg", {.quality = 4}},
+        {"mp3",  {.quality = 4, .compressionLevel = 7}},
+        {"ogg",  {.quality = 4}},
+        {"jpeg", {.quality = 3}},
+        {"heif", {.preset = "veryfast", .crf = 24}},
+        {"webp", {.quality = 90, .compressionLevel = 2}},
+    });
+    addProfile("realtime", {
+        {"mp4",  {.preset = "ultrafast", .crf = 26}},
+        {"webm", {.crf = 36, .cpuUsed = 8, .rowMt = true, .deadline = "realtime"}},
+        {"avi",  {.quality = 6}},
+        {"mpeg", {.quality = 6}},
+        {"mp3",  {.quality = 6, .compressionLevel = 9}},
+        {"ogg",  {.quality = 3}},
+        {"jpeg", {.quality = 5}},
+        {"heif", {.preset = "ultrafast", .crf = 28}},
+        {"webp", {.quality = 80, .compressionLevel = 0}},
+    });
+}
+
+bool EncoderProfiles::load(const QString& filePath, QString* errorMessage)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage) { *errorMessage = "Couldn't open profile file " + filePath; }
+        return false;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (!document.isObject()) {
+        if (errorMessage) { *errorMessage = "Invalid profile file " + filePath + ": " + parseError.errorString(); }
+        return false;
+    }
+
+    const QJsonObject profiles = document.object();
+    for (auto it = profiles.constBegin(); it != profiles.constEnd(); ++it) {
+        applyJson(it.key(), it.value().toObject());
+    }
+    return true;
+}
+
+bool EncoderProfiles::loadDefaultFile(QString* errorMessage)
+{
+    QString folder = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
+    QString filePath = QDir(folder).filePath("profiles.json");
+    if (folder.isEmpty() || !QFile::exists(filePath)) { return true; }
+
+    return load(filePath, errorMessage);
+}
+
+EncoderSettings EncoderProfiles::settings(const QString& profile, FormatInfo format) const
+{
+    auto it = profiles_.constFind(profile);
+    if (it == profiles_.constEnd()) {
+        it = profiles_.constFind(defaultProfile());
+    }
+    return it->value(canonicalLabel(format));
+}
+
+void EncoderProfiles::addProfile(const QString& profile, const QHash<QString, EncoderSettings>& settings)
+{
+    // x264 is used for every quicktime and matroska format
+    QHash<QString, EncoderSettings> formats = settings;
+    for (const QString& label : sharedLabels()) {
+        formats.insert(label, settings.value("mp4"));
+    }
+
+    profiles_.insert(profile, formats);
+    names_ << profile;
+}
+
+void EncoderProfiles::applyJson(const QString& profile, const QJsonObject& formats)
+{
+    // new profiles start from balanced so formats missing from file still have sane values
+    if (!profiles_.contains(profile)) {
+        profiles_.insert(profile, profiles_.value("balanced"));
+        names_ << profile;
+    }
+    QHash<QString, EncoderSettings>& profileSettings = profiles_[profile];
+
+    // mp4 goes first to every format sharing x264 so their own values given in the same file
+    // are applied on top of it
+    for (auto it = formats.constBegin(); it != formats.constEnd(); ++it) {
+        if (canonicalLabel(it.key()) != "mp4") { continue; }
+        for (const QString& label : QStringList{"mp4"} + sharedLabels()) {
+            applyValues(profileSettings[label], it.value().toObject());
+        }
+    }
+    for (auto it = formats.constBegin(); it != formats.constEnd(); ++it) {
+        if (canonicalLabel(it.key()) == "mp4") { continue; }
+        applyValues(profileSettings[canonicalLabel(it.key())], it.value().toObject());
+    }
+}
+
+void EncoderProfiles::applyValues(EncoderSettings& settings, const QJsonObject& values)
+{
+    if (values.contains("preset"))              { settings.preset = values["preset"].toString(); }
+    if (values.contains("crf"))                 { settings.crf = values["crf"].toInt(-1); }
+    if (values.contains("quality"))             { settings.quality = values["quality"].toInt(-1); }
+    if (values.contains("cpu-used"))            { settings.cpuUsed = values["cpu-used"].toInt(-1); }
+    if (values.contains("row-mt"))              { settings.rowMt = values["row-mt"].toBool(); }
+    if (values.contains("deadline"))            { settings.deadline = values["deadline"].toString(); }
+    if (values.contains("lossless"))            { settings.lossless = values["lossless"].toBool(); }
+    if (values.contains("compression-level"))   { settings.compressionLevel = values["compression-level"].toInt(-1); }
+    if (values.contains("threads"))             { settings.threads = values["threads"].toInt(0); }
+}
+
+QString EncoderProfiles::canonicalLabel(FormatInfo format)
+{
+    FormatInfo canonical = FormatRegistry::canonical(format.fileType, format.enumValue);
+    return canonical.fileType == FileType::UNKNOWN ? format.label : canonical.label;
+}
+
+QString EncoderProfiles::canonicalLabel(const QString& label)
+{
+    FormatInfo format = FormatRegistry::fromSuffix(label);
+    return format.fileType == FileType::UNKNOWN ? label.toLower() : canonicalLabel(format);
+}
\ No newline at end of file
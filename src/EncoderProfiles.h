@@ -0,0 +1,54 @@
+#ifndef FORMAT_CONVERTER_ENCODERPROFILES_H
+#define FORMAT_CONVERTER_ENCODERPROFILES_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QStringList>
+
+#include "utils/CommonEnums.h"
+#include "utils/EncoderSettings.h"
+
+// named speed tiers mapping every output format to encoder settings. built-in profiles are
+// archive, balanced, fast and realtime. profiles can be tuned or added with a json file:
+//   { "fast": { "mp4": { "preset": "faster", "crf": 22, "threads": 2 } } }
+// mp4 settings are also used for m4v, mkv and mov, which can still be overridden one by one
+class EncoderProfiles {
+
+public:
+
+    EncoderProfiles();
+
+    // profile which keeps the original conversion quality
+    static QString defaultProfile() { return "archive"; }
+
+    // profiles found from file override built-in values field by field. returns false and
+    // sets errorMessage if file can't be read
+    bool load(const QString& filePath, QString* errorMessage = nullptr);
+    // profiles.json in application config folder, missing file isn't an error
+    bool loadDefaultFile(QString* errorMessage = nullptr);
+
+    bool contains(const QString& profile) const { return profiles_.contains(profile); }
+    QStringList names() const { return names_; }
+
+    // unknown profile falls back to default profile
+    EncoderSettings settings(const QString& profile, FormatInfo format) const;
+
+private:
+
+    // profile name -> format label -> settings. labels are canonical (jpeg, not jpg)
+    QHash<QString, QHash<QString, EncoderSettings>> profiles_;
+    QStringList names_;
+
+    void addProfile(const QString& profile, const QHash<QString, EncoderSettings>& settings);
+    void applyJson(const QString& profile, const QJsonObject& formats);
+    static void applyValues(EncoderSettings& settings, const QJsonObject& values);
+
+    // formats which get the settings of mp4 unless they are given their own
+    static QStringList sharedLabels() { return {"m4v", "mkv", "mov"}; }
+
+    static QString canonicalLabel(FormatInfo format);
+    static QString canonicalLabel(const QString& label);
+};
+
+
+#endif //FORMAT_CONVERTER_ENCODERPROFILES_H
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "ExifToolSession.h"
+
+#include <algorithm>
+
+#include <QRegularExpression>
+
+
+ExifToolSession::ExifToolSession(QObject* parent) : QObject(parent) {}
+
+ExifToolSession::~ExifToolSession()
+{
+    closing_ = true;
+    if (!process_ || process_->state() == QProcess::NotRunning) { return; }
+
+    // asking exiftool to exit cleanly, killing it if it doesn't
+    process_->write("-stay_open\nFalse\n");
+    if (!process_->waitForFinished(2000)) {
+        process_->kill();
+        process_->waitForFinished(1000);
+    }
+}
+
+void ExifToolSession::execute(int commandId, const QStringList& args)
+{
+    if (!std::all_of(args.cbegin(), args.cend(), &ExifToolSession::isStreamable)) {
+        executeSeparately(commandId, args);
+        return;
+    }
+
+    commands_.enqueue({commandId, args});
+
+    // session is started lazily and restarted on next command if it has died
+    if (!process_) {
+        startProcess();
+        return;
+    }
+    writeCommand(commands_.last());
+}
+
+void ExifToolSession::startProcess()
+{
+    outputBuffer_.clear();
+    errorBuffer_.clear();
+
+    process_ = new QProcess(this);
+    QProcess* process = process_;
+    ProcessPriorities::apply(process_, processPriority_);
+
+    // signals of a session that has already been replaced are ignored
+    connect(process_, &QProcess::readyReadStandardOutput, this, [this, process]() {
+        if (process == process_) { readChannel(QProcess::StandardOutput); }
+    });
+    connect(process_, &QProcess::readyReadStandardError, this, [this, process]() {
+        if (process == process_) { readChannel(QProcess::StandardError); }
+    });
+    connect(process_, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError processError) {
+        if (processError == QProcess::FailedToStart && process == process_) {
+            process_->deleteLater();
+            process_ = nullptr;
+            failAll("ExifTool couldn't be started!");
+        }
+    });
+    connect(process_, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+        [this, process](int exitCode) {
+        if (process == process_) {
+            processStopped("ExifTool session exited with code " + QString::number(exitCode) + "!");
+        }
+    });
+
+    // commands are read from stdin line by line until -stay_open False. paths are written as
+    // utf-8 so they are read the same way on every platform
+    process_->start("exiftool", {"-stay_open", "True", "-@", "-", "-common_args", "-charset", "filename=utf8"});
+
+    // QProcess buffers writes until the process is running
+    for (Command& command : commands_) {
+        command.output.clear();
+        command.errors.clear();
+        command.outputDone = false;
+        command.errorsDone = false;
+        writeCommand(command);
+    }
+}
+
+void ExifToolSession::writeCommand(const Command& command)
+{
+    QByteArray data;
+    for (const QString& arg : command.args) {
+        data += arg.toUtf8() + '\n';
+    }
+
+    // -echo4 is printed to stderr after execution so both channels get their own end marker
+    data += "-echo4\n" + readyMarker(command.id) + '\n';
+    data += "-execute" + QByteArray::number(command.id) + '\n';
+    process_->write(data);
+}
+
+void ExifToolSession::readChannel(QProcess::ProcessChannel channel)
+{
+    if (channel == QProcess::StandardOutput) {
+        outputBuffer_ += process_->readAllStandardOutput();
+    } else {
+        errorBuffer_ += process_->readAllStandardError();
+    }
+
+    // one read can include responses of several commands, and a channel can be ahead of the other
+    bool progressed = true;
+    while (progressed && !commands_.isEmpty()) {
+        progressed = false;
+        Command& head = commands_.head();
+        const QByteArray marker = readyMarker(head.id);
+
+        if (!head.outputDone) {
+            int index = outputBuffer_.indexOf(marker);
+            if (index >= 0) {
+                head.output = outputBuffer_.left(index);
+                outputBuffer_.remove(0, index + marker.size());
+                head.outputDone = true;
+                progressed = true;
+            }
+        }
+
+        if (!head.errorsDone) {
+            int index = errorBuffer_.indexOf(marker);
+            if (index >= 0) {
+                head.errors = errorBuffer_.left(index);
+                errorBuffer_.remove(0, index + marker.size());
+                head.errorsDone = true;
+                progressed = true;
+            }
+        }
+
+        if (head.outputDone && head.errorsDone) {
+            finishHeadCommand();
+            progressed = true;
+        }
+    }
+}
+
+void ExifToolSession::finishHeadCommand()
+{
+    const Command command = commands_.dequeue();
+    restarts_ = 0;
+
+    QString output = QString::fromUtf8(command.output).trimmed();
+    QString errors = QString::fromUtf8(command.errors).trimmed();
+
+    bool success = succeeded(output);
+
+    QString text = output;
+    if (!errors.isEmpty()) {
+        text += (text.isEmpty() ? "" : "\n") + errors;
+    }
+    emit commandFinished(command.id, success, text);
+}
+
+void ExifToolSession::processStopped(const QString& reason)
+{
+    if (closing_) { return; }
+
+    process_->deleteLater();
+    process_ = nullptr;
+    if (commands_.isEmpty()) { return; }
+
+    // command being executed is the one that took the session down
+    const Command command = commands_.dequeue();
+    emit commandFinished(command.id, false, reason);
+
+    if (++restarts_ > maxRestarts_) {
+        failAll(reason);
+        return;
+    }
+    if (!commands_.isEmpty()) {
+        startProcess();
+    }
+}
+
+void ExifToolSession::failAll(const QString& reason)
+{
+    restarts_ = 0;
+    while (!commands_.isEmpty()) {
+        emit commandFinished(commands_.dequeue().id, false, reason);
+    }
+}
+
+void ExifToolSession::executeSeparately(int commandId, const QStringList& args)
+{
+    // arguments go to argv as they are, result is reported like a command of the session
+    QProcess* process = new QProcess(this);
+    ProcessPriorities::apply(process, processPriority_);
+
+    connect(process, &QProcess::errorOccurred, this, [this, process, commandId](QProcess::ProcessError processError) {
+        if (processError != QProcess::FailedToStart) { return; }
+        process->deleteLater();
+        emit commandFinished(commandId, false, "ExifTool couldn't be started!");
+    });
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+        [this, process, commandId]() {
+        process->deleteLater();
+        QString output = QString::fromUtf8(process->readAllStandardOutput()).trimmed();
+        QString errors = QString::fromUtf8(process->readAllStandardError()).trimmed();
+
+        bool success = succeeded(output);
+        QString text = output;
+        if (!errors.isEmpty()) {
+            text += (text.isEmpty() ? "" : "\n") + errors;
+        }
+        emit commandFinished(commandId, success, text);
+    });
+
+    process->start("exiftool", QStringList{"-charset", "filename=utf8"} + args);
+}
+
+QByteArray ExifToolSession::readyMarker(int commandId)
+{
+    return "{ready" + QByteArray::number(commandId) + "}";
+}
+
+bool ExifToolSession::isStreamable(const QString& arg)
+{
+    if (arg.isEmpty()) { return true; }
+    return !arg.contains('\n') && !arg.contains('\r') && !arg.startsWith('#')
+           && !arg.front().isSpace() && !arg.back().isSpace();
+}
+
+bool ExifToolSession::succeeded(const QString& output)
+{
+    // "1 image files updated", "1 image files created" or "1 image files unchanged" when there
+    // was nothing to remove. "files weren't updated due to errors" and read errors fail
+    static const QRegularExpression summary(R"((\d+) (?:image )?files? (updated|created|unchanged))");
+    static const QRegularExpression failed(R"((\d+) (?:image )?files? (?:weren't|could not be|were not))");
+
+    int written = 0;
+    for (auto it = summary.globalMatch(output); it.hasNext();) {
+        written += it.next().captured(1).toInt();
+    }
+    for (auto it = failed.globalMatch(output); it.hasNext();) {
+        if (it.next().captured(1).toInt() > 0) { return false; }
+    }
+    return written > 0;
+}
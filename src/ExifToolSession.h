@@ -0,0 +1,72 @@
+#ifndef FORMAT_CONVERTER_EXIFTOOLSESSION_H
+#define FORMAT_CONVERTER_EXIFTOOLSESSION_H
+
+#include <QByteArray>
+#include <QProcess>
+#include <QQueue>
+#include <QStringList>
+
+#include "utils/ProcessPriority.h"
+
+// long running exiftool process (-stay_open) which executes commands streamed to its stdin.
+// commands are executed in order and every response ends with {ready<commandId>} marker.
+class ExifToolSession : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit ExifToolSession(QObject* parent = nullptr);
+    ~ExifToolSession() override;
+
+    // queues command, command id must be unique between pending commands of this session.
+    // arguments which can't be written to the argument stream as they are (newlines, spaces
+    // at either end, leading #) are given to a separate exiftool process instead
+    void execute(int commandId, const QStringList& args);
+
+    int pendingCommands() const { return commands_.size(); }
+
+    // used when the session is started or restarted next time
+    void setProcessPriority(const ProcessPriority& priority) { processPriority_ = priority; }
+
+private:
+
+    struct Command {
+        int id;
+        QStringList args;
+        QByteArray output;
+        QByteArray errors;
+        bool outputDone = false;
+        bool errorsDone = false;
+    };
+
+    // how many times session is restarted in a row before pending commands are failed
+    static constexpr int maxRestarts_ = 3;
+
+    QProcess* process_ = nullptr;
+    ProcessPriority processPriority_;
+    QQueue<Command> commands_;
+    QByteArray outputBuffer_;
+    QByteArray errorBuffer_;
+    int restarts_ = 0;
+    bool closing_ = false;
+
+    void startProcess();
+    void writeCommand(const Command& command);
+    void readChannel(QProcess::ProcessChannel channel);
+    void finishHeadCommand();
+    void processStopped(const QString& reason);
+    void failAll(const QString& reason);
+    void executeSeparately(int commandId, const QStringList& args);
+
+    static QByteArray readyMarker(int commandId);
+    // exiftool trims argument lines and skips comment lines of argument files
+    static bool isStreamable(const QString& arg);
+    // summary lines tell whether files were written, errors of single tags are only printed
+    static bool succeeded(const QString& output);
+
+signals:
+    void commandFinished(int commandId, bool success, const QString& output);
+};
+
+
+#endif //FORMAT_CONVERTER_EXIFTOOLSESSION_H
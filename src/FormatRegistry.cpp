@@ -0,0 +1,225 @@
+#include "FormatRegistry.h"
+
+#include <cstring>
+#include <initializer_list>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+namespace {
+
+    // ebml doctype and ftyp brands are inside the first kilobytes
+    constexpr qint64 headerSize = 4096;
+
+    int formatKey(FileType fileType, int enumValue)
+    {
+        return static_cast<int>(fileType) << 8 | enumValue;
+    }
+
+    const QHash<QString, FormatInfo>& suffixTable()
+    {
+        static const QHash<QString, FormatInfo> table = []() {
+            QHash<QString, FormatInfo> formats;
+            for (const FormatInfo& it : fileFormats) {
+                formats.insert(it.label, it);
+            }
+            return formats;
+        }();
+        return table;
+    }
+
+    const QHash<int, FormatInfo>& canonicalTable()
+    {
+        static const QHash<int, FormatInfo> table = []() {
+            QHash<int, FormatInfo> formats;
+            for (const FormatInfo& it : fileFormats) {
+                int key = formatKey(it.fileType, it.enumValue);
+                if (!formats.contains(key)) { formats.insert(key, it); }
+            }
+            return formats;
+        }();
+        return table;
+    }
+
+    bool hasBytes(QByteArrayView data, qsizetype offset, const char* magic, qsizetype length)
+    {
+        return data.size() >= offset + length && std::memcmp(data.data() + offset, magic, length) == 0;
+    }
+
+    bool hasBytes(QByteArrayView data, qsizetype offset, const char* magic)
+    {
+        return hasBytes(data, offset, magic, static_cast<qsizetype>(std::strlen(magic)));
+    }
+
+    FormatInfo audio(AudioFormats format) { return FormatRegistry::canonical(FileType::AUDIO, static_cast<int>(format)); }
+    FormatInfo video(VideoFormats format) { return FormatRegistry::canonical(FileType::VIDEO, static_cast<int>(format)); }
+    FormatInfo image(ImageFormats format) { return FormatRegistry::canonical(FileType::IMAGE, static_cast<int>(format)); }
+
+    // content fits all candidates equally so suffix decides, fallback is used for other suffixes
+    FormatInfo choose(const FormatInfo& hint, std::initializer_list<FormatInfo> candidates, const FormatInfo& fallback)
+    {
+        for (const FormatInfo& candidate : candidates) {
+            if (candidate.fileType == hint.fileType && candidate.enumValue == hint.enumValue) {
+                return hint;
+            }
+        }
+        return fallback;
+    }
+
+    // ebml variable length integer, ids keep their length marker and sizes drop it
+    bool readVint(QByteArrayView data, qsizetype& pos, int maxLength, bool keepMarker, quint64& value)
+    {
+        if (pos >= data.size()) { return false; }
+        const auto first = static_cast<uchar>(data.at(pos));
+        int length = 1;
+        while (length <= maxLength && !(first & (0x80 >> (length - 1)))) { ++length; }
+        if (length > maxLength || pos + length > data.size()) { return false; }
+
+        value = keepMarker ? first : first & (0xFF >> length);
+        for (int i = 1; i < length; ++i) {
+            value = value << 8 | static_cast<uchar>(data.at(pos + i));
+        }
+        pos += length;
+        return true;
+    }
+
+    // doctype element of the ebml header, empty when header is cut or malformed
+    QByteArray ebmlDocType(QByteArrayView header)
+    {
+        qsizetype pos = 0;
+        quint64 id = 0;
+        quint64 size = 0;
+        if (!readVint(header, pos, 4, true, id) || id != 0x1A45DFA3 || !readVint(header, pos, 8, false, size)) {
+            return {};
+        }
+
+        const qsizetype end = size < quint64(header.size() - pos) ? pos + qsizetype(size) : header.size();
+        while (pos < end) {
+            if (!readVint(header, pos, 4, true, id) || !readVint(header, pos, 8, false, size)) { return {}; }
+            if (size > quint64(end - pos)) { return {}; }
+            if (id == 0x4282) {
+                // strings may be padded with zeros
+                QByteArray docType = header.sliced(pos, qsizetype(size)).toByteArray();
+                while (docType.endsWith('\0')) { docType.chop(1); }
+                return docType;
+            }
+            pos += qsizetype(size);
+        }
+        return {};
+    }
+
+    FormatInfo isoMediaFormat(QByteArrayView header, const FormatInfo& hint)
+    {
+        static const QList<QByteArray> heifBrands = {"heic", "heix", "heim", "heis", "hevc", "mif1", "msf1"};
+
+        QByteArray brand = header.size() >= 12 ? header.sliced(8, 4).toByteArray() : QByteArray();
+        if (heifBrands.contains(brand)) {
+            return image(ImageFormats::HEIF);
+        }
+
+        FormatInfo fallback = video(VideoFormats::MP4);
+        if (brand == "M4A " || brand == "M4B ")    { fallback = audio(AudioFormats::ALAC_M4A); }
+        else if (brand == "M4V ")                  { fallback = video(VideoFormats::M4V); }
+        else if (brand == "qt  ")                  { fallback = video(VideoFormats::MOV); }
+
+        return choose(hint, {video(VideoFormats::MP4), video(VideoFormats::M4V), video(VideoFormats::MOV),
+                             audio(AudioFormats::ALAC_M4A)}, fallback);
+    }
+}
+
+FormatInfo FormatRegistry::fromSuffix(const QString& suffix)
+{
+    return suffixTable().value(suffix.toLower(), {FileType::UNKNOWN});
+}
+
+FormatInfo FormatRegistry::fromPath(const QString& filePath)
+{
+    return fromSuffix(QFileInfo(filePath).suffix());
+}
+
+FormatInfo FormatRegistry::canonical(FileType fileType, int enumValue)
+{
+    return canonicalTable().value(formatKey(fileType, enumValue), {FileType::UNKNOWN});
+}
+
+FormatInfo FormatRegistry::detect(const QString& filePath)
+{
+    FormatInfo hint = fromPath(filePath);
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) { return hint; }
+
+    qint64 size = qMin(file.size(), headerSize);
+    if (size <= 0) { return hint; }
+
+    // header is mapped instead of read, reading is fallback for files which can't be mapped
+    if (uchar* data = file.map(0, size)) {
+        FormatInfo format = sniff(QByteArrayView(data, size), hint);
+        file.unmap(data);
+        return format;
+    }
+    return sniff(file.read(size), hint);
+}
+
+FormatInfo FormatRegistry::sniff(QByteArrayView header, const FormatInfo& hint)
+{
+    const auto byte = [&header](qsizetype i) { return static_cast<uchar>(header.at(i)); };
+
+    // images
+    if (hasBytes(header, 0, "\xFF\xD8\xFF"))                   { return image(ImageFormats::JPEG); }
+    if (hasBytes(header, 0, "\x89PNG\r\n\x1A\n"))              { return image(ImageFormats::PNG); }
+    if (hasBytes(header, 0, "GIF87a") || hasBytes(header, 0, "GIF89a")) { return image(ImageFormats::GIF); }
+    if (hasBytes(header, 0, "II*\0", 4) || hasBytes(header, 0, "MM\0*", 4)) { return image(ImageFormats::TIFF); }
+    // ico magic is also start of a 256 byte iso-bmff box, so image count and reserved byte and
+    // planes of first directory entry are checked too
+    if (hasBytes(header, 0, "\0\0\1\0", 4) && header.size() >= 22 && (byte(4) | byte(5)) != 0
+        && byte(9) == 0 && byte(11) == 0 && byte(10) <= 1) {
+        return image(ImageFormats::ICO);
+    }
+    if (hasBytes(header, 0, "BM") && hasBytes(header, 6, "\0\0\0\0", 4)) { return image(ImageFormats::BMP); }
+
+    // riff and iff containers
+    if (hasBytes(header, 0, "RIFF")) {
+        if (hasBytes(header, 8, "WAVE"))   { return audio(AudioFormats::WAV); }
+        if (hasBytes(header, 8, "AVI "))   { return video(VideoFormats::AVI); }
+        if (hasBytes(header, 8, "WEBP"))   { return image(ImageFormats::WEBP); }
+    }
+    if (hasBytes(header, 0, "FORM") && (hasBytes(header, 8, "AIFF") || hasBytes(header, 8, "AIFC"))) {
+        return audio(AudioFormats::AIFF);
+    }
+
+    // audio
+    if (hasBytes(header, 0, "OggS"))   { return audio(AudioFormats::OGG); }
+    if (hasBytes(header, 0, "fLaC"))   { return audio(AudioFormats::FLAC); }
+    if (hasBytes(header, 0, "ID3")) {
+        return choose(hint, {audio(AudioFormats::MP3), audio(AudioFormats::AAC)}, audio(AudioFormats::MP3));
+    }
+    if (header.size() >= 2 && byte(0) == 0xFF && (byte(1) & 0xE0) == 0xE0) {
+        // adts aac has layer bits zero, mpeg audio layers are 1-3
+        bool adts = (byte(1) & 0xF6) == 0xF0;
+        return adts ? audio(AudioFormats::AAC) : audio(AudioFormats::MP3);
+    }
+
+    // video containers
+    if (hasBytes(header, 0, "\x1A\x45\xDF\xA3")) {
+        return ebmlDocType(header) == "webm" ? video(VideoFormats::WEBM) : video(VideoFormats::MKV);
+    }
+    if (hasBytes(header, 0, "\x30\x26\xB2\x75\x8E\x66\xCF\x11")) {
+        return choose(hint, {audio(AudioFormats::WMA), video(VideoFormats::WMV)}, video(VideoFormats::WMV));
+    }
+    if (hasBytes(header, 0, "FLV"))   { return video(VideoFormats::FLV); }
+    if (hasBytes(header, 0, "\0\0\1\xBA", 4) || hasBytes(header, 0, "\0\0\1\xB3", 4)) {
+        return video(VideoFormats::MPEG);
+    }
+    if (hasBytes(header, 4, "ftyp")) {
+        return isoMediaFormat(header, hint);
+    }
+    // old quicktime files start straight with atoms
+    if (hasBytes(header, 4, "moov") || hasBytes(header, 4, "mdat") || hasBytes(header, 4, "wide")) {
+        return choose(hint, {video(VideoFormats::MP4), video(VideoFormats::M4V), video(VideoFormats::MOV)},
+                      video(VideoFormats::MOV));
+    }
+
+    return hint;
+}
\ No newline at end of file
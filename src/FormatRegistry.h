@@ -0,0 +1,33 @@
+#ifndef FORMAT_CONVERTER_FORMATREGISTRY_H
+#define FORMAT_CONVERTER_FORMATREGISTRY_H
+
+#include <QByteArrayView>
+#include <QString>
+
+#include "utils/CommonEnums.h"
+
+// finds supported formats by suffix or by file content. lookups are hashed and detection reads
+// only a small mapped header of the file, so classifying files never needs ffprobe
+class FormatRegistry {
+public:
+
+    // case insensitive, UNKNOWN if suffix isn't supported
+    static FormatInfo fromSuffix(const QString& suffix);
+    static FormatInfo fromPath(const QString& filePath);
+
+    // first label of the format in fileFormats (jpeg for jpg)
+    static FormatInfo canonical(FileType fileType, int enumValue);
+
+    // format from magic bytes of the file. suffix is used when content matches more than one
+    // format of same family (mp4/m4v/mov, mkv/webm, wma/wmv) and when content isn't recognized
+    static FormatInfo detect(const QString& filePath);
+    static FormatInfo sniff(QByteArrayView header, const FormatInfo& hint);
+
+private:
+
+    FormatRegistry() = delete;
+    ~FormatRegistry() = delete;
+};
+
+
+#endif //FORMAT_CONVERTER_FORMATREGISTRY_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "ImageEngine.h"
+
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QThread>
+
+namespace {
+
+    // ffmpeg mjpeg -q:v goes from 2 (best) to 31, qt quality from 0 to 100 (best)
+    int jpegQuality(int qscale)
+    {
+        if (qscale < 0) { return -1; }
+        return qBound(0, 100 - (qscale - 1) * 5, 100);
+    }
+}
+
+ImageEngine::ImageEngine(QObject* parent)
+: QObject(parent)
+{
+    pool_.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+ImageEngine::~ImageEngine()
+{
+    for (const auto& cancelled : std::as_const(cancelFlags_)) {
+        *cancelled = true;
+    }
+    pool_.waitForDone();
+}
+
+void ImageEngine::start(int jobId, const QString& inputFilePath, const QString& outputFilePath,
+                        FormatInfo outputFormat, const EncoderSettings& settings)
+{
+    auto cancelled = std::make_shared<std::atomic_bool>(false);
+    cancelFlags_.insert(jobId, cancelled);
+
+    const QByteArray format = qtFormat(outputFormat);
+    int quality = -1;
+    switch (static_cast<ImageFormats>(outputFormat.enumValue)) {
+        case ImageFormats::JPEG:
+            quality = jpegQuality(settings.quality);
+            break;
+        case ImageFormats::WEBP:
+            // webp plugin writes lossless at quality 100
+            quality = settings.lossless ? 100 : settings.quality;
+            break;
+        default:
+            break;
+    }
+
+    pool_.start([this, jobId, inputFilePath, outputFilePath, format, quality, cancelled]() {
+        auto finish = [this, jobId](bool success, const QString& errorMessage) {
+            QMetaObject::invokeMethod(this, [this, jobId, success, errorMessage]() {
+                cancelFlags_.remove(jobId);
+                emit finished(jobId, success, errorMessage);
+            }, Qt::QueuedConnection);
+        };
+
+        if (*cancelled) { return finish(false, "Conversion cancelled"); }
+
+        // content decides input format, ffmpeg doesn't trust suffix either
+        QImageReader reader(inputFilePath);
+        reader.setDecideFormatFromContent(true);
+        reader.setAutoTransform(false);
+        reader.setAllocationLimit(allocationLimit);
+
+        QImage image = reader.read();
+        if (image.isNull()) { return finish(false, "Couldn't read image: " + reader.errorString()); }
+        if (*cancelled) { return finish(false, "Conversion cancelled"); }
+
+        QImageWriter writer(outputFilePath, format);
+        if (quality >= 0) { writer.setQuality(quality); }
+        if (!writer.write(image)) {
+            QFile::remove(outputFilePath);
+            return finish(false, "Couldn't write image: " + writer.errorString());
+        }
+
+        // cancelled job may already have a new job writing the same output
+        if (*cancelled) {
+            QFile::remove(outputFilePath);
+            return finish(false, "Conversion cancelled");
+        }
+        finish(true, {});
+    });
+}
+
+void ImageEngine::cancel(int jobId)
+{
+    if (auto cancelled = cancelFlags_.value(jobId)) {
+        *cancelled = true;
+    }
+}
+
+bool ImageEngine::canConvert(FormatInfo inputFormat, FormatInfo outputFormat)
+{
+    if (inputFormat.fileType != FileType::IMAGE || outputFormat.fileType != FileType::IMAGE) { return false; }
+
+    // plugins are found once, webp and tiff come from qtimageformats which may be missing
+    static const QList<QByteArray> readable = QImageReader::supportedImageFormats();
+    static const QList<QByteArray> writable = QImageWriter::supportedImageFormats();
+
+    QByteArray input = qtFormat(inputFormat);
+    QByteArray output = qtFormat(outputFormat);
+    return !input.isEmpty() && !output.isEmpty() && readable.contains(input) && writable.contains(output);
+}
+
+QByteArray ImageEngine::qtFormat(FormatInfo format)
+{
+    switch (static_cast<ImageFormats>(format.enumValue)) {
+        case ImageFormats::JPEG:    return "jpeg";
+        case ImageFormats::PNG:     return "png";
+        case ImageFormats::GIF:     return "gif";
+        case ImageFormats::BMP:     return "bmp";
+        case ImageFormats::TIFF:    return "tiff";
+        case ImageFormats::WEBP:    return "webp";
+        case ImageFormats::ICO:     return "ico";
+        default:                    return {};
+    }
+}
\ No newline at end of file
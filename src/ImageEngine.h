@@ -0,0 +1,48 @@
+#ifndef FORMAT_CONVERTER_IMAGEENGINE_H
+#define FORMAT_CONVERTER_IMAGEENGINE_H
+
+#include <atomic>
+#include <memory>
+
+#include <QHash>
+#include <QObject>
+#include <QThreadPool>
+
+#include "utils/CommonEnums.h"
+#include "utils/EncoderSettings.h"
+
+// in-process image conversion with QImageReader/QImageWriter. decoding and encoding run on a
+// thread pool so no process is started per image. memory is bounded by pool size and by
+// allocation limit of a single decoded image. formats without Qt plugin (HEIF, and GIF which Qt
+// can only read) are left to ffmpeg
+class ImageEngine : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit ImageEngine(QObject* parent = nullptr);
+    ~ImageEngine() override;
+
+    // same first frame and quality that ffmpeg imageArgs produces
+    void start(int jobId, const QString& inputFilePath, const QString& outputFilePath,
+               FormatInfo outputFormat, const EncoderSettings& settings);
+    void cancel(int jobId);
+
+    static bool canConvert(FormatInfo inputFormat, FormatInfo outputFormat);
+
+    // megabytes of single decoded image
+    static constexpr int allocationLimit = 256;
+
+private:
+
+    QThreadPool pool_;
+    QHash<int, std::shared_ptr<std::atomic_bool>> cancelFlags_;
+
+    static QByteArray qtFormat(FormatInfo format);
+
+signals:
+    void finished(int jobId, bool success, const QString& errorMessage);
+};
+
+
+#endif //FORMAT_CONVERTER_IMAGEENGINE_H
\ No newline at end of file
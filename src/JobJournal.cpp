@@ -0,0 +1,279 @@
+#include "JobJournal.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include "utils/FileUtils.h"
+
+namespace {
+
+    constexpr qint64 hashedBlockSize = 64 * 1024;
+
+    QString stateName(State state)
+    {
+        switch (state) {
+            case State::QUEUED:     return "queued";
+            case State::DONE:       return "done";
+            case State::FAILED:     return "failed";
+            default:                return "running";
+        }
+    }
+
+    QString engineName(Engine engine)
+    {
+        switch (engine) {
+            case Engine::PROCESS:   return "process";
+            case Engine::LIBAV:     return "libav";
+            default:                return "default";
+        }
+    }
+}
+
+JobJournal::JobJournal(const QString& filePath)
+: filePath_(filePath), file_(filePath) {}
+
+bool JobJournal::open(QString* errorMessage)
+{
+    if (file_.exists()) {
+        if (!file_.open(QIODevice::ReadOnly)) {
+            *errorMessage = "Job journal " + filePath_ + " can't be read: " + file_.errorString();
+            return false;
+        }
+        while (!file_.atEnd()) {
+            QJsonObject object = QJsonDocument::fromJson(file_.readLine()).object();
+            Entry entry;
+            if (!fromJson(object, entry)) { continue; }
+
+            QString entryKey = key(entry.job);
+            if (!entries_.contains(entryKey)) { order_.append(entryKey); }
+
+            // hashes are written when they change, later lines keep them
+            const Entry previous = entries_.value(entryKey);
+            if (entry.inputHash.isEmpty()) { entry.inputHash = previous.inputHash; }
+            if (entry.doneHash.isEmpty()) {
+                entry.doneHash = previous.doneHash;
+                entry.doneOutputs = previous.doneOutputs;
+            }
+            entries_.insert(entryKey, entry);
+        }
+        file_.close();
+    }
+
+    // failed jobs are dropped unless they completed earlier, running them again is up to the user
+    QSaveFile compacted(filePath_);
+    if (!QDir().mkpath(QFileInfo(filePath_).absolutePath()) || !compacted.open(QIODevice::WriteOnly)) {
+        *errorMessage = "Job journal " + filePath_ + " can't be written: " + compacted.errorString();
+        return false;
+    }
+    QStringList order;
+    for (const QString& entryKey : std::as_const(order_)) {
+        const Entry& entry = entries_[entryKey];
+        if (entry.state == State::FAILED && entry.doneHash.isEmpty()) {
+            entries_.remove(entryKey);
+            continue;
+        }
+        if (entry.state != State::DONE) {
+            QFile::remove(FileUtils::partialFilePath(entry.job.outputFilePath));
+            for (const QString& extraOutputFilePath : entry.job.extraOutputFilePaths) {
+                QFile::remove(FileUtils::partialFilePath(extraOutputFilePath));
+            }
+        }
+        compacted.write(QJsonDocument(toJson(entry)).toJson(QJsonDocument::Compact) + '\n');
+        order << entryKey;
+    }
+    order_ = order;
+    if (!compacted.commit()) {
+        *errorMessage = "Job journal " + filePath_ + " can't be written: " + compacted.errorString();
+        return false;
+    }
+
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        *errorMessage = "Job journal " + filePath_ + " can't be opened: " + file_.errorString();
+        return false;
+    }
+    return true;
+}
+
+void JobJournal::record(const ConversionJob& job, State state)
+{
+    QString entryKey = key(job);
+    if (!entries_.contains(entryKey)) { order_.append(entryKey); }
+
+    Entry& entry = entries_[entryKey];
+    entry.job = job;
+    entry.job.outputFilePath = outputFilePath(job);
+    entry.job.finalOutputFilePath.clear();
+    if (!job.finalExtraOutputFilePaths.isEmpty()) {
+        entry.job.extraOutputFilePaths = job.finalExtraOutputFilePaths;
+        entry.job.finalExtraOutputFilePaths.clear();
+    }
+    entry.state = state;
+
+    // input is fingerprinted when its conversion starts, earlier completion is kept while the
+    // same job is queued again
+    if (state == State::RUNNING) {
+        entry.inputHash = inputHash(job.inputFilePath);
+    }
+    if (state == State::DONE && !entry.inputHash.isEmpty()) {
+        entry.doneHash = doneHash(entry.inputHash, entry.job);
+        entry.doneOutputs = outputStates(entry.job);
+    }
+    write(entry);
+}
+
+bool JobJournal::isDone(const ConversionJob& job) const
+{
+    auto it = entries_.constFind(key(job));
+    if (it == entries_.constEnd() || it->doneHash.isEmpty()) { return false; }
+
+    // outputs which are missing or have been changed since are made again
+    if (outputStates(it->job) != it->doneOutputs) { return false; }
+
+    return it->doneHash == doneHash(inputHash(job.inputFilePath), job);
+}
+
+QList<ConversionJob> JobJournal::unfinishedJobs() const
+{
+    QList<ConversionJob> jobs;
+    for (const QString& entryKey : order_) {
+        const Entry& entry = entries_[entryKey];
+        if (entry.state != State::DONE && entry.state != State::FAILED) {
+            jobs.append(entry.job);
+        }
+    }
+    return jobs;
+}
+
+QString JobJournal::inputHash(const QString& filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) { return {}; }
+
+    QFileInfo info(filePath);
+    QCryptographicHash hash(QCryptographicHash::Blake2b_256);
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    hash.addData(file.read(hashedBlockSize));
+    if (file.size() > hashedBlockSize * 2) {
+        file.seek(file.size() - hashedBlockSize);
+    }
+    hash.addData(file.read(hashedBlockSize));
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QString JobJournal::doneHash(const QString& inputHash, const ConversionJob& job)
+{
+    // everything that changes the output, other profile or renditions give other outputs
+    QStringList settings {
+        inputHash,
+        jobTypeToString(job.type),
+        engineName(job.engine),
+        job.profile,
+        job.saveMetadata ? "metadata" : "no-metadata"
+    };
+    for (const QString& extraOutputFilePath : job.extraOutputFilePaths) {
+        settings << QFileInfo(extraOutputFilePath).absoluteFilePath();
+    }
+    for (const Rendition& rendition : job.renditions) {
+        settings << QString("%1:%2").arg(rendition.height).arg(rendition.bitrate);
+    }
+    return QString::fromLatin1(QCryptographicHash::hash(settings.join('\n').toUtf8(),
+                                                        QCryptographicHash::Blake2b_256).toHex());
+}
+
+QStringList JobJournal::outputStates(const ConversionJob& job)
+{
+    QStringList states;
+    for (const QString& filePath : QStringList{job.outputFilePath} + job.extraOutputFilePaths) {
+        QFileInfo info(filePath);
+        states << (info.exists() ? QString("%1:%2").arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch())
+                                 : QString());
+    }
+    return states;
+}
+
+void JobJournal::write(const Entry& entry)
+{
+    // flushed line by line so it is in the kernel before the next state change
+    file_.write(QJsonDocument(toJson(entry)).toJson(QJsonDocument::Compact) + '\n');
+    file_.flush();
+}
+
+QString JobJournal::key(const ConversionJob& job)
+{
+    return QFileInfo(job.inputFilePath).absoluteFilePath() + '\n'
+           + QFileInfo(outputFilePath(job)).absoluteFilePath();
+}
+
+QString JobJournal::outputFilePath(const ConversionJob& job)
+{
+    return job.finalOutputFilePath.isEmpty() ? job.outputFilePath : job.finalOutputFilePath;
+}
+
+QJsonObject JobJournal::toJson(const Entry& entry)
+{
+    QJsonObject object {
+        {"state", stateName(entry.state)},
+        {"type", jobTypeToString(entry.job.type)},
+        {"input", entry.job.inputFilePath},
+        {"output", entry.job.outputFilePath},
+        {"metadata", entry.job.saveMetadata},
+        {"engine", engineName(entry.job.engine)},
+        {"profile", entry.job.profile},
+        {"priority", jobPriorityToString(entry.job.priority)}
+    };
+    if (!entry.inputHash.isEmpty()) {
+        object["input_hash"] = entry.inputHash;
+    }
+    if (!entry.doneHash.isEmpty()) {
+        object["done_hash"] = entry.doneHash;
+        object["done_outputs"] = QJsonArray::fromStringList(entry.doneOutputs);
+    }
+    if (!entry.job.extraOutputFilePaths.isEmpty()) {
+        object["extra_outputs"] = QJsonArray::fromStringList(entry.job.extraOutputFilePaths);
+    }
+    if (!entry.job.renditions.isEmpty()) {
+        QJsonArray renditions;
+        for (const Rendition& rendition : entry.job.renditions) {
+            renditions.append(QJsonObject{{"height", rendition.height}, {"bitrate", rendition.bitrate}});
+        }
+        object["renditions"] = renditions;
+    }
+    return object;
+}
+
+bool JobJournal::fromJson(const QJsonObject& object, Entry& entry)
+{
+    const QString state = object["state"].toString();
+    if (state == "queued")          { entry.state = State::QUEUED; }
+    else if (state == "running")    { entry.state = State::RUNNING; }
+    else if (state == "done")       { entry.state = State::DONE; }
+    else if (state == "failed")     { entry.state = State::FAILED; }
+    else                            { return false; }
+
+    const QString engine = object["engine"].toString();
+    entry.job.engine = engine == "process" ? Engine::PROCESS : engine == "libav" ? Engine::LIBAV : Engine::DEFAULT;
+    entry.job.type = jobTypeFromString(object["type"].toString());
+    entry.job.inputFilePath = object["input"].toString();
+    entry.job.outputFilePath = object["output"].toString();
+    entry.job.saveMetadata = object["metadata"].toBool();
+    entry.job.profile = object["profile"].toString();
+    jobPriorityFromString(object["priority"].toString(), &entry.job.priority);
+    for (const QJsonValue& value : object["extra_outputs"].toArray()) {
+        entry.job.extraOutputFilePaths.append(value.toString());
+    }
+    for (const QJsonValue& value : object["renditions"].toArray()) {
+        entry.job.renditions.append({value["height"].toInt(), value["bitrate"].toInt()});
+    }
+    entry.inputHash = object["input_hash"].toString();
+    entry.doneHash = object["done_hash"].toString();
+    for (const QJsonValue& value : object["done_outputs"].toArray()) {
+        entry.doneOutputs.append(value.toString());
+    }
+
+    return !entry.job.inputFilePath.isEmpty() && !entry.job.outputFilePath.isEmpty();
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef FORMAT_CONVERTER_JOBJOURNAL_H
+#define FORMAT_CONVERTER_JOBJOURNAL_H
+
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+#include <QStringList>
+
+#include "utils/ConversionJob.h"
+
+// append-only json lines file of job states (queued, running, done, failed). jobs are
+// identified by input and output path, so after a crash the journal tells which outputs are
+// complete and which jobs have to be run again. last line can be cut by the crash, it is skipped
+class JobJournal {
+public:
+
+    explicit JobJournal(const QString& filePath);
+    ~JobJournal() = default;
+
+    // replays existing journal and rewrites it with only the latest state of each job, then
+    // keeps it open for appending. partial outputs of unfinished jobs are removed
+    bool open(QString* errorMessage);
+    QString filePath() const { return filePath_; }
+
+    void record(const ConversionJob& job, State state);
+
+    // done earlier from the same input with the same settings, and outputs are still as they
+    // were left then
+    bool isDone(const ConversionJob& job) const;
+
+    // jobs which were queued or running when the journal was last written, in queue order
+    QList<ConversionJob> unfinishedJobs() const;
+
+    // size, modification time and first and last 64 KiB. reading whole input for every job
+    // would cost as much as converting small files
+    static QString inputHash(const QString& filePath);
+
+private:
+
+    struct Entry {
+        ConversionJob job;
+        State state = State::QUEUED;
+        QString inputHash;          // input when job was last started
+        QString doneHash;           // input and job settings when output was last completed
+        QStringList doneOutputs;    // size and modification time of every output at that time
+    };
+
+    QString filePath_;
+    QFile file_;
+    QHash<QString, Entry> entries_;
+    QStringList order_;
+
+    void write(const Entry& entry);
+
+    static QString key(const ConversionJob& job);
+    static QString doneHash(const QString& inputHash, const ConversionJob& job);
+    static QStringList outputStates(const ConversionJob& job);
+    static QString outputFilePath(const ConversionJob& job);
+    static QJsonObject toJson(const Entry& entry);
+    static bool fromJson(const QJsonObject& object, Entry& entry);
+};
+
+
+#endif //FORMAT_CONVERTER_JOBJOURNAL_H
\ No newline at end of file
@@ -0,0 +1,824 @@
+#include "LibavEngine.h"
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include <QFile>
+#include <QSet>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+
+    // codec capability lists, nullptr means everything is supported. lists in AVCodec are deprecated
+    // since ffmpeg 7.1 (libavcodec 61.13), older versions only have those
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    template<typename T>
+    const T* supportedConfig(const AVCodecContext* context, const AVCodec* codec, AVCodecConfig config)
+    {
+        const void* configs = nullptr;
+        if (avcodec_get_supported_config(context, codec, config, 0, &configs, nullptr) < 0) { return nullptr; }
+        return static_cast<const T*>(configs);
+    }
+
+    const AVPixelFormat* supportedPixelFormats(const AVCodecContext* context, const AVCodec* codec)
+    {
+        return supportedConfig<AVPixelFormat>(context, codec, AV_CODEC_CONFIG_PIX_FORMAT);
+    }
+
+    const int* supportedSampleRates(const AVCodecContext* context, const AVCodec* codec)
+    {
+        return supportedConfig<int>(context, codec, AV_CODEC_CONFIG_SAMPLE_RATE);
+    }
+
+    const AVSampleFormat* supportedSampleFormats(const AVCodecContext* context, const AVCodec* codec)
+    {
+        return supportedConfig<AVSampleFormat>(context, codec, AV_CODEC_CONFIG_SAMPLE_FORMAT);
+    }
+
+    const AVChannelLayout* supportedChannelLayouts(const AVCodecContext* context, const AVCodec* codec)
+    {
+        return supportedConfig<AVChannelLayout>(context, codec, AV_CODEC_CONFIG_CHANNEL_LAYOUT);
+    }
+#else
+    const AVPixelFormat* supportedPixelFormats(const AVCodecContext*, const AVCodec* codec) { return codec->pix_fmts; }
+    const int* supportedSampleRates(const AVCodecContext*, const AVCodec* codec) { return codec->supported_samplerates; }
+    const AVSampleFormat* supportedSampleFormats(const AVCodecContext*, const AVCodec* codec) { return codec->sample_fmts; }
+    const AVChannelLayout* supportedChannelLayouts(const AVCodecContext*, const AVCodec* codec) { return codec->ch_layouts; }
+#endif
+
+    // ffmpeg command line arguments converted to libav settings
+    struct LibavOptions {
+        QString inputFilePath;
+        QString outputFilePath;
+        QString formatName;
+
+        // empty encoder means stream isn't mapped (video of images uses format default), "copy" remuxes
+        QString videoEncoder;
+        QString audioEncoder;
+        bool disableVideo = false;
+        bool disableAudio = false;
+
+        QString pixelFormat;
+        QString videoTag;
+        int maxVideoFrames = -1;
+        double videoQuality = -1.0;
+        double audioQuality = -1.0;
+        bool copyMetadata = false;
+
+        // options without stream specifier go to video encoder, or to audio encoder if there is no video
+        QHash<QString, QString> videoOptions;
+        QHash<QString, QString> audioOptions;
+        QHash<QString, QString> genericOptions;
+        QHash<QString, QString> muxerOptions;
+
+        QStringList ignored;
+    };
+
+    LibavOptions parseArgs(const QStringList& args)
+    {
+        static const QSet<QString> flags = {"-y", "-an", "-vn", "-sn", "-dn", "-hide_banner", "-nostats"};
+        // streams are chosen like -map 0:v:0 and 0:a:0 would, dispositions are copied. subtitles
+        // aren't converted by this engine
+        static const QSet<QString> skipped = {"loglevel", "v", "progress", "map", "map_chapters", "c:s",
+                                              "disposition:v:0"};
+
+        LibavOptions options;
+        if (args.isEmpty()) { return options; }
+
+        // output is always last argument
+        options.outputFilePath = args.last();
+
+        for (int i = 0; i < args.size() - 1; i++) {
+            const QString& arg = args.at(i);
+
+            if (flags.contains(arg)) {
+                if (arg == "-an") { options.disableAudio = true; }
+                if (arg == "-vn") { options.disableVideo = true; }
+                continue;
+            }
+            if (!arg.startsWith('-') || i + 1 >= args.size() - 1) {
+                options.ignored << arg;
+                continue;
+            }
+
+            const QString key = arg.mid(1);
+            const QString value = args.at(++i);
+
+            if (key == "i") {
+                options.inputFilePath = value;
+            } else if (skipped.contains(key)) {
+                continue;
+            } else if (key == "c:v") {
+                options.videoEncoder = value;
+            } else if (key == "c:a") {
+                options.audioEncoder = value;
+            } else if (key == "c") {
+                options.videoEncoder = value;
+                options.audioEncoder = value;
+            } else if (key == "f") {
+                options.formatName = value;
+            } else if (key == "pix_fmt") {
+                options.pixelFormat = value;
+            } else if (key == "tag:v") {
+                options.videoTag = value;
+            } else if (key == "frames:v") {
+                options.maxVideoFrames = value.toInt();
+            } else if (key == "q:v") {
+                options.videoQuality = value.toDouble();
+            } else if (key == "q:a") {
+                options.audioQuality = value.toDouble();
+            } else if (key == "map_metadata") {
+                options.copyMetadata = value != "-1";
+            } else if (key.startsWith("map_metadata:")) {
+                continue;   // stream metadata is copied together with global metadata
+            } else if (key == "update" || key == "movflags") {
+                options.muxerOptions.insert(key, value);
+            } else if (key.endsWith(":v")) {
+                options.videoOptions.insert(key.chopped(2), value);
+            } else if (key.endsWith(":a")) {
+                options.audioOptions.insert(key.chopped(2), value);
+            } else {
+                options.genericOptions.insert(key, value);
+            }
+        }
+
+        return options;
+    }
+
+    QString errorString(int errnum)
+    {
+        char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(errnum, buffer, sizeof(buffer));
+        return QString::fromUtf8(buffer);
+    }
+
+    AVDictionary* toDictionary(const QHash<QString, QString>& options)
+    {
+        AVDictionary* dictionary = nullptr;
+        for (auto it = options.cbegin(); it != options.cend(); ++it) {
+            av_dict_set(&dictionary, it.key().toUtf8().constData(), it.value().toUtf8().constData(), 0);
+        }
+        return dictionary;
+    }
+
+    struct StreamContext {
+        int inputIndex = -1;
+        AVStream* outStream = nullptr;
+        bool copy = false;
+
+        AVCodecContext* decoder = nullptr;
+        AVCodecContext* encoder = nullptr;
+        AVFilterGraph* graph = nullptr;
+        AVFilterContext* source = nullptr;
+        AVFilterContext* sink = nullptr;
+
+        int64_t framesEncoded = 0;
+        int64_t maxFrames = -1;
+        bool done = false;
+    };
+
+    // demux -> decode -> filter (pixel/sample format conversion) -> encode -> mux
+    class Transcoder {
+
+    public:
+
+        Transcoder(const LibavOptions& options,
+                   const std::atomic_bool& cancelled,
+                   std::function<void(qint64, qint64)> progress,
+                   std::function<void(const QString&)> log)
+        : options_(options), cancelled_(cancelled), progress_(std::move(progress)), log_(std::move(log)) {}
+
+        ~Transcoder()
+        {
+            for (StreamContext& stream : streams_) {
+                avfilter_graph_free(&stream.graph);
+                avcodec_free_context(&stream.decoder);
+                avcodec_free_context(&stream.encoder);
+            }
+            av_frame_free(&frame_);
+            av_frame_free(&filtered_);
+            av_packet_free(&packet_);
+            av_packet_free(&encoded_);
+
+            avformat_close_input(&input_);
+            if (output_) {
+                if (!(output_->oformat->flags & AVFMT_NOFILE)) {
+                    avio_closep(&output_->pb);
+                }
+                avformat_free_context(output_);
+            }
+        }
+
+        // returns error message, empty on success
+        QString run()
+        {
+            frame_ = av_frame_alloc();
+            filtered_ = av_frame_alloc();
+            packet_ = av_packet_alloc();
+            encoded_ = av_packet_alloc();
+            if (!frame_ || !filtered_ || !packet_ || !encoded_) { return errorString(AVERROR(ENOMEM)); }
+
+            int ret = openInput();
+            if (ret >= 0) { ret = openOutput(); }
+            if (ret >= 0) { ret = transcode(); }
+            if (ret >= 0) { ret = av_write_trailer(output_); }
+
+            if (ret < 0) {
+                return error_.isEmpty() ? errorString(ret) : error_;
+            }
+
+            reportProgress(true);
+            return {};
+        }
+
+    private:
+
+        const LibavOptions& options_;
+        const std::atomic_bool& cancelled_;
+        std::function<void(qint64, qint64)> progress_;
+        std::function<void(const QString&)> log_;
+
+        AVFormatContext* input_ = nullptr;
+        AVFormatContext* output_ = nullptr;
+        std::vector<StreamContext> streams_;
+
+        AVFrame* frame_ = nullptr;
+        AVFrame* filtered_ = nullptr;
+        AVPacket* packet_ = nullptr;
+        AVPacket* encoded_ = nullptr;
+
+        QString error_;
+        qint64 outTimeUs_ = 0;
+        std::chrono::steady_clock::time_point lastProgress_;
+
+        int fail(int ret, const QString& message)
+        {
+            error_ = message + ": " + errorString(ret);
+            return ret;
+        }
+
+        int openInput()
+        {
+            QByteArray path = options_.inputFilePath.toUtf8();
+            int ret = avformat_open_input(&input_, path.constData(), nullptr, nullptr);
+            if (ret < 0) { return fail(ret, "Couldn't open input"); }
+
+            ret = avformat_find_stream_info(input_, nullptr);
+            if (ret < 0) { return fail(ret, "Couldn't read input streams"); }
+            return 0;
+        }
+
+        int openOutput()
+        {
+            QByteArray path = options_.outputFilePath.toUtf8();
+            QByteArray formatName = options_.formatName.toUtf8();
+            int ret = avformat_alloc_output_context2(&output_, nullptr,
+                                                     formatName.isEmpty() ? nullptr : formatName.constData(),
+                                                     path.constData());
+            if (ret < 0 || !output_) { return fail(ret < 0 ? ret : AVERROR(EINVAL), "Couldn't create output"); }
+
+            // same streams as the -map arguments of the command: first video and first audio stream
+            streams_.reserve(2);
+            bool wantsVideo = !options_.disableVideo
+                              && (!options_.videoEncoder.isEmpty() || options_.maxVideoFrames > 0);
+            if (wantsVideo) {
+                int index = firstStream(AVMEDIA_TYPE_VIDEO);
+                if (index >= 0) {
+                    ret = addStream(index, options_.videoEncoder);
+                    if (ret < 0) { return ret; }
+                }
+            }
+            if (!options_.disableAudio && !options_.audioEncoder.isEmpty()) {
+                int index = firstStream(AVMEDIA_TYPE_AUDIO);
+                if (index >= 0) {
+                    ret = addStream(index, options_.audioEncoder);
+                    if (ret < 0) { return ret; }
+                }
+            }
+            if (streams_.empty()) {
+                error_ = "Input doesn't have streams to convert";
+                return AVERROR_STREAM_NOT_FOUND;
+            }
+
+            if (options_.copyMetadata) {
+                av_dict_copy(&output_->metadata, input_->metadata, 0);
+            }
+
+            if (!(output_->oformat->flags & AVFMT_NOFILE)) {
+                ret = avio_open(&output_->pb, path.constData(), AVIO_FLAG_WRITE);
+                if (ret < 0) { return fail(ret, "Couldn't open output file"); }
+            }
+
+            AVDictionary* muxerOptions = toDictionary(options_.muxerOptions);
+            ret = avformat_write_header(output_, &muxerOptions);
+            logUnused(muxerOptions, "muxer");
+            av_dict_free(&muxerOptions);
+            if (ret < 0) { return fail(ret, "Couldn't write output header"); }
+
+            lastProgress_ = std::chrono::steady_clock::now();
+            return 0;
+        }
+
+        int firstStream(AVMediaType type) const
+        {
+            for (unsigned int i = 0; i < input_->nb_streams; i++) {
+                if (input_->streams[i]->codecpar->codec_type == type) { return static_cast<int>(i); }
+            }
+            return AVERROR_STREAM_NOT_FOUND;
+        }
+
+        int addStream(int inputIndex, const QString& encoderName)
+        {
+            AVStream* inStream = input_->streams[inputIndex];
+            const AVMediaType type = inStream->codecpar->codec_type;
+
+            StreamContext stream;
+            stream.inputIndex = inputIndex;
+            stream.outStream = avformat_new_stream(output_, nullptr);
+            if (!stream.outStream) { return AVERROR(ENOMEM); }
+
+            if (options_.copyMetadata) {
+                av_dict_copy(&stream.outStream->metadata, inStream->metadata, 0);
+            }
+
+            // stream copy only moves packets to new container
+            if (encoderName == "copy") {
+                int ret = avcodec_parameters_copy(stream.outStream->codecpar, inStream->codecpar);
+                if (ret < 0) { return fail(ret, "Couldn't copy stream parameters"); }
+                stream.outStream->codecpar->codec_tag = 0;
+                stream.outStream->time_base = inStream->time_base;
+                stream.outStream->disposition = inStream->disposition;
+                stream.copy = true;
+                streams_.push_back(stream);
+                return 0;
+            }
+
+            // stream is pushed before opening codecs so destructor frees them on failure
+            streams_.push_back(stream);
+            StreamContext& added = streams_.back();
+
+            int ret = openDecoder(added, inStream);
+            if (ret < 0) { return ret; }
+
+            ret = openEncoder(added, inStream, encoderName, type);
+            if (ret < 0) { return ret; }
+
+            return initFilters(added);
+        }
+
+        int openDecoder(StreamContext& stream, AVStream* inStream)
+        {
+            const AVCodec* codec = avcodec_find_decoder(inStream->codecpar->codec_id);
+            if (!codec) {
+                error_ = "Decoder for input stream not found";
+                return AVERROR_DECODER_NOT_FOUND;
+            }
+
+            stream.decoder = avcodec_alloc_context3(codec);
+            if (!stream.decoder) { return AVERROR(ENOMEM); }
+
+            int ret = avcodec_parameters_to_context(stream.decoder, inStream->codecpar);
+            if (ret < 0) { return fail(ret, "Couldn't set decoder parameters"); }
+
+            stream.decoder->pkt_timebase = inStream->time_base;
+            if (stream.decoder->codec_type == AVMEDIA_TYPE_VIDEO) {
+                stream.decoder->framerate = av_guess_frame_rate(input_, inStream, nullptr);
+            }
+
+            ret = avcodec_open2(stream.decoder, codec, nullptr);
+            if (ret < 0) { return fail(ret, "Couldn't open decoder"); }
+            return 0;
+        }
+
+        int openEncoder(StreamContext& stream, AVStream* inStream, const QString& encoderName, AVMediaType type)
+        {
+            const AVCodec* codec = nullptr;
+            if (encoderName.isEmpty()) {
+                QByteArray path = options_.outputFilePath.toUtf8();
+                codec = avcodec_find_encoder(av_guess_codec(output_->oformat, nullptr, path.constData(),
+                                                            nullptr, type));
+            } else {
+                codec = avcodec_find_encoder_by_name(encoderName.toUtf8().constData());
+            }
+            if (!codec) {
+                error_ = "Encoder " + encoderName + " not found";
+                return AVERROR_ENCODER_NOT_FOUND;
+            }
+
+            stream.encoder = avcodec_alloc_context3(codec);
+            if (!stream.encoder) { return AVERROR(ENOMEM); }
+            AVCodecContext* decoder = stream.decoder;
+            AVCodecContext* encoder = stream.encoder;
+
+            QHash<QString, QString> codecOptions;
+            double quality;
+
+            if (type == AVMEDIA_TYPE_VIDEO) {
+                encoder->width = decoder->width;
+                encoder->height = decoder->height;
+                encoder->sample_aspect_ratio = decoder->sample_aspect_ratio;
+
+                if (!options_.pixelFormat.isEmpty()) {
+                    encoder->pix_fmt = av_get_pix_fmt(options_.pixelFormat.toUtf8().constData());
+                } else if (const AVPixelFormat* formats = supportedPixelFormats(encoder, codec)) {
+                    encoder->pix_fmt = avcodec_find_best_pix_fmt_of_list(formats, decoder->pix_fmt, 0, nullptr);
+                } else {
+                    encoder->pix_fmt = decoder->pix_fmt;
+                }
+
+                AVRational frameRate = decoder->framerate;
+                encoder->framerate = frameRate;
+                encoder->time_base = frameRate.num > 0 ? av_inv_q(frameRate) : inStream->time_base;
+
+                stream.maxFrames = options_.maxVideoFrames;
+                codecOptions = options_.genericOptions;
+                codecOptions.insert(options_.videoOptions);
+                quality = options_.videoQuality;
+            } else {
+                encoder->sample_rate = decoder->sample_rate;
+                if (const int* rates = supportedSampleRates(encoder, codec)) {
+                    bool supported = false;
+                    for (const int* rate = rates; *rate; rate++) {
+                        supported = supported || *rate == decoder->sample_rate;
+                    }
+                    if (!supported) { encoder->sample_rate = rates[0]; }
+                }
+
+                int ret = av_channel_layout_copy(&encoder->ch_layout, &decoder->ch_layout);
+                if (ret < 0) { return fail(ret, "Couldn't set channel layout"); }
+                if (const AVChannelLayout* layouts = supportedChannelLayouts(encoder, codec)) {
+                    const AVChannelLayout* chosen = nullptr;
+                    for (const AVChannelLayout* layout = layouts; layout->nb_channels; layout++) {
+                        if (!av_channel_layout_compare(layout, &decoder->ch_layout)) {
+                            chosen = layout;
+                            break;
+                        }
+                        if (!chosen && layout->nb_channels == decoder->ch_layout.nb_channels) {
+                            chosen = layout;
+                        }
+                    }
+                    av_channel_layout_uninit(&encoder->ch_layout);
+                    ret = av_channel_layout_copy(&encoder->ch_layout, chosen ? chosen : &layouts[0]);
+                    if (ret < 0) { return fail(ret, "Couldn't set channel layout"); }
+                }
+
+                encoder->sample_fmt = decoder->sample_fmt;
+                if (const AVSampleFormat* formats = supportedSampleFormats(encoder, codec)) {
+                    bool supported = false;
+                    for (const AVSampleFormat* format = formats; *format != AV_SAMPLE_FMT_NONE; format++) {
+                        supported = supported || *format == decoder->sample_fmt;
+                    }
+                    if (!supported) { encoder->sample_fmt = formats[0]; }
+                }
+
+                encoder->time_base = AVRational{1, encoder->sample_rate};
+
+                // options without stream specifier belong to audio only if video isn't encoded
+                bool videoEncoded = false;
+                for (const StreamContext& it : streams_) {
+                    videoEncoded = videoEncoded || (it.encoder && it.encoder->codec_type == AVMEDIA_TYPE_VIDEO);
+                }
+                if (!videoEncoded) { codecOptions = options_.genericOptions; }
+                codecOptions.insert(options_.audioOptions);
+                quality = options_.audioQuality;
+            }
+
+            if (quality >= 0) {
+                encoder->flags |= AV_CODEC_FLAG_QSCALE;
+                encoder->global_quality = static_cast<int>(FF_QP2LAMBDA * quality);
+            }
+            if (output_->oformat->flags & AVFMT_GLOBALHEADER) {
+                encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+            }
+
+            AVDictionary* dictionary = toDictionary(codecOptions);
+            int ret = avcodec_open2(encoder, codec, &dictionary);
+            logUnused(dictionary, codec->name);
+            av_dict_free(&dictionary);
+            if (ret < 0) { return fail(ret, QString("Couldn't open encoder ") + codec->name); }
+
+            ret = avcodec_parameters_from_context(stream.outStream->codecpar, encoder);
+            if (ret < 0) { return fail(ret, "Couldn't set stream parameters"); }
+            stream.outStream->time_base = encoder->time_base;
+
+            if (type == AVMEDIA_TYPE_VIDEO && options_.videoTag.size() == 4) {
+                QByteArray tag = options_.videoTag.toLatin1();
+                stream.outStream->codecpar->codec_tag = MKTAG(tag[0], tag[1], tag[2], tag[3]);
+            }
+            return 0;
+        }
+
+        // filter graph converts decoded frames to format, rate and frame size encoder accepts
+        int initFilters(StreamContext& stream)
+        {
+            AVCodecContext* decoder = stream.decoder;
+            AVCodecContext* encoder = stream.encoder;
+            const bool video = decoder->codec_type == AVMEDIA_TYPE_VIDEO;
+            const AVRational timeBase = decoder->pkt_timebase;
+
+            QString sourceArgs;
+            QString filterSpec;
+            if (video) {
+                AVRational aspect = decoder->sample_aspect_ratio.den ? decoder->sample_aspect_ratio : AVRational{0, 1};
+                sourceArgs = QString("video_size=%1x%2:pix_fmt=%3:time_base=%4/%5:pixel_aspect=%6/%7")
+                             .arg(decoder->width).arg(decoder->height).arg(decoder->pix_fmt)
+                             .arg(timeBase.num).arg(timeBase.den)
+                             .arg(aspect.num).arg(aspect.den);
+                filterSpec = QString("format=pix_fmts=%1").arg(av_get_pix_fmt_name(encoder->pix_fmt));
+            } else {
+                char decoderLayout[128] = {0};
+                char encoderLayout[128] = {0};
+                av_channel_layout_describe(&decoder->ch_layout, decoderLayout, sizeof(decoderLayout));
+                av_channel_layout_describe(&encoder->ch_layout, encoderLayout, sizeof(encoderLayout));
+
+                sourceArgs = QString("time_base=%1/%2:sample_rate=%3:sample_fmt=%4:channel_layout=%5")
+                             .arg(timeBase.num).arg(timeBase.den).arg(decoder->sample_rate)
+                             .arg(av_get_sample_fmt_name(decoder->sample_fmt)).arg(decoderLayout);
+                filterSpec = QString("aformat=sample_fmts=%1:sample_rates=%2:channel_layouts=%3")
+                             .arg(av_get_sample_fmt_name(encoder->sample_fmt)).arg(encoder->sample_rate)
+                             .arg(encoderLayout);
+            }
+
+            stream.graph = avfilter_graph_alloc();
+            if (!stream.graph) { return AVERROR(ENOMEM); }
+
+            int ret = avfilter_graph_create_filter(&stream.source, avfilter_get_by_name(video ? "buffer" : "abuffer"),
+                                                   "in", sourceArgs.toUtf8().constData(), nullptr, stream.graph);
+            if (ret < 0) { return fail(ret, "Couldn't create filter source"); }
+
+            ret = avfilter_graph_create_filter(&stream.sink, avfilter_get_by_name(video ? "buffersink" : "abuffersink"),
+                                               "out", nullptr, nullptr, stream.graph);
+            if (ret < 0) { return fail(ret, "Couldn't create filter sink"); }
+
+            AVFilterInOut* outputs = avfilter_inout_alloc();
+            AVFilterInOut* inputs = avfilter_inout_alloc();
+            if (!outputs || !inputs) {
+                avfilter_inout_free(&outputs);
+                avfilter_inout_free(&inputs);
+                return AVERROR(ENOMEM);
+            }
+
+            outputs->name = av_strdup("in");
+            outputs->filter_ctx = stream.source;
+            outputs->pad_idx = 0;
+            outputs->next = nullptr;
+
+            inputs->name = av_strdup("out");
+            inputs->filter_ctx = stream.sink;
+            inputs->pad_idx = 0;
+            inputs->next = nullptr;
+
+            ret = avfilter_graph_parse_ptr(stream.graph, filterSpec.toUtf8().constData(), &inputs, &outputs, nullptr);
+            avfilter_inout_free(&inputs);
+            avfilter_inout_free(&outputs);
+            if (ret < 0) { return fail(ret, "Couldn't parse filters"); }
+
+            ret = avfilter_graph_config(stream.graph, nullptr);
+            if (ret < 0) { return fail(ret, "Couldn't configure filters"); }
+
+            // most audio encoders want fixed amount of samples per frame
+            if (!video && encoder->frame_size > 0
+                && !(encoder->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+                av_buffersink_set_frame_size(stream.sink, encoder->frame_size);
+            }
+            return 0;
+        }
+
+        int transcode()
+        {
+            while (true) {
+                if (cancelled_) {
+                    error_ = "Conversion cancelled";
+                    return AVERROR_EXIT;
+                }
+
+                bool allDone = true;
+                for (const StreamContext& stream : streams_) {
+                    allDone = allDone && stream.done;
+                }
+                if (allDone) { return 0; }
+
+                int ret = av_read_frame(input_, packet_);
+                if (ret == AVERROR_EOF) { break; }
+                if (ret < 0) { return fail(ret, "Couldn't read input"); }
+
+                StreamContext* stream = streamForInput(packet_->stream_index);
+                if (stream && !stream->done) {
+                    ret = stream->copy ? copyPacket(*stream, packet_) : decodePacket(*stream, packet_);
+                }
+                av_packet_unref(packet_);
+                if (ret < 0) { return ret; }
+            }
+
+            // draining decoders, filters and encoders
+            for (StreamContext& stream : streams_) {
+                if (stream.copy || stream.done) { continue; }
+                int ret = decodePacket(stream, nullptr);
+                if (ret < 0) { return ret; }
+            }
+            return 0;
+        }
+
+        StreamContext* streamForInput(int inputIndex)
+        {
+            for (StreamContext& stream : streams_) {
+                if (stream.inputIndex == inputIndex) {
+                    return &stream;
+                }
+            }
+            return nullptr;
+        }
+
+        int copyPacket(StreamContext& stream, AVPacket* packet)
+        {
+            av_packet_rescale_ts(packet, input_->streams[stream.inputIndex]->time_base, stream.outStream->time_base);
+            packet->pos = -1;
+            return writePacket(stream, packet);
+        }
+
+        // null packet flushes decoder and everything after it
+        int decodePacket(StreamContext& stream, AVPacket* packet)
+        {
+            int ret = avcodec_send_packet(stream.decoder, packet);
+            if (ret < 0 && ret != AVERROR_EOF) { return fail(ret, "Couldn't decode input"); }
+
+            while (!stream.done) {
+                ret = avcodec_receive_frame(stream.decoder, frame_);
+                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) { break; }
+                if (ret < 0) { return fail(ret, "Couldn't decode input"); }
+
+                frame_->pts = frame_->best_effort_timestamp;
+                ret = filterFrame(stream, frame_);
+                av_frame_unref(frame_);
+                if (ret < 0) { return ret; }
+            }
+
+            return packet ? 0 : filterFrame(stream, nullptr);
+        }
+
+        int filterFrame(StreamContext& stream, AVFrame* frame)
+        {
+            if (stream.done) { return 0; }
+
+            int ret = av_buffersrc_add_frame_flags(stream.source, frame, AV_BUFFERSRC_FLAG_KEEP_REF);
+            if (ret < 0) { return fail(ret, "Couldn't filter frame"); }
+
+            const AVRational sinkTimeBase = av_buffersink_get_time_base(stream.sink);
+            while (!stream.done) {
+                ret = av_buffersink_get_frame(stream.sink, filtered_);
+                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) { break; }
+                if (ret < 0) { return fail(ret, "Couldn't filter frame"); }
+
+                filtered_->pict_type = AV_PICTURE_TYPE_NONE;
+                if (filtered_->pts != AV_NOPTS_VALUE) {
+                    filtered_->pts = av_rescale_q(filtered_->pts, sinkTimeBase, stream.encoder->time_base);
+                }
+                ret = encodeFrame(stream, filtered_);
+                av_frame_unref(filtered_);
+                if (ret < 0) { return ret; }
+            }
+
+            return frame ? 0 : encodeFrame(stream, nullptr);
+        }
+
+        // null frame flushes encoder
+        int encodeFrame(StreamContext& stream, AVFrame* frame)
+        {
+            if (stream.done) { return 0; }
+
+            int ret = avcodec_send_frame(stream.encoder, frame);
+            if (ret < 0) { return fail(ret, "Couldn't encode frame"); }
+
+            ret = receivePackets(stream);
+            if (ret < 0) { return ret; }
+
+            // frame limit (images) ends stream early
+            if (frame && stream.maxFrames > 0 && ++stream.framesEncoded >= stream.maxFrames) {
+                ret = avcodec_send_frame(stream.encoder, nullptr);
+                if (ret < 0) { return fail(ret, "Couldn't encode frame"); }
+                ret = receivePackets(stream);
+                stream.done = true;
+            }
+            if (!frame) {
+                stream.done = true;
+            }
+            return ret;
+        }
+
+        int receivePackets(StreamContext& stream)
+        {
+            while (true) {
+                int ret = avcodec_receive_packet(stream.encoder, encoded_);
+                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) { return 0; }
+                if (ret < 0) { return fail(ret, "Couldn't encode frame"); }
+
+                av_packet_rescale_ts(encoded_, stream.encoder->time_base, stream.outStream->time_base);
+                ret = writePacket(stream, encoded_);
+                if (ret < 0) { return ret; }
+            }
+        }
+
+        int writePacket(StreamContext& stream, AVPacket* packet)
+        {
+            packet->stream_index = stream.outStream->index;
+
+            int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (timestamp != AV_NOPTS_VALUE) {
+                outTimeUs_ = qMax(outTimeUs_, av_rescale_q(timestamp, stream.outStream->time_base, AV_TIME_BASE_Q));
+            }
+
+            // muxer takes the packet reference
+            int ret = av_interleaved_write_frame(output_, packet);
+            if (ret < 0) { return fail(ret, "Couldn't write output"); }
+
+            reportProgress(false);
+            return 0;
+        }
+
+        void reportProgress(bool force)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (!force && now - lastProgress_ < std::chrono::milliseconds(200)) { return; }
+            lastProgress_ = now;
+
+            qint64 totalSize = output_->pb ? avio_tell(output_->pb) : 0;
+            progress_(outTimeUs_, totalSize);
+        }
+
+        void logUnused(AVDictionary* dictionary, const QString& owner)
+        {
+            const AVDictionaryEntry* entry = nullptr;
+            while ((entry = av_dict_get(dictionary, "", entry, AV_DICT_IGNORE_SUFFIX))) {
+                log_("libav: " + owner + " ignored option " + QString::fromUtf8(entry->key));
+            }
+        }
+    };
+}
+
+LibavEngine::~LibavEngine()
+{
+    for (const auto& cancelled : std::as_const(cancelFlags_)) {
+        *cancelled = true;
+    }
+    for (QThread* thread : std::as_const(threads_)) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void LibavEngine::start(int jobId, const QStringList& args)
+{
+    const LibavOptions options = parseArgs(args);
+    for (const QString& arg : options.ignored) {
+        emit logMessage(jobId, "libav: ignored argument " + arg);
+    }
+
+    auto cancelled = std::make_shared<std::atomic_bool>(false);
+    cancelFlags_.insert(jobId, cancelled);
+
+    QThread* thread = QThread::create([this, jobId, options, cancelled]() {
+        QString errorMessage;
+        {
+            Transcoder transcoder(options, *cancelled,
+                [this, jobId](qint64 outTimeUs, qint64 totalSize) {
+                    emit progress(jobId, outTimeUs, totalSize);
+                },
+                [this, jobId](const QString& message) {
+                    emit logMessage(jobId, message);
+                });
+            errorMessage = transcoder.run();
+        }
+
+        // partial output is never left behind
+        if (!errorMessage.isEmpty()) {
+            QFile::remove(options.outputFilePath);
+        }
+        emit finished(jobId, errorMessage.isEmpty(), errorMessage);
+    });
+
+    threads_.insert(jobId, thread);
+    connect(thread, &QThread::finished, this, [this, jobId, thread]() {
+        threads_.remove(jobId);
+        cancelFlags_.remove(jobId);
+        thread->deleteLater();
+    });
+    thread->start();
+}
+
+void LibavEngine::cancel(int jobId)
+{
+    if (auto cancelled = cancelFlags_.value(jobId)) {
+        *cancelled = true;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef FORMAT_CONVERTER_LIBAVENGINE_H
+#define FORMAT_CONVERTER_LIBAVENGINE_H
+
+#include <atomic>
+#include <memory>
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+
+// in-process conversion engine linking libavformat/libavcodec directly. it understands the same
+// argument lists that are given to ffmpeg process, so both engines share argument builders.
+// every conversion runs in its own worker thread and signals are emitted from that thread.
+class LibavEngine : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit LibavEngine(QObject* parent = nullptr) : QObject(parent) {}
+    ~LibavEngine() override;
+
+    void start(int jobId, const QStringList& args);
+    void cancel(int jobId);
+
+private:
+
+    QHash<int, QThread*> threads_;
+    QHash<int, std::shared_ptr<std::atomic_bool>> cancelFlags_;
+
+signals:
+    // output time is exact pts of last written packet
+    void progress(int jobId, qint64 outTimeUs, qint64 totalSize);
+    void logMessage(int jobId, const QString& message);
+    void finished(int jobId, bool success, const QString& errorMessage);
+};
+
+
+#endif //FORMAT_CONVERTER_LIBAVENGINE_H
@@ -0,0 +1,76 @@
+#include "LogModel.h"
+
+
+LogModel::LogModel(int capacity, QObject* parent)
+: QAbstractListModel(parent), lines_(qMax(1, capacity))
+{
+    // ~30 Hz
+    flushTimer_.setInterval(33);
+    flushTimer_.setSingleShot(true);
+    connect(&flushTimer_, &QTimer::timeout, this, &LogModel::flush);
+}
+
+void LogModel::append(int jobId, const QString& message)
+{
+    for (const QString& text : message.split('\n')) {
+        pending_.append({jobId, text.left(maxLineLength)});
+    }
+
+    // lines which could never be shown aren't kept while waiting
+    if (pending_.size() > lines_.size()) {
+        pending_.remove(0, pending_.size() - lines_.size());
+    }
+
+    if (!flushTimer_.isActive()) {
+        flushTimer_.start();
+    }
+}
+
+void LogModel::clear()
+{
+    beginResetModel();
+    pending_.clear();
+    first_ = 0;
+    count_ = 0;
+    lines_.fill(Line());
+    endResetModel();
+}
+
+int LogModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : count_;
+}
+
+QVariant LogModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= count_) { return {}; }
+
+    switch (role) {
+        case Qt::DisplayRole:   return line(index.row()).text;
+        case JobIdRole:         return line(index.row()).jobId;
+        default:                return {};
+    }
+}
+
+void LogModel::flush()
+{
+    if (pending_.isEmpty()) { return; }
+
+    const int capacity = lines_.size();
+    const int overflow = count_ + pending_.size() - capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        first_ = (first_ + overflow) % capacity;
+        count_ -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), count_, count_ + pending_.size() - 1);
+    for (Line& it : pending_) {
+        lines_[(first_ + count_) % capacity] = std::move(it);
+        count_++;
+    }
+    endInsertRows();
+
+    pending_.clear();
+}
\ No newline at end of file
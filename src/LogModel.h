@@ -0,0 +1,53 @@
+#ifndef FORMAT_CONVERTER_LOGMODEL_H
+#define FORMAT_CONVERTER_LOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QTimer>
+#include <QVector>
+
+// log lines of all jobs in a ring buffer of fixed size, oldest lines are dropped first.
+// appended lines are collected and inserted to the model at most 30 times per second, so
+// a view redraws once per batch instead of once per ffmpeg line
+class LogModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+
+    enum Roles {
+        JobIdRole = Qt::UserRole + 1
+    };
+
+    explicit LogModel(int capacity = 10000, QObject* parent = nullptr);
+    ~LogModel() override = default;
+
+    // multi line messages are split to lines, jobId 0 is for lines outside jobs
+    void append(int jobId, const QString& message);
+    void clear();
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    // longer lines are cut so memory stays bounded by capacity
+    static constexpr int maxLineLength = 1000;
+
+private:
+
+    struct Line {
+        int jobId = 0;
+        QString text;
+    };
+
+    // lines_ is used as circular buffer starting from first_
+    QVector<Line> lines_;
+    int first_ = 0;
+    int count_ = 0;
+
+    QVector<Line> pending_;
+    QTimer flushTimer_;
+
+    void flush();
+    const Line& line(int row) const { return lines_[(first_ + row) % lines_.size()]; }
+};
+
+
+#endif //FORMAT_CONVERTER_LOGMODEL_H
\ No newline at end of file
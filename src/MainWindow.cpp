@@ -1,6 +1,9 @@
 #include "MainWindow.h"
 #include "utils/CommonEnums.h"
 #include "Converter.h"
+#include "FormatRegistry.h"
+#include "LogModel.h"
+#include "MetadataStripper.h"
 #include "utils/DependencyChecker.h"
 
 #include <iostream>
@@ -11,8 +14,11 @@
 #include <QLabel>
 #include <QMessageBox>
 #include <QProgressBar>
-#include <QTextEdit>
+#include <QListView>
+#include <QScrollBar>
+#include <QSortFilterProxyModel>
 #include <QCheckBox>
+#include <QThread>
 
 
 MainWindow::MainWindow(Converter* converter, QWidget *parent)
@@ -130,17 +136,33 @@ void MainWindow::initConvertSettings(QHBoxLayout& layout)
     row++;
 
     metadataCheckBox_ = new QCheckBox("Preserve metadata");
+    metadataCheckBox_->setChecked(true);
 
-    // if exiftool isn't installed metadata preservation isn't in use
+    // audio and video metadata is moved by ffmpeg, only images need exiftool
     if (!DependencyChecker::isExifToolAvailable()){
-        metadataCheckBox_->setToolTip("Install ExifTool to be able to preserve metadata");
-        widgetNotInUse_.insert(metadataCheckBox_);
-    } else {
-        metadataCheckBox_->setChecked(true);
+        metadataCheckBox_->setToolTip("Install ExifTool to be able to preserve image metadata");
     }
 
     convertLayout->addWidget(metadataCheckBox_, row, 0, 1, 2);
 
+    row++;
+
+    // profiles trade quality for conversion speed
+    QLabel* profileLabel = new QLabel("Encoder profile: ");
+    profileCB_ = new QComboBox();
+    profileCB_->addItems(converter_->encoderProfiles().names());
+    profileCB_->setCurrentText(converter_->profile());
+    profileCB_->setToolTip("archive keeps the best quality, realtime is the fastest");
+
+    convertLayout->addWidget(profileLabel, row, 0);
+    convertLayout->addWidget(profileCB_, row, 1);
+
+    row++;
+
+    segmentsCheckBox_ = new QCheckBox("Encode long videos in parallel segments");
+    segmentsCheckBox_->setToolTip("Videos longer than five minutes are split and encoded with all cores");
+    convertLayout->addWidget(segmentsCheckBox_, row, 0, 1, 2);
+
     layout.addLayout(convertLayout);
 }
 
@@ -162,10 +184,10 @@ void MainWindow::initMetaDataRemoverSettings(QHBoxLayout& layout)
     metaDataLayout->addWidget(removeButton, row, 0, 1, 2);
     connect(removeButton, &QPushButton::clicked, this, &MainWindow::removeButtonClicked);
 
-    // if exiftool isn't installed metadata removal isn't in use
+    // native stripper handles common formats, only others need exiftool
     if (!DependencyChecker::isExifToolAvailable()) {
-        removeButton->setToolTip("Install ExifTool to be able to remove metadata");
-        widgetNotInUse_.insert(removeButton);
+        removeButton->setToolTip("Install ExifTool to be able to remove metadata of other formats than "
+                                 "JPEG, PNG, WebP, MP3, MP4, MOV and M4A");
     }
 
     layout.addLayout(metaDataLayout);
@@ -176,25 +198,64 @@ void MainWindow::initProgressIndicator()
     QProgressBar* progressBar = new QProgressBar();
     progressBar->setRange(0, 100);
 
-    QTextEdit* logBox = new QTextEdit("Start your process...\n");
-    logBox->setReadOnly(true);
+    // log lines are kept in bounded model and only visible rows are drawn
+    LogModel* logModel = new LogModel(10000, this);
+    logModel->append(0, "Start your process...");
+
+    QSortFilterProxyModel* logFilter = new QSortFilterProxyModel(this);
+    logFilter->setSourceModel(logModel);
+    logFilter->setFilterRole(LogModel::JobIdRole);
+
+    QListView* logView = new QListView();
+    logView->setModel(logFilter);
+    logView->setUniformItemSizes(true);
+    logView->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
-    mainLayout_->addWidget(logBox);
+    QComboBox* logJobCB = new QComboBox();
+    logJobCB->addItem("All jobs", 0);
+
+    QLabel* statsLabel = new QLabel();
+
+    mainLayout_->addWidget(logJobCB);
+    mainLayout_->addWidget(logView);
     mainLayout_->addWidget(progressBar);
+    mainLayout_->addWidget(statsLabel);
+
+    connect(converter_, &Converter::jobLogMessage, logModel, &LogModel::append);
+    connect(converter_, &Converter::jobStarted, this, [logJobCB](int jobId) {
+        logJobCB->addItem("Job " + QString::number(jobId), jobId);
+    });
+    connect(logJobCB, &QComboBox::currentIndexChanged, this, [logJobCB, logFilter]() {
+        int jobId = logJobCB->currentData().toInt();
+        logFilter->setFilterRegularExpression(jobId == 0 ? QString() : "^" + QString::number(jobId) + "$");
+    });
 
-    connect(converter_, &Converter::onLogMessage, this, [logBox](const QString& message) {
-        logBox->append(message);
-        logBox->moveCursor(QTextCursor::End);
+    // view follows new lines only when it is already at the bottom
+    connect(logFilter, &QAbstractItemModel::rowsAboutToBeInserted, this, [this, logView]() {
+        QScrollBar* scrollBar = logView->verticalScrollBar();
+        followLog_ = scrollBar->value() == scrollBar->maximum();
+    });
+    connect(logFilter, &QAbstractItemModel::rowsInserted, this, [this, logView]() {
+        if (followLog_) { logView->scrollToBottom(); }
     });
 
     // updating progressbar and label
-    connect(converter_, &Converter::onUpdateProgress, this, [progressBar, logBox] (int progress) {
+    connect(converter_, &Converter::onUpdateProgress, this, [progressBar] (int progress) {
         progressBar->setValue(progress);
     });
 
+    // showing throughput of running ffmpeg
+    connect(converter_, &Converter::jobStats, this, [statsLabel] (int jobId, const FfmpegStats& stats) {
+        statsLabel->setText(QString("Speed: %1x   FPS: %2   Written: %3 MB")
+                            .arg(stats.speed, 0, 'f', 2)
+                            .arg(stats.fps, 0, 'f', 1)
+                            .arg(stats.totalSize / (1024.0 * 1024.0), 0, 'f', 1));
+    });
+
     // resetting progress
-    connect(this, &MainWindow::resetProgress, this, [progressBar]() {
+    connect(this, &MainWindow::resetProgress, this, [progressBar, statsLabel]() {
         progressBar->setValue(0);
+        statsLabel->clear();
     });
 
     // setting starting values
@@ -255,16 +316,7 @@ void MainWindow::inputFilePathEditingFinished()
     oFolderPathLE_->setText(QFileInfo(filePath).path());
     oFileNameLE_->setText(QFileInfo(filePath).completeBaseName());
 
-    QString suffix = QFileInfo(filePath).suffix();
-
-    FormatInfo fileFormatInfo = {FileType::UNKNOWN};
-    for (const auto& it : fileFormats) {
-        if (it.label == suffix) {
-            fileFormatInfo = it;
-            break;
-        }
-    }
-    updateFileTypeBox(fileFormatInfo);
+    updateFileTypeBox(FormatRegistry::detect(filePath));
     emit resetProgress();
 }
 
@@ -306,6 +358,9 @@ void MainWindow::convertButtonClicked()
             return;
         }
     }
+    converter_->setProfile(profileCB_->currentText());
+    converter_->setPriority(JobPriority::INTERACTIVE);
+    converter_->setSegmentedEncoding(segmentsCheckBox_->isChecked() ? QThread::idealThreadCount() : 0);
     converter_->runConverter(iFilePathLE_->text(), outputFilePath, metadataCheckBox_->isChecked());
 }
 
@@ -316,6 +371,13 @@ void MainWindow::removeButtonClicked()
     QString oSuffix = QFileInfo(iFilePathLE_->text()).suffix();
     QString outputFilePath = QDir(oPath).filePath(oName + "." + oSuffix);
 
+    if (!MetadataStripper::canStrip(FormatRegistry::detect(iFilePathLE_->text()))
+        && !DependencyChecker::isExifToolAvailable()) {
+        QMessageBox::warning(this, "ExifTool Not Found",
+            "Metadata of '." + oSuffix + "' files can't be removed without ExifTool.");
+        return;
+    }
+
     if (QFileInfo::exists(outputFilePath)) {
         QMessageBox::StandardButton overwrite = QMessageBox::question(nullptr, "File Exists",
             "The file already exists. Overwrite?", QMessageBox::Yes | QMessageBox::No);
@@ -324,6 +386,7 @@ void MainWindow::removeButtonClicked()
         }
     }
 
+    converter_->setPriority(JobPriority::INTERACTIVE);
     converter_->runMetadataRemover(iFilePathLE_->text(), outputFilePath);
 }
 
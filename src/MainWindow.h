@@ -30,6 +30,11 @@ private:
     QLineEdit* oFileNameLE_ = nullptr;
     QComboBox* oFileTypeCB_ = nullptr;
     QCheckBox* metadataCheckBox_ = nullptr;
+    QComboBox* profileCB_ = nullptr;
+    QCheckBox* segmentsCheckBox_ = nullptr;
+
+    // log view scrolls with new lines until user scrolls up
+    bool followLog_ = true;
 
     // all widgets which cannot be enabled due restrictions
     // for example exiftool isn't installed
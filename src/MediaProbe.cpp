@@ -0,0 +1,288 @@
+#include "MediaProbe.h"
+#include "utils/ConverterArguments.h"
+
+#include <algorithm>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSaveFile>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+    // entries of files that have changed or gone are never hit again, so file is capped
+    constexpr qsizetype maxCacheEntries = 20000;
+}
+
+
+MediaProbe::MediaProbe(QObject* parent)
+: QObject(parent), maxProcesses_(QThread::idealThreadCount())
+{
+    // results of a batch are written together instead of after every probe
+    saveTimer_.setSingleShot(true);
+    saveTimer_.setInterval(2000);
+    connect(&saveTimer_, &QTimer::timeout, this, &MediaProbe::saveCache);
+}
+
+MediaProbe::~MediaProbe()
+{
+    if (saveTimer_.isActive()) {
+        saveCache();
+    }
+}
+
+void MediaProbe::probe(int requestId, const QString& filePath)
+{
+    QString key = cacheKey(filePath);
+
+    // signal is always queued so caller sees the same order as with a running ffprobe
+    auto cached = cache_.constFind(key);
+    if (cached != cache_.constEnd()) {
+        MediaInfo info = *cached;
+        markUsed(key);
+        QMetaObject::invokeMethod(this, [this, requestId, info]() {
+            emit probed(requestId, info);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // files that can't be identified are probed every time
+    bool cacheable = !key.isEmpty();
+    if (!cacheable) {
+        key = "path:" + filePath;
+    }
+
+    auto it = pending_.find(key);
+    if (it != pending_.end()) {
+        it->requestIds.append(requestId);
+        // prefetch which hasn't started yet is moved ahead
+        if (prefetchQueue_.removeOne(key)) {
+            probeQueue_.enqueue(key);
+            startNextProbes();
+        }
+        return;
+    }
+
+    pending_.insert(key, {filePath, {requestId}, cacheable});
+    probeQueue_.enqueue(key);
+    startNextProbes();
+}
+
+void MediaProbe::prefetch(const QString& filePath)
+{
+    QString key = cacheKey(filePath);
+    if (key.isEmpty() || pending_.contains(key)) { return; }
+    if (cache_.contains(key)) {
+        markUsed(key);
+        return;
+    }
+
+    pending_.insert(key, {filePath, {}, true});
+    prefetchQueue_.enqueue(key);
+    startNextProbes();
+}
+
+bool MediaProbe::setCacheFile(const QString& filePath, QString* errorMessage)
+{
+    cacheFilePath_ = filePath;
+    if (filePath.isEmpty()) { return true; }
+
+    QFile file(filePath);
+    if (!file.exists()) { return true; }
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage) { *errorMessage = "Probe cache " + filePath + " can't be read: " + file.errorString(); }
+        return false;
+    }
+
+    // broken cache is only a reason to probe again
+    const QJsonObject entries = QJsonDocument::fromJson(file.readAll()).object().value("entries").toObject();
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        const QJsonObject entry = it.value().toObject();
+        MediaInfo info = parse(entry);
+        if (info.valid) {
+            cache_.insert(it.key(), info);
+            lastUsed_.insert(it.key(), entry.value("used").toInteger());
+        }
+    }
+    return true;
+}
+
+void MediaProbe::startNextProbes()
+{
+    while (runningProcesses_ < maxProcesses_ && (!probeQueue_.isEmpty() || !prefetchQueue_.isEmpty())) {
+        startProbe(!probeQueue_.isEmpty() ? probeQueue_.dequeue() : prefetchQueue_.dequeue());
+    }
+}
+
+void MediaProbe::startProbe(const QString& key)
+{
+    QProcess* process = new QProcess(this);
+    ProcessPriorities::apply(process, processPriority_);
+    runningProcesses_++;
+
+    connect(process, &QProcess::errorOccurred, this, [this, process, key](QProcess::ProcessError processError) {
+        if (processError == QProcess::FailedToStart) {
+            process->deleteLater();
+            probeFinished(key, MediaInfo());
+        }
+    });
+
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+        [this, process, key](int exitCode, QProcess::ExitStatus exitStatus) {
+        process->deleteLater();
+        if (exitStatus != QProcess::NormalExit || exitCode != 0) {
+            probeFinished(key, MediaInfo());
+            return;
+        }
+        probeFinished(key, parse(process->readAllStandardOutput()));
+    });
+
+    process->start("ffprobe", FFprobe::streamArgs(pending_.value(key).filePath));
+}
+
+void MediaProbe::probeFinished(const QString& key, const MediaInfo& info)
+{
+    runningProcesses_--;
+    const Pending pending = pending_.take(key);
+
+    // failed probes aren't cached, file may be still copied
+    if (info.valid && pending.cacheable) {
+        cache_.insert(key, info);
+        markUsed(key);
+    }
+
+    for (int requestId : pending.requestIds) {
+        emit probed(requestId, info);
+    }
+    startNextProbes();
+}
+
+void MediaProbe::saveCache()
+{
+    saveTimer_.stop();
+    if (cacheFilePath_.isEmpty()) { return; }
+
+    if (cache_.size() > maxCacheEntries) {
+        QList<QString> keys = cache_.keys();
+        std::sort(keys.begin(), keys.end(), [this](const QString& a, const QString& b) {
+            return lastUsed_.value(a) > lastUsed_.value(b);
+        });
+        for (qsizetype i = maxCacheEntries; i < keys.size(); ++i) {
+            cache_.remove(keys[i]);
+            lastUsed_.remove(keys[i]);
+        }
+    }
+
+    QJsonObject entries;
+    for (auto it = cache_.constBegin(); it != cache_.constEnd(); ++it) {
+        QJsonObject entry = toJson(it.value());
+        entry.insert("used", lastUsed_.value(it.key()));
+        entries.insert(it.key(), entry);
+    }
+
+    QDir().mkpath(QFileInfo(cacheFilePath_).absolutePath());
+    QSaveFile file(cacheFilePath_);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(QJsonObject{{"version", 1}, {"entries", entries}}).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
+
+void MediaProbe::markUsed(const QString& key)
+{
+    lastUsed_.insert(key, QDateTime::currentMSecsSinceEpoch());
+    if (!cacheFilePath_.isEmpty()) {
+        saveTimer_.start();
+    }
+}
+
+QString MediaProbe::cacheKey(const QString& filePath)
+{
+    QFileInfo info(filePath);
+    if (!info.isFile()) { return {}; }
+
+    // device and inode stay when file is renamed, other platforms use the path
+#ifdef Q_OS_UNIX
+    struct stat status;
+    if (::stat(QFile::encodeName(filePath).constData(), &status) != 0) { return {}; }
+    QString identity = QString("%1:%2").arg(status.st_dev).arg(status.st_ino);
+#else
+    QString identity = info.absoluteFilePath();
+#endif
+    return QString("%1:%2:%3").arg(identity).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+MediaInfo MediaProbe::parse(const QByteArray& json)
+{
+    return parse(QJsonDocument::fromJson(json).object());
+}
+
+MediaInfo MediaProbe::parse(const QJsonObject& root)
+{
+    MediaInfo info;
+
+    // ffprobe prints numbers of format and most stream fields as strings
+    QJsonObject format = root.value("format").toObject();
+    info.formatName = format.value("format_name").toString();
+    info.duration = format.value("duration").toString().toDouble();
+    info.bitRate = format.value("bit_rate").toString().toLongLong();
+
+    const QJsonArray streams = root.value("streams").toArray();
+    for (const QJsonValue& value : streams) {
+        QJsonObject stream = value.toObject();
+
+        StreamInfo streamInfo;
+        streamInfo.index = stream.value("index").toInt();
+        streamInfo.codecType = stream.value("codec_type").toString();
+        streamInfo.codecName = stream.value("codec_name").toString();
+        streamInfo.bitRate = stream.value("bit_rate").toString().toLongLong();
+        streamInfo.width = stream.value("width").toInt();
+        streamInfo.height = stream.value("height").toInt();
+        streamInfo.pixelFormat = stream.value("pix_fmt").toString();
+        streamInfo.sampleRate = stream.value("sample_rate").toString().toInt();
+        streamInfo.channels = stream.value("channels").toInt();
+        info.streams.append(streamInfo);
+    }
+
+    info.valid = !info.streams.isEmpty();
+    return info;
+}
+
+QJsonObject MediaProbe::toJson(const MediaInfo& info)
+{
+    QJsonArray streams;
+    for (const StreamInfo& stream : info.streams) {
+        QJsonObject object {
+            {"index", stream.index},
+            {"codec_type", stream.codecType},
+            {"codec_name", stream.codecName},
+            {"bit_rate", QString::number(stream.bitRate)}
+        };
+        if (stream.codecType == "video") {
+            object["width"] = stream.width;
+            object["height"] = stream.height;
+            object["pix_fmt"] = stream.pixelFormat;
+        } else if (stream.codecType == "audio") {
+            object["sample_rate"] = QString::number(stream.sampleRate);
+            object["channels"] = stream.channels;
+        }
+        streams.append(object);
+    }
+
+    QJsonObject format {
+        {"format_name", info.formatName},
+        {"duration", QString::number(info.duration, 'g', 17)},
+        {"bit_rate", QString::number(info.bitRate)}
+    };
+    return {{"format", format}, {"streams", streams}};
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef FORMAT_CONVERTER_MEDIAPROBE_H
+#define FORMAT_CONVERTER_MEDIAPROBE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+#include <QTimer>
+
+#include "utils/MediaInfo.h"
+#include "utils/ProcessPriority.h"
+
+// runs ffprobe for input files. failed probes give invalid MediaInfo. results are cached by
+// device, inode, size and modification time, so same file is probed once even when it is
+// moved, and with cache file also across runs. cache file keeps the most recently used
+// entries only. at most one ffprobe per core runs at a time, probes of starting jobs go before
+// prefetches
+class MediaProbe : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit MediaProbe(QObject* parent = nullptr);
+    ~MediaProbe() override;
+
+    // result is given in probed signal with same request id
+    void probe(int requestId, const QString& filePath);
+
+    // probes queued file while workers are busy so its job doesn't have to wait for ffprobe
+    void prefetch(const QString& filePath);
+
+    // loads earlier results and saves new ones there, empty path keeps cache only in memory
+    bool setCacheFile(const QString& filePath, QString* errorMessage = nullptr);
+
+    // given to ffprobe processes started after this call
+    void setProcessPriority(const ProcessPriority& priority) { processPriority_ = priority; }
+
+    static MediaInfo parse(const QByteArray& json);
+    static MediaInfo parse(const QJsonObject& root);
+    // same layout as ffprobe output, only parsed fields are kept
+    static QJsonObject toJson(const MediaInfo& info);
+
+private:
+
+    // requests waiting for the same file, prefetch has no request ids
+    struct Pending {
+        QString filePath;
+        QList<int> requestIds;
+        bool cacheable = true;
+    };
+
+    int maxProcesses_;
+    int runningProcesses_ = 0;
+    QHash<QString, Pending> pending_;
+    QQueue<QString> probeQueue_;
+    QQueue<QString> prefetchQueue_;
+    ProcessPriority processPriority_;
+
+    QHash<QString, MediaInfo> cache_;
+    // msecs since epoch when entry was last probed or served, oldest are dropped when saving
+    QHash<QString, qint64> lastUsed_;
+    QString cacheFilePath_;
+    QTimer saveTimer_;
+
+    void startNextProbes();
+    void startProbe(const QString& key);
+    void probeFinished(const QString& key, const MediaInfo& info);
+    void saveCache();
+    void markUsed(const QString& key);
+
+    static QString cacheKey(const QString& filePath);
+
+signals:
+    void probed(int requestId, const MediaInfo& info);
+};
+
+
+#endif //FORMAT_CONVERTER_MEDIAPROBE_H
\ No newline at end of file
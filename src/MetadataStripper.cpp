@@ -0,0 +1,760 @@
+#include "MetadataStripper.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <QFile>
+#include <QThread>
+#include <QtEndian>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/FileUtils.h"
+
+namespace {
+
+    // other names of the same inode (backups, hardlinked copies) would see an in place change
+    bool hasOtherLinks(const QFile& file)
+    {
+#ifdef Q_OS_UNIX
+        struct stat status;
+        return ::fstat(file.handle(), &status) != 0 || status.st_nlink > 1;
+#else
+        Q_UNUSED(file);
+        return false;
+#endif
+    }
+
+    bool isJpegMetadata(uchar marker, const uchar* payload, qint64 length)
+    {
+        if (marker == 0xFE) { return true; }
+        if (marker == 0xE0) {
+            return length < 5 || std::memcmp(payload, "JFIF\0", 5) != 0;
+        }
+        if (marker == 0xEE) {
+            return length < 5 || std::memcmp(payload, "Adobe", 5) != 0;
+        }
+        return marker > 0xE0 && marker <= 0xEF;
+    }
+
+    bool isPngMetadata(QByteArrayView type)
+    {
+        static const QList<QByteArrayView> metadataChunks = {
+            "tEXt", "zTXt", "iTXt", "eXIf", "tIME", "iCCP"
+        };
+        return metadataChunks.contains(type);
+    }
+
+    // ID3v2 sizes have 7 bits per byte so they never look like frame sync
+    qint64 syncsafe(const uchar* bytes)
+    {
+        if ((bytes[0] | bytes[1] | bytes[2] | bytes[3]) & 0x80) { return -1; }
+        return (bytes[0] << 21) | (bytes[1] << 14) | (bytes[2] << 7) | bytes[3];
+    }
+
+    // header or footer of ID3v2 tag, size of whole tag or -1
+    qint64 id3v2Size(const uchar* data, qint64 size, const char* id)
+    {
+        if (size < 10 || std::memcmp(data, id, 3) != 0 || data[3] == 0xFF || data[4] == 0xFF) { return -1; }
+        qint64 tagSize = syncsafe(data + 6);
+        if (tagSize < 0) { return -1; }
+        return 10 + tagSize + ((data[5] & 0x10) ? 10 : 0);
+    }
+
+    struct Box {
+        qint64 offset = 0;
+        qint64 headerSize = 0;      // size, type, 64-bit size and uuid
+        qint64 size = 0;
+        bool largeSize = false;
+        QByteArrayView type;
+    };
+
+    // box starting at pos which has to end before end. size 0 means rest of the file
+    bool readBox(const uchar* data, qint64 pos, qint64 end, Box& box)
+    {
+        if (end - pos < 8) { return false; }
+        box.offset = pos;
+        box.size = qFromBigEndian<quint32>(data + pos);
+        box.headerSize = 8;
+        box.largeSize = box.size == 1;
+        box.type = QByteArrayView(data + pos + 4, 4);
+
+        if (box.largeSize) {
+            if (end - pos < 16) { return false; }
+            box.size = qFromBigEndian<quint64>(data + pos + 8);
+            box.headerSize = 16;
+        } else if (box.size == 0) {
+            box.size = end - pos;
+        }
+        if (box.type == "uuid") { box.headerSize += 16; }
+        return box.size >= box.headerSize && box.size <= end - pos;
+    }
+
+    bool isMetadataBox(const uchar* data, const Box& box)
+    {
+        static const uchar xmpUuid[16] = {
+            0xBE, 0x7A, 0xCF, 0xCB, 0x97, 0xA9, 0x42, 0xE8, 0x9C, 0x71, 0x99, 0x94, 0x91, 0xE3, 0xAF, 0xAC
+        };
+        if (box.type == "uuid") {
+            return std::memcmp(data + box.offset + box.headerSize - 16, xmpUuid, 16) == 0;
+        }
+        return box.type == "udta" || box.type == "meta";
+    }
+
+    // boxes inside moov which can hold metadata boxes
+    bool isMoovContainer(QByteArrayView type)
+    {
+        static const QList<QByteArrayView> containers = {
+            "moov", "trak", "mdia", "minf", "stbl", "edts", "dinf", "mvex"
+        };
+        return containers.contains(type);
+    }
+
+    // appends box without metadata children. positions of chunk offset tables in output are
+    // collected, they are patched when the final layout is known
+    bool rebuildBox(const uchar* data, const Box& box, QByteArray& output, QList<qint64>& offsetTables)
+    {
+        if (!isMoovContainer(box.type)) {
+            if (box.type == "stco" || box.type == "co64") { offsetTables.append(output.size()); }
+            output.append(reinterpret_cast<const char*>(data + box.offset), box.size);
+            return true;
+        }
+
+        const qint64 start = output.size();
+        output.append(reinterpret_cast<const char*>(data + box.offset), box.headerSize);
+        for (qint64 pos = box.offset + box.headerSize; pos < box.offset + box.size;) {
+            Box child;
+            if (!readBox(data, pos, box.offset + box.size, child)) { return false; }
+            pos += child.size;
+            if (isMetadataBox(data, child)) { continue; }
+            if (!rebuildBox(data, child, output, offsetTables)) { return false; }
+        }
+
+        // box only gets smaller so its size still fits the original field
+        uchar* header = reinterpret_cast<uchar*>(output.data() + start);
+        if (box.largeSize) {
+            qToBigEndian<quint64>(output.size() - start, header + 8);
+        } else {
+            qToBigEndian<quint32>(static_cast<quint32>(output.size() - start), header);
+        }
+        return true;
+    }
+
+    // where kept top level boxes of input are in output
+    class OffsetMap {
+    public:
+        void add(qint64 offset, qint64 size, qint64 newOffset) { boxes_.append({offset, offset + size, newOffset}); }
+
+        bool move(qint64 offset, qint64& moved) const
+        {
+            auto it = std::upper_bound(boxes_.cbegin(), boxes_.cend(), offset,
+                                       [](qint64 value, const Placement& box) { return value < box.end; });
+            if (it == boxes_.cend() || offset < it->start) { return false; }
+            moved = offset - it->start + it->newStart;
+            return true;
+        }
+
+    private:
+        struct Placement {
+            qint64 start;
+            qint64 end;
+            qint64 newStart;
+        };
+        QList<Placement> boxes_;
+    };
+
+    // stco has 32-bit and co64 64-bit offsets of chunks in mdat
+    bool patchChunkOffsets(uchar* data, qint64 size, const OffsetMap& offsets)
+    {
+        Box box;
+        if (!readBox(data, 0, size, box) || box.size - box.headerSize < 8) { return false; }
+
+        const bool co64 = box.type == "co64";
+        const qint64 entrySize = co64 ? 8 : 4;
+        uchar* entry = data + box.headerSize + 8;
+        const qint64 count = qFromBigEndian<quint32>(data + box.headerSize + 4);
+        if (count > (box.size - box.headerSize - 8) / entrySize) { return false; }
+
+        for (qint64 i = 0; i < count; i++, entry += entrySize) {
+            qint64 moved;
+            if (co64) {
+                if (!offsets.move(qFromBigEndian<quint64>(entry), moved)) { return false; }
+                qToBigEndian<quint64>(moved, entry);
+            } else {
+                if (!offsets.move(qFromBigEndian<quint32>(entry), moved)) { return false; }
+                qToBigEndian<quint32>(static_cast<quint32>(moved), entry);
+            }
+        }
+        return true;
+    }
+
+    // tfhd base data offset and tfra moof offsets are absolute, trun offsets are relative to
+    // moof and move with it. changed is set when some offset was moved
+    bool patchFragments(uchar* data, const Box& box, const OffsetMap& offsets, bool& changed)
+    {
+        const qint64 content = box.offset + box.headerSize;
+        const qint64 end = box.offset + box.size;
+
+        if (box.type == "moof" || box.type == "traf" || box.type == "mfra") {
+            for (qint64 pos = content; pos < end;) {
+                Box child;
+                if (!readBox(data, pos, end, child)) { return false; }
+                if (!patchFragments(data, child, offsets, changed)) { return false; }
+                pos += child.size;
+            }
+            return true;
+        }
+
+        auto move = [&](uchar* field, bool wide) {
+            qint64 offset = wide ? qint64(qFromBigEndian<quint64>(field)) : qint64(qFromBigEndian<quint32>(field));
+            qint64 moved;
+            if (!offsets.move(offset, moved)) { return false; }
+            if (moved == offset) { return true; }
+            if (wide) { qToBigEndian<quint64>(moved, field); }
+            else { qToBigEndian<quint32>(static_cast<quint32>(moved), field); }
+            changed = true;
+            return true;
+        };
+
+        // version and flags, track id and base data offset when flag 0x1 is set
+        if (box.type == "tfhd") {
+            if (end - content < 16 || !(qFromBigEndian<quint32>(data + content) & 0x1)) { return true; }
+            return move(data + content + 8, true);
+        }
+
+        // version and flags, track id, field lengths and entry count. entries have time, moof
+        // offset and traf, trun and sample numbers
+        if (box.type == "tfra") {
+            if (end - content < 16) { return false; }
+            const bool wide = data[content] == 1;
+            const quint32 lengths = qFromBigEndian<quint32>(data + content + 8);
+            const qint64 count = qFromBigEndian<quint32>(data + content + 12);
+            const qint64 entrySize = (wide ? 16 : 8) + ((lengths >> 4) & 3) + ((lengths >> 2) & 3) + (lengths & 3) + 3;
+            if (count > (end - content - 16) / entrySize) { return false; }
+
+            uchar* entry = data + content + 16;
+            for (qint64 i = 0; i < count; i++, entry += entrySize) {
+                if (!move(entry + (wide ? 8 : 4), wide)) { return false; }
+            }
+        }
+        return true;
+    }
+
+#ifdef Q_OS_UNIX
+    bool writeAll(int fd, const uchar* data, qint64 length)
+    {
+        while (length > 0) {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0) {
+                if (errno == EINTR) { continue; }
+                return false;
+            }
+            data += written;
+            length -= written;
+        }
+        return true;
+    }
+
+    // kernel copies the range when it can, rest is written from the mapping. copy_file_range
+    // fails across filesystems on older kernels
+    bool copyRange(int input, int output, const uchar* data, qint64 offset, qint64 length)
+    {
+#ifdef Q_OS_LINUX
+        loff_t inputOffset = offset;
+        while (length > 0) {
+            ssize_t copied = ::copy_file_range(input, &inputOffset, output, nullptr, length, 0);
+            if (copied <= 0) { break; }
+            length -= copied;
+        }
+        offset = inputOffset;
+#else
+        Q_UNUSED(input);
+#endif
+        return writeAll(output, data + offset, length);
+    }
+#endif
+}
+
+MetadataStripper::MetadataStripper(QObject* parent)
+: QObject(parent)
+{
+    pool_.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+MetadataStripper::~MetadataStripper()
+{
+    for (const auto& cancelled : std::as_const(cancelFlags_)) {
+        *cancelled = true;
+    }
+    pool_.waitForDone();
+}
+
+void MetadataStripper::start(int jobId, const QString& inputFilePath, const QString& outputFilePath,
+                             FormatInfo format)
+{
+    auto cancelled = std::make_shared<std::atomic_bool>(false);
+    cancelFlags_.insert(jobId, cancelled);
+
+    pool_.start([this, jobId, inputFilePath, outputFilePath, format, cancelled]() {
+        QString errorMessage;
+        bool success = strip(inputFilePath, outputFilePath, format, *cancelled, &errorMessage);
+
+        QMetaObject::invokeMethod(this, [this, jobId, success, errorMessage]() {
+            cancelFlags_.remove(jobId);
+            emit finished(jobId, success, errorMessage);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MetadataStripper::cancel(int jobId)
+{
+    if (auto cancelled = cancelFlags_.value(jobId)) {
+        *cancelled = true;
+    }
+}
+
+bool MetadataStripper::canStrip(FormatInfo format)
+{
+    switch (format.fileType) {
+        case FileType::AUDIO: {
+            auto audio = static_cast<AudioFormats>(format.enumValue);
+            return audio == AudioFormats::MP3 || audio == AudioFormats::ALAC_M4A;
+        }
+        case FileType::VIDEO: {
+            auto video = static_cast<VideoFormats>(format.enumValue);
+            return video == VideoFormats::MP4 || video == VideoFormats::MOV || video == VideoFormats::M4V;
+        }
+        case FileType::IMAGE: {
+            auto image = static_cast<ImageFormats>(format.enumValue);
+            return image == ImageFormats::JPEG || image == ImageFormats::PNG || image == ImageFormats::WEBP;
+        }
+        default:
+            return false;
+    }
+}
+
+bool MetadataStripper::strip(const QString& inputFilePath, const QString& outputFilePath, FormatInfo format,
+                             const std::atomic_bool& cancelled, QString* errorMessage)
+{
+    QFile input(inputFilePath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        *errorMessage = "Input can't be read: " + input.errorString();
+        return false;
+    }
+
+    const qint64 size = input.size();
+    const uchar* data = size > 0 ? input.map(0, size) : nullptr;
+    if (!data) {
+        *errorMessage = "Input can't be mapped to memory";
+        return false;
+    }
+
+    Spans spans;
+    bool parsed = false;
+    if (format.fileType == FileType::IMAGE) {
+        switch (static_cast<ImageFormats>(format.enumValue)) {
+            case ImageFormats::JPEG:    parsed = jpegSpans(data, size, spans, errorMessage);    break;
+            case ImageFormats::PNG:     parsed = pngSpans(data, size, spans, errorMessage);     break;
+            case ImageFormats::WEBP:    parsed = webpSpans(data, size, spans, errorMessage);    break;
+            default:                    *errorMessage = "Format isn't supported";               break;
+        }
+    } else if (format.fileType == FileType::AUDIO && static_cast<AudioFormats>(format.enumValue) == AudioFormats::MP3) {
+        parsed = mp3Spans(data, size, spans, errorMessage);
+    } else {
+        parsed = isoBmffSpans(data, size, spans, errorMessage);
+    }
+    if (!parsed) { return false; }
+    if (cancelled) {
+        *errorMessage = "Metadata removal cancelled";
+        return false;
+    }
+
+    // trailing tags and moov at the end are changed in place without copying the rest. file
+    // with other hardlinks is written to a new inode and renamed so the other names keep it
+    const bool inPlace = inputFilePath == outputFilePath;
+    if (inPlace && !spans.isEmpty() && !hasOtherLinks(input) && spans[0].data.isEmpty() && spans[0].offset == 0
+        && std::all_of(spans.cbegin() + 1, spans.cend(), [](const Span& span) { return !span.data.isEmpty(); })) {
+        return rewriteTail(input, data, spans, errorMessage);
+    }
+
+    // replaced input keeps its permissions
+    const QString target = inPlace ? FileUtils::partialFilePath(outputFilePath) : outputFilePath;
+    if (!writeSpans(input, data, spans, target, cancelled, errorMessage)) {
+        QFile::remove(target);
+        return false;
+    }
+    if (inPlace) {
+        QFile::setPermissions(target, input.permissions());
+        if (!FileUtils::replaceFile(target, outputFilePath)) {
+            QFile::remove(target);
+            *errorMessage = "Input couldn't be replaced";
+            return false;
+        }
+    }
+    return true;
+}
+
+void MetadataStripper::keep(Spans& spans, qint64 offset, qint64 length)
+{
+    // neighbouring ranges are copied with one call
+    if (!spans.isEmpty() && spans.last().data.isEmpty()
+        && spans.last().offset + spans.last().length == offset) {
+        spans.last().length += length;
+        return;
+    }
+    spans.append({offset, length, {}});
+}
+
+bool MetadataStripper::jpegSpans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage)
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        *errorMessage = "Not a JPEG file";
+        return false;
+    }
+    keep(spans, 0, 2);
+
+    qint64 pos = 2;
+    while (pos < size) {
+        if (data[pos] != 0xFF) {
+            *errorMessage = QString("Broken JPEG marker at offset %1").arg(pos);
+            return false;
+        }
+
+        // fill bytes before marker are dropped
+        while (pos < size && data[pos] == 0xFF) { pos++; }
+        if (pos >= size) { break; }
+        const uchar marker = data[pos++];
+        const qint64 markerStart = pos - 2;
+
+        // end of image, anything after it (thumbnails of MPF, trailers) is dropped too
+        if (marker == 0xD9) {
+            keep(spans, markerStart, 2);
+            return true;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            keep(spans, markerStart, 2);
+            continue;
+        }
+
+        if (pos + 2 > size) { break; }
+        const qint64 length = qFromBigEndian<quint16>(data + pos);
+        if (length < 2 || pos + length > size) {
+            *errorMessage = QString("JPEG segment at offset %1 is truncated").arg(markerStart);
+            return false;
+        }
+        if (!isJpegMetadata(marker, data + pos + 2, length - 2)) {
+            keep(spans, markerStart, pos + length - markerStart);
+        }
+        pos += length;
+
+        // entropy coded data ends at first marker which isn't stuffed zero or restart marker.
+        // progressive images have more segments between scans
+        if (marker == 0xDA) {
+            qint64 scanEnd = pos;
+            for (;;) {
+                const void* found = std::memchr(data + scanEnd, 0xFF, size - scanEnd);
+                if (!found) {
+                    scanEnd = size;
+                    break;
+                }
+                scanEnd = static_cast<const uchar*>(found) - data;
+                if (scanEnd + 1 >= size) {
+                    scanEnd = size;
+                    break;
+                }
+                const uchar next = data[scanEnd + 1];
+                if (next != 0x00 && (next < 0xD0 || next > 0xD7)) { break; }
+                scanEnd += 2;
+            }
+            keep(spans, pos, scanEnd - pos);
+            pos = scanEnd;
+        }
+    }
+
+    // file without end marker is kept as far as it goes, decoders accept it too
+    return true;
+}
+
+bool MetadataStripper::pngSpans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage)
+{
+    if (size < 8 || std::memcmp(data, "\x89PNG\r\n\x1a\n", 8) != 0) {
+        *errorMessage = "Not a PNG file";
+        return false;
+    }
+    keep(spans, 0, 8);
+
+    // length, type, data and crc
+    qint64 pos = 8;
+    while (pos + 12 <= size) {
+        const qint64 length = qFromBigEndian<quint32>(data + pos);
+        if (length > size - pos - 12) { break; }
+
+        const QByteArrayView type(data + pos + 4, 4);
+        if (!isPngMetadata(type)) {
+            keep(spans, pos, length + 12);
+        }
+        pos += length + 12;
+
+        if (type == "IEND") { return true; }
+    }
+
+    *errorMessage = QString("PNG chunk at offset %1 is truncated").arg(pos);
+    return false;
+}
+
+bool MetadataStripper::webpSpans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage)
+{
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WEBP", 4) != 0) {
+        *errorMessage = "Not a WebP file";
+        return false;
+    }
+
+    // RIFF size and VP8X flags change so those are written from memory
+    QByteArray header(reinterpret_cast<const char*>(data), 12);
+    Spans chunks;
+    qint64 chunksSize = 0;
+
+    const qint64 riffEnd = qMin<qint64>(size, 8 + qFromLittleEndian<quint32>(data + 4));
+    qint64 pos = 12;
+    while (pos + 8 <= riffEnd) {
+        const QByteArrayView fourcc(data + pos, 4);
+        const qint64 length = qFromLittleEndian<quint32>(data + pos + 4);
+        if (pos + 8 + length > riffEnd) {
+            *errorMessage = QString("WebP chunk at offset %1 is truncated").arg(pos);
+            return false;
+        }
+
+        // chunks are padded to even size, last padding byte can be missing
+        const qint64 chunkSize = qMin(8 + length + (length & 1), riffEnd - pos);
+        if (fourcc == "VP8X" && length >= 1) {
+            QByteArray chunk(reinterpret_cast<const char*>(data + pos), chunkSize);
+            chunk[8] = static_cast<char>(chunk[8] & ~(0x20 | 0x08 | 0x04));
+            chunks.append({0, 0, chunk});
+            chunksSize += chunkSize;
+        } else if (fourcc != "EXIF" && fourcc != "XMP " && fourcc != "ICCP") {
+            keep(chunks, pos, chunkSize);
+            chunksSize += chunkSize;
+        }
+        pos += chunkSize;
+    }
+
+    qToLittleEndian<quint32>(static_cast<quint32>(4 + chunksSize), header.data() + 4);
+    spans.append({0, 0, header});
+    spans.append(chunks);
+    return true;
+}
+
+bool MetadataStripper::mp3Spans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage)
+{
+    // there can be more than one tag in front of the first frame
+    qint64 audioStart = 0;
+    for (qint64 tagSize; (tagSize = id3v2Size(data + audioStart, size - audioStart, "ID3")) > 0;) {
+        audioStart += tagSize;
+    }
+
+    // tags at the end are in any order, they are removed from the back until none is found
+    qint64 audioEnd = size;
+    for (bool found = true; found && audioEnd > audioStart;) {
+        found = false;
+        const uchar* end = data + audioEnd;
+        const qint64 available = audioEnd - audioStart;
+
+        if (available >= 128 && std::memcmp(end - 128, "TAG", 3) == 0) {
+            audioEnd -= 128;
+            found = true;
+        } else if (available >= 32 && std::memcmp(end - 32, "APETAGEX", 8) == 0) {
+            // size has items and footer, header is there when highest flag bit is set
+            qint64 tagSize = qFromLittleEndian<quint32>(end - 20);
+            if (qFromLittleEndian<quint32>(end - 12) & 0x80000000u) { tagSize += 32; }
+            if (tagSize < 32 || tagSize > available) { break; }
+            audioEnd -= tagSize;
+            found = true;
+        } else if (available >= 15 && std::memcmp(end - 9, "LYRICS200", 9) == 0) {
+            // six digit size of the lyrics before the end marker
+            bool ok = false;
+            qint64 tagSize = QByteArray(reinterpret_cast<const char*>(end - 15), 6).toLongLong(&ok) + 15;
+            if (!ok || tagSize > available) { break; }
+            audioEnd -= tagSize;
+            found = true;
+        } else if (available >= 10) {
+            qint64 tagSize = id3v2Size(end - 10, 10, "3DI");
+            if (tagSize > 0 && tagSize <= available) {
+                audioEnd -= tagSize;
+                found = true;
+            }
+        }
+    }
+
+    if (audioEnd <= audioStart) {
+        *errorMessage = "MP3 file has no audio frames";
+        return false;
+    }
+    keep(spans, audioStart, audioEnd - audioStart);
+    return true;
+}
+
+bool MetadataStripper::isoBmffSpans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage)
+{
+    // top level boxes, bytes after the last whole box are kept as they are
+    QList<Box> boxes;
+    int moov = -1;
+    for (qint64 pos = 0; pos < size;) {
+        Box box;
+        if (!readBox(data, pos, size, box)) { break; }
+        if (box.type == "moov") {
+            if (moov >= 0) {
+                *errorMessage = "File has more than one moov box";
+                return false;
+            }
+            moov = boxes.size();
+        }
+        boxes.append(box);
+        pos += box.size;
+    }
+    if (moov < 0) {
+        *errorMessage = "File has no moov box";
+        return false;
+    }
+    const qint64 boxesEnd = boxes.last().offset + boxes.last().size;
+
+    QByteArray rebuiltMoov;
+    QList<qint64> offsetTables;
+    if (!rebuildBox(data, boxes[moov], rebuiltMoov, offsetTables)) {
+        *errorMessage = "moov box is broken";
+        return false;
+    }
+
+    // layout of output, metadata boxes at top level are dropped as well
+    OffsetMap offsets;
+    QList<bool> kept;
+    qint64 newOffset = 0;
+    for (int i = 0; i < boxes.size(); i++) {
+        kept.append(i == moov || !isMetadataBox(data, boxes[i]));
+        if (!kept.last()) { continue; }
+        offsets.add(boxes[i].offset, boxes[i].size, newOffset);
+        newOffset += i == moov ? rebuiltMoov.size() : boxes[i].size;
+    }
+    offsets.add(boxesEnd, size - boxesEnd, newOffset);
+
+    for (qint64 table : std::as_const(offsetTables)) {
+        uchar* tableData = reinterpret_cast<uchar*>(rebuiltMoov.data() + table);
+        if (!patchChunkOffsets(tableData, rebuiltMoov.size() - table, offsets)) {
+            *errorMessage = "Chunk offset table points outside of media data";
+            return false;
+        }
+    }
+
+    for (int i = 0; i < boxes.size(); i++) {
+        const Box& box = boxes[i];
+        if (!kept[i]) { continue; }
+        if (i == moov) {
+            spans.append({0, 0, rebuiltMoov});
+            continue;
+        }
+
+        // fragments are copied from memory only when their offsets had to be moved
+        if (box.type == "moof" || box.type == "mfra") {
+            QByteArray fragment(reinterpret_cast<const char*>(data + box.offset), box.size);
+            uchar* fragmentData = reinterpret_cast<uchar*>(fragment.data());
+            Box fragmentBox = box;
+            fragmentBox.offset = 0;
+            fragmentBox.type = QByteArrayView(fragmentData + 4, 4);
+
+            bool changed = false;
+            if (!patchFragments(fragmentData, fragmentBox, offsets, changed)) {
+                *errorMessage = QString("Fragment at offset %1 is broken").arg(box.offset);
+                return false;
+            }
+            if (changed) {
+                spans.append({0, 0, fragment});
+                continue;
+            }
+        }
+        keep(spans, box.offset, box.size);
+    }
+    if (boxesEnd < size) { keep(spans, boxesEnd, size - boxesEnd); }
+    return true;
+}
+
+bool MetadataStripper::rewriteTail(QFile& input, const uchar* data, const Spans& spans, QString* errorMessage)
+{
+    const qint64 size = input.size();
+    qint64 pos = spans[0].length;
+    if (spans.size() == 1 && pos == size) { return true; }
+
+    input.unmap(const_cast<uchar*>(data));
+    input.close();
+
+    QFile file(input.fileName());
+    if (!file.open(QIODevice::ReadWrite) || !file.seek(pos)) {
+        *errorMessage = "Input can't be opened for writing: " + file.errorString();
+        return false;
+    }
+    for (int i = 1; i < spans.size(); i++) {
+        if (file.write(spans[i].data) != spans[i].data.size()) {
+            *errorMessage = "Input can't be written: " + file.errorString();
+            return false;
+        }
+        pos += spans[i].data.size();
+    }
+    if (!file.resize(pos)) {
+        *errorMessage = "Input can't be truncated: " + file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool MetadataStripper::writeSpans(QFile& input, const uchar* data, const Spans& spans, const QString& outputFilePath,
+                                  const std::atomic_bool& cancelled, QString* errorMessage)
+{
+#ifdef Q_OS_UNIX
+    int output = ::open(QFile::encodeName(outputFilePath).constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (output < 0) {
+        *errorMessage = QString("Output can't be created: %1").arg(std::strerror(errno));
+        return false;
+    }
+
+    bool written = true;
+    for (const Span& span : spans) {
+        if (cancelled) { break; }
+        written = span.data.isEmpty()
+                  ? copyRange(input.handle(), output, data, span.offset, span.length)
+                  : writeAll(output, reinterpret_cast<const uchar*>(span.data.constData()), span.data.size());
+        if (!written) {
+            *errorMessage = QString("Output can't be written: %1").arg(std::strerror(errno));
+            break;
+        }
+    }
+    ::close(output);
+#else
+    QFile output(outputFilePath);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorMessage = "Output can't be created: " + output.errorString();
+        return false;
+    }
+
+    bool written = true;
+    for (const Span& span : spans) {
+        if (cancelled) { break; }
+        written = span.data.isEmpty()
+                  ? output.write(reinterpret_cast<const char*>(data + span.offset), span.length) == span.length
+                  : output.write(span.data) == span.data.size();
+        if (!written) {
+            *errorMessage = "Output can't be written: " + output.errorString();
+            break;
+        }
+    }
+    Q_UNUSED(input);
+#endif
+
+    if (cancelled) {
+        *errorMessage = "Metadata removal cancelled";
+        return false;
+    }
+    return written;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef FORMAT_CONVERTER_METADATASTRIPPER_H
+#define FORMAT_CONVERTER_METADATASTRIPPER_H
+
+#include <atomic>
+#include <memory>
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+
+#include "utils/CommonEnums.h"
+
+class QFile;
+
+// removes metadata by copying only the parts of the container which aren't metadata. input is
+// mapped to memory and parsed without decoding pixels or audio, kept ranges are written in one
+// sequential pass with copy_file_range so their data doesn't go through user space when the
+// filesystem allows it. runs in a thread pool so files are stripped in parallel
+class MetadataStripper : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit MetadataStripper(QObject* parent = nullptr);
+    ~MetadataStripper() override;
+
+    void start(int jobId, const QString& inputFilePath, const QString& outputFilePath, FormatInfo format);
+    void cancel(int jobId);
+
+    static bool canStrip(FormatInfo format);
+
+    // output is written next to input and renamed over it when both paths are the same
+    static bool strip(const QString& inputFilePath, const QString& outputFilePath, FormatInfo format,
+                      const std::atomic_bool& cancelled, QString* errorMessage);
+
+private:
+
+    // part of output, either range of input or bytes written as they are
+    struct Span {
+        qint64 offset = 0;
+        qint64 length = 0;
+        QByteArray data;
+    };
+    using Spans = QList<Span>;
+
+    QThreadPool pool_;
+    QHash<int, std::shared_ptr<std::atomic_bool>> cancelFlags_;
+
+    static void keep(Spans& spans, qint64 offset, qint64 length);
+
+    // segments: APP1-APP15 (EXIF, XMP, ICC, IPTC...) and COM are dropped. JFIF and Adobe
+    // segments are kept as decoders need them for colors
+    static bool jpegSpans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage);
+    // text, EXIF, time and ICC chunks are dropped
+    static bool pngSpans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage);
+    // EXIF, XMP and ICCP chunks are dropped and their VP8X flags cleared
+    static bool webpSpans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage);
+    // ID3v2 tags at the front, ID3v1, APE, Lyrics3 and appended ID3v2 tags at the end. only
+    // the frames between them are kept
+    static bool mp3Spans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage);
+    // MP4, MOV and M4A: moov is rebuilt without udta, meta and XMP boxes and chunk offsets of
+    // its sample tables are moved by the removed size. fragment offsets of moof and mfra are
+    // patched the same way, mdat is copied as it is
+    static bool isoBmffSpans(const uchar* data, qint64 size, Spans& spans, QString* errorMessage);
+
+    // everything before the first changed part stays, so input is cut or only its end written
+    static bool rewriteTail(QFile& input, const uchar* data, const Spans& spans, QString* errorMessage);
+    static bool writeSpans(QFile& input, const uchar* data, const Spans& spans, const QString& outputFilePath,
+                           const std::atomic_bool& cancelled, QString* errorMessage);
+
+signals:
+    void finished(int jobId, bool success, const QString& errorMessage);
+};
+
+
+#endif //FORMAT_CONVERTER_METADATASTRIPPER_H
\ No newline at end of file
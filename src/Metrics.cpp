@@ -0,0 +1,129 @@
+#include "Metrics.h"
+
+#include <QSaveFile>
+
+
+Metrics::Histogram::Histogram(const QVector<double>& bounds)
+: bounds(bounds), buckets(bounds.size(), 0) {}
+
+void Metrics::Histogram::observe(double value)
+{
+    for (int i = 0; i < bounds.size(); i++) {
+        if (value <= bounds[i]) { buckets[i]++; }
+    }
+    sum += value;
+    count++;
+}
+
+void Metrics::observeStage(const QString& stage, double seconds)
+{
+    auto it = stageDurations_.find(stage);
+    if (it == stageDurations_.end()) {
+        it = stageDurations_.insert(stage, Histogram(durationBounds()));
+    }
+    it->observe(seconds);
+}
+
+void Metrics::observeSpeed(double speed)
+{
+    // speed is unknown until ffmpeg has written something
+    if (speed <= 0.0) { return; }
+    speed_.observe(speed);
+}
+
+void Metrics::addJob(const QString& type, bool success)
+{
+    jobs_[{type, success}]++;
+}
+
+void Metrics::addBytes(qint64 inputBytes, qint64 outputBytes)
+{
+    inputBytes_ += qMax<qint64>(0, inputBytes);
+    outputBytes_ += qMax<qint64>(0, outputBytes);
+}
+
+void Metrics::addCacheLookup(bool hit)
+{
+    if (hit) {
+        cacheHits_++;
+    } else {
+        cacheMisses_++;
+    }
+}
+
+QByteArray Metrics::prometheusText() const
+{
+    QByteArray text;
+
+    text += "# HELP format_converter_jobs_total Finished jobs.\n"
+            "# TYPE format_converter_jobs_total counter\n";
+    for (auto it = jobs_.cbegin(); it != jobs_.cend(); ++it) {
+        text += "format_converter_jobs_total{type=\"" + it.key().first.toUtf8() + "\",result=\""
+                + (it.key().second ? "success" : "failure") + "\"} " + QByteArray::number(it.value()) + "\n";
+    }
+
+    text += "# HELP format_converter_input_bytes_total Input bytes of successful jobs.\n"
+            "# TYPE format_converter_input_bytes_total counter\n"
+            "format_converter_input_bytes_total " + QByteArray::number(inputBytes_) + "\n";
+    text += "# HELP format_converter_output_bytes_total Output bytes of successful jobs.\n"
+            "# TYPE format_converter_output_bytes_total counter\n"
+            "format_converter_output_bytes_total " + QByteArray::number(outputBytes_) + "\n";
+
+    text += "# HELP format_converter_cache_lookups_total Conversion cache lookups.\n"
+            "# TYPE format_converter_cache_lookups_total counter\n"
+            "format_converter_cache_lookups_total{result=\"hit\"} " + QByteArray::number(cacheHits_) + "\n"
+            "format_converter_cache_lookups_total{result=\"miss\"} " + QByteArray::number(cacheMisses_) + "\n";
+
+    text += "# HELP format_converter_stage_duration_seconds Duration of job stages.\n"
+            "# TYPE format_converter_stage_duration_seconds histogram\n";
+    for (auto it = stageDurations_.cbegin(); it != stageDurations_.cend(); ++it) {
+        appendHistogram(text, "format_converter_stage_duration_seconds",
+                        "stage=\"" + it.key().toUtf8() + "\"", it.value());
+    }
+
+    text += "# HELP format_converter_encode_speed Encoded media time per wall time.\n"
+            "# TYPE format_converter_encode_speed histogram\n";
+    appendHistogram(text, "format_converter_encode_speed", {}, speed_);
+
+    return text;
+}
+
+bool Metrics::writeTextfile(const QString& filePath, QString* errorMessage) const
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorMessage) { *errorMessage = file.errorString(); }
+        return false;
+    }
+    file.write(prometheusText());
+    if (!file.commit()) {
+        if (errorMessage) { *errorMessage = file.errorString(); }
+        return false;
+    }
+    return true;
+}
+
+QVector<double> Metrics::durationBounds()
+{
+    return {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300, 600};
+}
+
+QVector<double> Metrics::speedBounds()
+{
+    return {0.1, 0.25, 0.5, 1, 2, 4, 8, 16, 32, 64, 128};
+}
+
+void Metrics::appendHistogram(QByteArray& text, const QByteArray& name, const QByteArray& labels,
+                              const Histogram& histogram)
+{
+    QByteArray prefix = labels.isEmpty() ? QByteArray() : labels + ",";
+    QByteArray suffix = labels.isEmpty() ? QByteArray() : "{" + labels + "}";
+
+    for (int i = 0; i < histogram.bounds.size(); i++) {
+        text += name + "_bucket{" + prefix + "le=\"" + QByteArray::number(histogram.bounds[i]) + "\"} "
+                + QByteArray::number(histogram.buckets[i]) + "\n";
+    }
+    text += name + "_bucket{" + prefix + "le=\"+Inf\"} " + QByteArray::number(histogram.count) + "\n";
+    text += name + "_sum" + suffix + " " + QByteArray::number(histogram.sum) + "\n";
+    text += name + "_count" + suffix + " " + QByteArray::number(histogram.count) + "\n";
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef FORMAT_CONVERTER_METRICS_H
+#define FORMAT_CONVERTER_METRICS_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// counters and histograms of finished jobs in prometheus text format. stages are named
+// after what was running (queue, probe, hash, ffmpeg, exiftool, libav...), every stage gets
+// its own duration histogram when it is first seen
+class Metrics {
+public:
+
+    void observeStage(const QString& stage, double seconds);
+    void observeSpeed(double speed);
+    void addJob(const QString& type, bool success);
+    void addBytes(qint64 inputBytes, qint64 outputBytes);
+    void addCacheLookup(bool hit);
+
+    QByteArray prometheusText() const;
+
+    // written to temporary file and renamed so node exporter never reads half written file
+    bool writeTextfile(const QString& filePath, QString* errorMessage = nullptr) const;
+
+private:
+
+    // buckets are cumulative like in prometheus
+    struct Histogram {
+        QVector<double> bounds;
+        QVector<quint64> buckets;
+        double sum = 0.0;
+        quint64 count = 0;
+
+        explicit Histogram(const QVector<double>& bounds = {});
+        void observe(double value);
+    };
+
+    QMap<QString, Histogram> stageDurations_;
+    Histogram speed_ = Histogram(speedBounds());
+
+    // type and result
+    QMap<QPair<QString, bool>, quint64> jobs_;
+    quint64 inputBytes_ = 0;
+    quint64 outputBytes_ = 0;
+    quint64 cacheHits_ = 0;
+    quint64 cacheMisses_ = 0;
+
+    static QVector<double> durationBounds();
+    static QVector<double> speedBounds();
+    static void appendHistogram(QByteArray& text, const QByteArray& name, const QByteArray& labels,
+                                const Histogram& histogram);
+};
+
+
+#endif //FORMAT_CONVERTER_METRICS_H
\ No newline at end of file
@@ -1,25 +1,54 @@
 #include "ProgressHandler.h"
 
-#include <QRegularExpression>
 #include <QString>
 
 
-void ProgressHandler::handleFfmpegProgress(const QString& text)
+void ProgressHandler::handleFfmpegProgress(const QByteArray& data)
 {
-    for (const QString &line : text.split('\n')) {
+    // progress is given as key=value lines and every block ends with progress=continue/end
+    for (const QByteArray& line : takeLines(progressBuffer_, data)) {
+        if (parseProgressLine(stats_, line)) {
+            progressBlockEnded();
+        }
+    }
+}
 
-        const QString trimmed = line.trimmed();
-        if (trimmed.isEmpty()) { continue; }
-        if (!line.contains("time=") && !line.contains("Duration")) { continue; }
+void ProgressHandler::startSegments(int segmentCount)
+{
+    segmentStats_ = QVector<FfmpegStats>(segmentCount);
+    segmentBuffers_ = QVector<QByteArray>(segmentCount);
+}
 
-        emit logMessage("FFmpeg: " + trimmed);
+void ProgressHandler::handleSegmentProgress(int segment, const QByteArray& data)
+{
+    if (segment < 0 || segment >= segmentStats_.size()) { return; }
 
-        if (totalDuration_ == 0) {
-            getTotalDuration(line);
-            continue;
-        }
+    bool blockEnded = false;
+    for (const QByteArray& line : takeLines(segmentBuffers_[segment], data)) {
+        blockEnded = parseProgressLine(segmentStats_[segment], line) || blockEnded;
+    }
+    if (!blockEnded) { return; }
+
+    // segments are encoded side by side so their times and speeds add up
+    FfmpegStats total;
+    for (const FfmpegStats& stats : std::as_const(segmentStats_)) {
+        total.outTimeUs += stats.outTimeUs;
+        total.totalSize += stats.totalSize;
+        total.frame += stats.frame;
+        total.fps += stats.fps;
+        total.speed += stats.finished ? 0.0 : stats.speed;
+    }
+    stats_ = total;
+    progressBlockEnded();
+}
+
+void ProgressHandler::handleFfmpegOutput(const QByteArray& data)
+{
+    for (const QByteArray& line : takeLines(outputBuffer_, data)) {
+        const QString trimmed = QString::fromUtf8(line).trimmed();
+        if (trimmed.isEmpty()) { continue; }
 
-        getProgress(line);
+        emit logMessage("FFmpeg: " + trimmed);
     }
 }
 
@@ -31,20 +60,43 @@ void ProgressHandler::handleExifToolProgress(const QString &text)
     }
 }
 
+void ProgressHandler::handleEngineProgress(qint64 outTimeUs, qint64 totalSize)
+{
+    stats_.outTimeUs = outTimeUs;
+    stats_.totalSize = totalSize;
+
+    qint64 elapsedMs = elapsed_.isValid() ? elapsed_.elapsed() : 0;
+    if (elapsedMs > 0) {
+        stats_.speed = (outTimeUs / 1000.0) / elapsedMs;
+    }
+    progressBlockEnded();
+}
+
 void ProgressHandler::progressStarted(QString processName)
 {
+    elapsed_.start();
     emit updateProgress(0);
     emit logMessage("\n" + processName + " started!\n");
 }
 
 void ProgressHandler::progressFinished(QString processName, bool lastConversion)
 {
+    // cache hits finish without a started process
+    if (elapsed_.isValid()) {
+        emit stageFinished(processName, elapsed_.nsecsElapsed() / 1e9, stats_);
+        elapsed_.invalidate();
+    }
+
     emit updateProgress(100, true);
     emit logMessage("\n" + processName + " finished!");
     emit finished();
 
-    // progress has ended so next duration is new process
-    totalDuration_ = 0;
+    // progress has ended so next process starts from empty state
+    progressBuffer_.clear();
+    outputBuffer_.clear();
+    stats_ = FfmpegStats();
+    segmentStats_.clear();
+    segmentBuffers_.clear();
 
     if (lastConversion) {
         emit allDone();
@@ -56,30 +108,76 @@ void ProgressHandler::progressFailed(QString processName)
     emit logMessage("\nProgress failed during " + processName + " process!\n");
 }
 
-void ProgressHandler::getTotalDuration(const QString &line)
+bool ProgressHandler::parseProgressLine(FfmpegStats& stats, const QByteArray& line)
 {
-    static const QRegularExpression reDuration(R"(Duration: (\d+):(\d+):(\d+\.\d+))");
+    int separator = line.indexOf('=');
+    if (separator <= 0) { return false; }
+
+    const QByteArray key = line.left(separator);
+    const QByteArray value = line.mid(separator + 1).trimmed();
+
+    // values are N/A until ffmpeg has something to tell, those are left as zero
+    bool ok = false;
+
+    // out_time_ms is also in microseconds, older ffmpeg versions only print that one
+    if (key == "out_time_us" || key == "out_time_ms") {
+        qint64 outTimeUs = value.toLongLong(&ok);
+        if (ok) { stats.outTimeUs = outTimeUs; }
+
+    } else if (key == "total_size") {
+        qint64 totalSize = value.toLongLong(&ok);
+        if (ok) { stats.totalSize = totalSize; }
+
+    } else if (key == "frame") {
+        qint64 frame = value.toLongLong(&ok);
+        if (ok) { stats.frame = frame; }
+
+    } else if (key == "fps") {
+        double fps = value.toDouble(&ok);
+        if (ok) { stats.fps = fps; }
 
-    QRegularExpressionMatch match = reDuration.match(line);
-    if (match.hasMatch()){
-        totalDuration_ = match.captured(1).toInt() * 3600
-                        + match.captured(2).toInt() * 60
-                        + match.captured(3).toDouble();
+    } else if (key == "speed") {
+        double speed = value.chopped(value.endsWith('x') ? 1 : 0).trimmed().toDouble(&ok);
+        if (ok) { stats.speed = speed; }
+
+    } else if (key == "progress") {
+        stats.finished = value == "end";
+        return true;
     }
+    return false;
 }
 
-void ProgressHandler::getProgress(const QString& line)
+void ProgressHandler::progressBlockEnded()
 {
-    static const QRegularExpression reTime(R"(time=(\d+):(\d+):(\d+\.\d+))" );
+    emit statsUpdated(stats_);
+
+    if (stats_.finished) {
+        emit logMessage(QString("FFmpeg: %1 MB written, speed %2x")
+                        .arg(stats_.totalSize / (1024.0 * 1024.0), 0, 'f', 1)
+                        .arg(stats_.speed, 0, 'f', 2));
+        return;
+    }
 
-    QRegularExpressionMatch match = reTime.match(line);
-    if (match.hasMatch() && totalDuration_ > 0) {
-        double current = match.captured(1).toInt() * 3600
-                        + match.captured(2).toInt() * 60
-                        + match.captured(3).toDouble();
-        int progress = static_cast<int>((current / totalDuration_) * 100);
+    if (totalDuration_ > 0) {
+        int progress = static_cast<int>((stats_.outTimeUs / 1e6 / totalDuration_) * 100);
 
         if (progress >= 100) { progress = 100; }
+        if (progress < 0) { progress = 0; }
         emit updateProgress(progress);
     }
+}
+
+QList<QByteArray> ProgressHandler::takeLines(QByteArray& buffer, const QByteArray& data)
+{
+    buffer += data;
+
+    int lastNewLine = buffer.lastIndexOf('\n');
+    if (lastNewLine < 0) { return {}; }
+
+    // ffmpeg uses \r when it rewrites the same line
+    QByteArray complete = buffer.left(lastNewLine);
+    buffer.remove(0, lastNewLine + 1);
+    complete.replace('\r', '\n');
+
+    return complete.split('\n');
 }
\ No newline at end of file
@@ -1,6 +1,19 @@
 #ifndef FORMAT_CONVERTER_PROGRESSHANDLER_H
 #define FORMAT_CONVERTER_PROGRESSHANDLER_H
+#include <QByteArray>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QVector>
+
+// one block of ffmpeg -progress output
+struct FfmpegStats {
+    qint64 outTimeUs = 0;
+    qint64 totalSize = 0;       // bytes written so far
+    qint64 frame = 0;
+    double fps = 0.0;
+    double speed = 0.0;         // encoded media time per wall time
+    bool finished = false;      // progress=end
+};
 
 class ProgressHandler : public QObject {
     Q_OBJECT
@@ -10,8 +23,19 @@ public:
 
     ~ProgressHandler() = default;
 
-    void handleFfmpegProgress(const QString& text);
+    // duration known beforehand (from ffprobe) is used to count percents
+    void setTotalDuration(double duration) { totalDuration_ = duration; }
+
+    // stdout of ffmpeg started with -progress pipe:1
+    void handleFfmpegProgress(const QByteArray& data);
+    // stderr of ffmpeg, only warnings and errors are printed there
+    void handleFfmpegOutput(const QByteArray& data);
+    // segmented encoding runs many ffmpeg processes at once, progress is their sum
+    void startSegments(int segmentCount);
+    void handleSegmentProgress(int segment, const QByteArray& data);
     void handleExifToolProgress(const QString& text);
+    // libav engine reports written output directly, speed is counted from wall time
+    void handleEngineProgress(qint64 outTimeUs, qint64 totalSize);
 
     void progressStarted(QString progressName);
     void progressFinished(QString progressName, bool lastConversion);
@@ -21,12 +45,26 @@ private:
 
     double totalDuration_;
 
-    void getTotalDuration(const QString &line);
-    void getProgress(const QString& line);
+    // chunks can end in the middle of a line so rest is kept for next chunk
+    QByteArray progressBuffer_;
+    QByteArray outputBuffer_;
+    FfmpegStats stats_;
+    QElapsedTimer elapsed_;
+    QVector<FfmpegStats> segmentStats_;
+    QVector<QByteArray> segmentBuffers_;
+
+    // returns true when line ends the progress block
+    static bool parseProgressLine(FfmpegStats& stats, const QByteArray& line);
+    void progressBlockEnded();
+
+    static QList<QByteArray> takeLines(QByteArray& buffer, const QByteArray& data);
 
 signals:
 
     void updateProgress(int percent, bool isFinished = false);
+    void statsUpdated(const FfmpegStats& stats);
+    // duration of finished process and its last stats (empty for exiftool)
+    void stageFinished(const QString& processName, double seconds, const FfmpegStats& stats);
     void logMessage(const QString& message);
     void finished();
     void allDone();
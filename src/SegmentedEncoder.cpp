@@ -0,0 +1,217 @@
+#include "SegmentedEncoder.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+
+SegmentedEncoder::~SegmentedEncoder()
+{
+    // segment files can be removed only after processes have closed them
+    killProcesses();
+    for (QProcess* process : std::as_const(processes_)) {
+        process->waitForFinished(1000);
+    }
+}
+
+void SegmentedEncoder::start(const SegmentedEncoding& encoding)
+{
+    encoding_ = encoding;
+
+    // segments of long video can be big so they aren't written to /tmp
+    QString outputFolder = QFileInfo(encoding_.outputFilePath).absolutePath();
+    tempDir_ = std::make_unique<QTemporaryDir>(QDir(outputFolder).filePath(".format-converter-XXXXXX"));
+    if (!tempDir_->isValid()) {
+        fail("Couldn't create folder for segments: " + tempDir_->errorString());
+        return;
+    }
+
+    split();
+}
+
+void SegmentedEncoder::cancel()
+{
+    if (done_) { return; }
+    done_ = true;
+    killProcesses();
+}
+
+void SegmentedEncoder::split()
+{
+    int segments = qMax(2, encoding_.segments);
+    double segmentTime = encoding_.duration / segments;
+    emit logMessage(jobId_, QString("Splitting video into %1 segments of %2 s")
+                            .arg(segments).arg(segmentTime, 0, 'f', 1));
+
+    runProcess(Stage::SPLIT, FFmpeg::Segmented::splitArgs(encoding_.inputFilePath,
+                                                          tempPath("segments.txt"),
+                                                          tempPath("part%04d.mkv"),
+                                                          segmentTime));
+}
+
+void SegmentedEncoder::encode()
+{
+    // cuts are made at keyframes so real segment count can differ from requested one
+    QStringList parts;
+    QFile segmentList(tempPath("segments.txt"));
+    if (segmentList.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QTextStream stream(&segmentList);
+        while (!stream.atEnd()) {
+            QString line = stream.readLine().trimmed();
+            if (!line.isEmpty()) { parts << QFileInfo(line).fileName(); }
+        }
+    }
+    if (parts.isEmpty()) {
+        fail("Splitting video didn't produce any segments!");
+        return;
+    }
+
+    // concat demuxer reads paths relative to the list file
+    QFile concatList(tempPath("concat.txt"));
+    if (!concatList.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        fail("Couldn't write segment list: " + concatList.errorString());
+        return;
+    }
+    QTextStream concatStream(&concatList);
+    for (int i = 0; i < parts.size(); i++) {
+        concatStream << QString("file 'encoded%1.mkv'\n").arg(i, 4, 10, QChar('0'));
+    }
+    concatList.close();
+
+    if (progressHandler_) {
+        progressHandler_->startSegments(parts.size());
+    }
+    int parallel = encoding_.parallel > 0 ? qMin(encoding_.parallel, parts.size()) : parts.size();
+    emit logMessage(jobId_, QString("Encoding %1 segments, %2 at a time").arg(parts.size()).arg(parallel));
+
+    // audio runs beside the segments, it is a single thread for most codecs
+    if (encoding_.hasAudio) {
+        runProcess(Stage::ENCODE, FFmpeg::Segmented::audioArgs(encoding_.inputFilePath, tempPath("audio.mka"),
+                                                               encoding_.format.enumValue, encoding_.plan));
+    }
+
+    segmentArgs_.clear();
+    nextSegment_ = 0;
+    for (int i = 0; i < parts.size(); i++) {
+        QString encodedPath = tempPath(QString("encoded%1.mkv").arg(i, 4, 10, QChar('0')));
+        segmentArgs_ << FFmpeg::Segmented::segmentArgs(tempPath(parts.at(i)), encodedPath,
+                                                       encoding_.format.enumValue, encoding_.settings);
+    }
+    startNextSegments();
+}
+
+void SegmentedEncoder::startNextSegments()
+{
+    const int parallel = encoding_.parallel > 0 ? encoding_.parallel : segmentArgs_.size();
+    while (runningSegments_ < parallel && nextSegment_ < segmentArgs_.size()) {
+        runningSegments_++;
+        runProcess(Stage::ENCODE, segmentArgs_.at(nextSegment_), nextSegment_);
+        nextSegment_++;
+    }
+}
+
+void SegmentedEncoder::concat()
+{
+    emit logMessage(jobId_, "Joining segments");
+
+    QString audioPath = encoding_.hasAudio ? tempPath("audio.mka") : QString();
+    runProcess(Stage::CONCAT, FFmpeg::Segmented::concatArgs(encoding_.inputFilePath, tempPath("concat.txt"),
+                                                            audioPath, encoding_.outputFilePath,
+                                                            encoding_.outputOptions));
+}
+
+void SegmentedEncoder::runProcess(Stage stage, const QStringList& args, int segment)
+{
+    QString name;
+    switch (stage) {
+        case Stage::SPLIT:  name = "split";                                                     break;
+        case Stage::ENCODE: name = segment < 0 ? "audio" : "segment " + QString::number(segment); break;
+        case Stage::CONCAT: name = "concat";                                                    break;
+    }
+
+    QProcess* process = new QProcess(this);
+    ProcessPriorities::apply(process, encoding_.processPriority);
+    processes_.append(process);
+    runningProcesses_++;
+
+    // only video segments are counted to progress, they cover the whole duration together
+    connect(process, &QProcess::readyReadStandardOutput, this, [this, process, segment]() {
+        QByteArray data = process->readAllStandardOutput();
+        if (segment >= 0 && progressHandler_) {
+            progressHandler_->handleSegmentProgress(segment, data);
+        }
+    });
+    connect(process, &QProcess::readyReadStandardError, this, [this, process, name]() {
+        const QStringList lines = QString::fromUtf8(process->readAllStandardError()).split('\n', Qt::SkipEmptyParts);
+        for (const QString& line : lines) {
+            if (!line.trimmed().isEmpty()) {
+                emit logMessage(jobId_, "FFmpeg " + name + ": " + line.trimmed());
+            }
+        }
+    });
+
+    connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError processError) {
+        if (processError != QProcess::FailedToStart) { return; }
+        processes_.removeOne(process);
+        runningProcesses_--;
+        process->deleteLater();
+        fail("FFmpeg couldn't be started!");
+    });
+
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+        [this, process, stage, name, segment](int exitCode, QProcess::ExitStatus exitStatus) {
+        processes_.removeOne(process);
+        runningProcesses_--;
+        if (segment >= 0) { runningSegments_--; }
+        process->deleteLater();
+
+        if (done_) { return; }
+        if (exitStatus != QProcess::NormalExit || exitCode != 0) {
+            fail("FFmpeg " + name + " exited with code " + QString::number(exitCode) + "!");
+            return;
+        }
+        processFinished(stage);
+    });
+
+    process->start("ffmpeg", FFmpeg::progressArgs() + args);
+}
+
+void SegmentedEncoder::processFinished(Stage stage)
+{
+    // encode stage continues when all segments and audio are ready
+    if (stage == Stage::ENCODE) { startNextSegments(); }
+    if (runningProcesses_ > 0) { return; }
+
+    switch (stage) {
+        case Stage::SPLIT:
+            encode();
+            break;
+        case Stage::ENCODE:
+            concat();
+            break;
+        case Stage::CONCAT:
+            done_ = true;
+            emit finished(jobId_, true, QString());
+            break;
+    }
+}
+
+void SegmentedEncoder::fail(const QString& message)
+{
+    if (done_) { return; }
+    done_ = true;
+
+    killProcesses();
+    QFile::remove(encoding_.outputFilePath);
+    emit finished(jobId_, false, message);
+}
+
+void SegmentedEncoder::killProcesses()
+{
+    for (QProcess* process : std::as_const(processes_)) {
+        if (process->state() != QProcess::NotRunning) {
+            process->kill();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#ifndef FORMAT_CONVERTER_SEGMENTEDENCODER_H
+#define FORMAT_CONVERTER_SEGMENTEDENCODER_H
+
+#include <memory>
+
+#include <QObject>
+#include <QPointer>
+#include <QProcess>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVector>
+
+#include "ProgressHandler.h"
+#include "utils/CommonEnums.h"
+#include "utils/ConverterArguments.h"
+#include "utils/EncoderSettings.h"
+#include "utils/ProcessPriority.h"
+
+struct SegmentedEncoding {
+    QString inputFilePath;
+    QString outputFilePath;
+    FormatInfo format;
+    EncoderSettings settings;
+    FFmpeg::Converter::StreamPlan plan;
+    QStringList outputOptions;      // given to final concat, metadata is read from original input
+    bool hasAudio = false;
+    double duration = 0.0;
+    int segments = 2;
+    int parallel = 0;               // segments encoded at the same time, 0 encodes all at once
+    ProcessPriority processPriority;    // every split, segment and concat process gets it
+};
+
+// converts one long video with many ffmpeg processes: input is cut at keyframes into segments,
+// segments are encoded at the same time, audio is encoded once beside them and everything is
+// joined with concat demuxer without re-encoding. temporary files are kept next to the output
+class SegmentedEncoder : public QObject {
+    Q_OBJECT
+
+public:
+
+    SegmentedEncoder(int jobId, ProgressHandler* progressHandler, QObject* parent = nullptr)
+    : QObject(parent), jobId_(jobId), progressHandler_(progressHandler) {}
+    ~SegmentedEncoder() override;
+
+    void start(const SegmentedEncoding& encoding);
+    // running processes are killed, finished isn't emitted after this
+    void cancel();
+
+private:
+
+    enum class Stage {
+        SPLIT,
+        ENCODE,
+        CONCAT
+    };
+
+    int jobId_;
+    QPointer<ProgressHandler> progressHandler_;
+    SegmentedEncoding encoding_;
+    std::unique_ptr<QTemporaryDir> tempDir_;
+
+    QVector<QProcess*> processes_;
+    int runningProcesses_ = 0;
+    // segments are started in order when one of the running ones finishes
+    QList<QStringList> segmentArgs_;
+    int nextSegment_ = 0;
+    int runningSegments_ = 0;
+    bool done_ = false;
+
+    void split();
+    void encode();
+    void concat();
+    void startNextSegments();
+
+    // segment is index of the progress in progress handler, -1 when progress isn't counted
+    void runProcess(Stage stage, const QStringList& args, int segment = -1);
+    void processFinished(Stage stage);
+    void fail(const QString& message);
+    void killProcesses();
+
+    QString tempPath(const QString& fileName) const { return tempDir_->filePath(fileName); }
+
+signals:
+    void logMessage(int jobId, const QString& message);
+    void finished(int jobId, bool success, const QString& errorMessage);
+};
+
+
+#endif //FORMAT_CONVERTER_SEGMENTEDENCODER_H
\ No newline at end of file
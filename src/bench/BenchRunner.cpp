@@ -0,0 +1,301 @@
+#include "BenchRunner.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonValue>
+#include <QProcess>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "../utils/DependencyChecker.h"
+
+namespace {
+
+    // lavfi sources, video has audio track so both streams are converted
+    QStringList sourceArgs(FileType fileType, const QString& resolution, int duration)
+    {
+        QString seconds = QString::number(duration);
+        QStringList args;
+        switch (fileType) {
+            case FileType::AUDIO:
+                args << "-f" << "lavfi" << "-i" << "sine=frequency=440:sample_rate=48000:duration=" + seconds;
+                break;
+            case FileType::VIDEO:
+                args << "-f" << "lavfi" << "-i" << "testsrc2=size=" + resolution + ":rate=30:duration=" + seconds
+                     << "-f" << "lavfi" << "-i" << "sine=frequency=440:sample_rate=48000:duration=" + seconds;
+                break;
+            case FileType::IMAGE:
+                args << "-f" << "lavfi" << "-i" << "testsrc2=size=" + resolution << "-frames:v" << "1";
+                break;
+            default:
+                break;
+        }
+        return args;
+    }
+
+    // formats whose defaults in ffmpeg can't write the synthetic source as is
+    QStringList formatArgs(FormatInfo format)
+    {
+        if (format.fileType == FileType::IMAGE) {
+            switch (static_cast<ImageFormats>(format.enumValue)) {
+                case ImageFormats::HEIF:
+                    return {"-c:v", "libx265", "-pix_fmt", "yuv420p", "-tag:v", "hvc1", "-f", "heif"};
+                case ImageFormats::ICO:
+                    return {"-vf", "scale=256:256"};
+                default:
+                    return {"-update", "1"};
+            }
+        }
+        if (format.fileType == FileType::VIDEO && format.enumValue == static_cast<int>(VideoFormats::MPEG)) {
+            return {"-c:a", "mp2"};
+        }
+        return {};
+    }
+
+#ifdef Q_OS_LINUX
+    // value in kB of a field in /proc/<pid>/status
+    qint64 statusValueKb(const QString& statusPath, const QByteArray& field)
+    {
+        QFile file(statusPath);
+        if (!file.open(QIODevice::ReadOnly)) { return 0; }
+        for (const QByteArray& line : file.readAll().split('\n')) {
+            if (line.startsWith(field)) {
+                return line.mid(field.size()).trimmed().split(' ').value(0).toLongLong();
+            }
+        }
+        return 0;
+    }
+#endif
+}
+
+BenchRunner::BenchRunner(Converter* converter, QObject* parent)
+: QObject(parent), converter_(converter)
+{
+    connect(converter_, &Converter::jobStarted, this, &BenchRunner::jobStarted);
+    connect(converter_, &Converter::jobFinished, this, &BenchRunner::jobFinished);
+    connect(converter_, &Converter::allDone, this, [this]() {
+        rssSampler_.stop();
+        batchWallMs_ = batchTimer_.elapsed();
+        batchCpuEnd_ = cpuTime();
+        emit finished();
+    });
+
+    rssSampler_.setInterval(20);
+    connect(&rssSampler_, &QTimer::timeout, this, &BenchRunner::sampleRss);
+}
+
+bool BenchRunner::start(const BenchOptions& options)
+{
+    workers_ = qMax(1, options.workers);
+    converter_->setMaxWorkers(workers_);
+
+    workFolder_ = options.workFolder.isEmpty() ? temporaryDir_.path() : options.workFolder;
+    if (workFolder_.isEmpty() || !QDir().mkpath(QDir(workFolder_).filePath("outputs"))) { return false; }
+
+    // pairs are collected first so generating inputs isn't part of the measured batch
+    QList<BenchCase> benchCases;
+    for (const FormatInfo& source : fileFormats) {
+        if (labelsBlackList.contains(source.label)) { continue; }
+        if (!options.formats.isEmpty() && !options.formats.contains(source.label)) { continue; }
+
+        // audio has no resolution and images no duration
+        QStringList resolutions = source.fileType == FileType::AUDIO ? QStringList{""} : options.resolutions;
+        QList<int> durations = source.fileType == FileType::IMAGE ? QList<int>{0} : options.durations;
+
+        for (const QString& resolution : std::as_const(resolutions)) {
+            for (int duration : std::as_const(durations)) {
+                QString inputFilePath = generateInput(source, resolution, duration);
+                if (inputFilePath.isEmpty()) { continue; }
+
+                for (const FormatInfo& target : targets(source)) {
+                    QString outputFilePath = QDir(workFolder_).filePath(
+                        "outputs/" + QFileInfo(inputFilePath).completeBaseName() + "." + target.label);
+                    benchCases.append({source, target, resolution, duration, inputFilePath, outputFilePath});
+                }
+            }
+        }
+    }
+    if (benchCases.isEmpty()) { return false; }
+
+    batchCpuStart_ = cpuTime();
+    batchTimer_.start();
+    rssSampler_.start();
+
+    for (const BenchCase& benchCase : std::as_const(benchCases)) {
+        QFile::remove(benchCase.outputFilePath);
+        int jobId = converter_->runConverter(benchCase.inputFilePath, benchCase.outputFilePath, false);
+        cases_.insert(jobId, benchCase);
+    }
+    return true;
+}
+
+QJsonObject BenchRunner::report() const
+{
+    int succeeded = 0;
+    for (const QJsonValue& result : results_) {
+        if (result["success"].toBool()) { succeeded++; }
+    }
+
+    QJsonObject total {
+        {"wall_ms", batchWallMs_},
+        {"cpu_user_ms", (batchCpuEnd_.user - batchCpuStart_.user) / 1000},
+        {"cpu_system_ms", (batchCpuEnd_.system - batchCpuStart_.system) / 1000},
+        {"peak_rss_kb", batchPeakRssKb_},
+        {"succeeded", succeeded},
+        {"failed", static_cast<int>(results_.size()) - succeeded}
+    };
+
+    return {
+        {"ffmpeg", DependencyChecker::ffmpegVersion()},
+        {"engine", converter_->defaultEngine() == Engine::LIBAV ? "libav" : "process"},
+        {"profile", converter_->profile()},
+        {"workers", workers_},
+        {"segments", converter_->segments()},
+        {"results", results_},
+        {"skipped", skipped_},
+        {"total", total}
+    };
+}
+
+void BenchRunner::jobStarted(int jobId)
+{
+    Measurement& measurement = measurements_[jobId];
+    measurement.cpuStart = cpuTime();
+    measurement.timer.start();
+}
+
+void BenchRunner::jobFinished(int jobId, bool success)
+{
+    if (!cases_.contains(jobId)) { return; }
+    const BenchCase benchCase = cases_.take(jobId);
+    const Measurement measurement = measurements_.take(jobId);
+
+    QJsonObject result {
+        {"source", benchCase.source.label},
+        {"target", benchCase.target.label},
+        {"input_size", QFileInfo(benchCase.inputFilePath).size()},
+        {"success", success}
+    };
+    if (!benchCase.resolution.isEmpty()) { result["resolution"] = benchCase.resolution; }
+    if (benchCase.duration > 0) { result["duration"] = benchCase.duration; }
+
+    // jobs rejected before starting have no measurement
+    if (measurement.timer.isValid()) {
+        result["wall_ms"] = measurement.timer.elapsed();
+
+        // other jobs running at the same time would be counted too
+        if (workers_ == 1) {
+            CpuTime now = cpuTime();
+            result["cpu_user_ms"] = (now.user - measurement.cpuStart.user) / 1000;
+            result["cpu_system_ms"] = (now.system - measurement.cpuStart.system) / 1000;
+            result["peak_rss_kb"] = measurement.peakRssKb;
+        }
+    }
+
+    // output is only needed for its size, removing it keeps disk usage low
+    if (success) {
+        result["output_size"] = QFileInfo(benchCase.outputFilePath).size();
+    }
+    QFile::remove(benchCase.outputFilePath);
+
+    results_.append(result);
+}
+
+void BenchRunner::sampleRss()
+{
+    qint64 rss = childrenRssKb();
+
+    // libav engine converts inside this process
+    if (converter_->defaultEngine() == Engine::LIBAV) {
+        rss += selfRssKb();
+    }
+
+    batchPeakRssKb_ = qMax(batchPeakRssKb_, rss);
+    for (Measurement& measurement : measurements_) {
+        measurement.peakRssKb = qMax(measurement.peakRssKb, rss);
+    }
+}
+
+QString BenchRunner::generateInput(FormatInfo source, const QString& resolution, int duration)
+{
+    QString name = source.label;
+    if (!resolution.isEmpty()) { name += "-" + resolution; }
+    if (duration > 0) { name += "-" + QString::number(duration) + "s"; }
+    QString filePath = QDir(workFolder_).filePath(name + "." + source.label);
+
+    // inputs in given work folder are reused between runs
+    if (QFileInfo(filePath).size() > 0) { return filePath; }
+
+    QStringList args = sourceArgs(source.fileType, resolution, duration);
+    args << formatArgs(source) << "-y" << filePath;
+
+    QProcess process;
+    process.start("ffmpeg", QStringList{"-hide_banner", "-loglevel", "error"} + args);
+    if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        QFile::remove(filePath);
+        skipped_.append(QJsonObject{
+            {"source", source.label},
+            {"reason", QString::fromUtf8(process.readAllStandardError()).trimmed()}
+        });
+        return {};
+    }
+    return filePath;
+}
+
+QList<FormatInfo> BenchRunner::targets(FormatInfo source)
+{
+    // same pairs which main window offers
+    QList<FormatInfo> formats;
+    for (const FormatInfo& it : fileFormats) {
+        if (it.fileType == source.fileType && it.enumValue != source.enumValue
+            && !labelsBlackList.contains(it.label)) {
+            formats.append(it);
+        }
+    }
+    return formats;
+}
+
+BenchRunner::CpuTime BenchRunner::cpuTime()
+{
+    CpuTime time;
+#ifdef Q_OS_UNIX
+    // children are counted when they have been waited, which QProcess does before finished
+    for (int who : {RUSAGE_SELF, RUSAGE_CHILDREN}) {
+        rusage usage {};
+        if (getrusage(who, &usage) != 0) { continue; }
+        time.user += qint64(usage.ru_utime.tv_sec) * 1000000 + usage.ru_utime.tv_usec;
+        time.system += qint64(usage.ru_stime.tv_sec) * 1000000 + usage.ru_stime.tv_usec;
+    }
+#endif
+    return time;
+}
+
+qint64 BenchRunner::childrenRssKb()
+{
+    qint64 rss = 0;
+#ifdef Q_OS_LINUX
+    // peak of every running child (ffmpeg, ffprobe, exiftool)
+    QDir tasks("/proc/self/task");
+    for (const QString& task : tasks.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile childrenFile(tasks.filePath(task + "/children"));
+        if (!childrenFile.open(QIODevice::ReadOnly)) { continue; }
+        for (const QByteArray& pid : childrenFile.readAll().split(' ')) {
+            if (pid.trimmed().isEmpty()) { continue; }
+            rss += statusValueKb("/proc/" + QString::fromLatin1(pid.trimmed()) + "/status", "VmHWM:");
+        }
+    }
+#endif
+    return rss;
+}
+
+qint64 BenchRunner::selfRssKb()
+{
+#ifdef Q_OS_LINUX
+    return statusValueKb("/proc/self/status", "VmRSS:");
+#else
+    return 0;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef FORMAT_CONVERTER_BENCHRUNNER_H
+#define FORMAT_CONVERTER_BENCHRUNNER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QObject>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include "../Converter.h"
+
+struct BenchOptions {
+    QStringList resolutions;        // WIDTHxHEIGHT of video and image sources
+    QList<int> durations;           // seconds of audio and video sources
+    QStringList formats;            // source format labels, empty means all
+    QString workFolder;             // generated inputs are kept here, empty uses temporary folder
+    int workers = 1;
+};
+
+// generates synthetic inputs with ffmpeg lavfi sources and runs every supported
+// source -> target pair trough Converter, measuring wall time, cpu time, peak rss and
+// output size of each. cpu time and rss of single pair are only known when one job runs
+// at a time, with more workers only totals of the batch are reported
+class BenchRunner : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit BenchRunner(Converter* converter, QObject* parent = nullptr);
+    ~BenchRunner() = default;
+
+    // returns false if no input could be generated
+    bool start(const BenchOptions& options);
+
+    QJsonObject report() const;
+
+private:
+
+    // user and system time in microseconds
+    struct CpuTime {
+        qint64 user = 0;
+        qint64 system = 0;
+    };
+
+    struct BenchCase {
+        FormatInfo source;
+        FormatInfo target;
+        QString resolution;
+        int duration = 0;
+        QString inputFilePath;
+        QString outputFilePath;
+    };
+
+    struct Measurement {
+        QElapsedTimer timer;
+        CpuTime cpuStart;
+        qint64 peakRssKb = 0;
+    };
+
+    Converter* converter_;
+    int workers_ = 1;
+
+    QTemporaryDir temporaryDir_;
+    QString workFolder_;
+
+    QHash<int, BenchCase> cases_;
+    QHash<int, Measurement> measurements_;
+    QJsonArray results_;
+    QJsonArray skipped_;
+
+    // whole batch
+    QElapsedTimer batchTimer_;
+    CpuTime batchCpuStart_;
+    CpuTime batchCpuEnd_;
+    qint64 batchWallMs_ = 0;
+    qint64 batchPeakRssKb_ = 0;
+
+    // children are sampled as their peak rss is lost when they exit
+    QTimer rssSampler_;
+
+    void jobStarted(int jobId);
+    void jobFinished(int jobId, bool success);
+    void sampleRss();
+
+    QString generateInput(FormatInfo source, const QString& resolution, int duration);
+    static QList<FormatInfo> targets(FormatInfo source);
+
+    static CpuTime cpuTime();
+    static qint64 childrenRssKb();
+    static qint64 selfRssKb();
+
+signals:
+    void finished();
+};
+
+
+#endif //FORMAT_CONVERTER_BENCHRUNNER_H
\ No newline at end of file
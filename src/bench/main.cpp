@@ -0,0 +1,124 @@
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+
+#include "../Converter.h"
+#include "../utils/DependencyChecker.h"
+#include "BenchRunner.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("format-converter-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Conversion benchmark of Format Converter. Synthetic inputs are "
+                                     "converted to every supported target format and results are "
+                                     "printed as json.");
+    parser.addHelpOption();
+
+    QCommandLineOption resolutionsOption("resolutions", "Comma separated video and image sizes, defaults "
+                                         "to 640x360,1920x1080.", "sizes", "640x360,1920x1080");
+    QCommandLineOption durationsOption("durations", "Comma separated audio and video durations in seconds, "
+                                       "defaults to 5,30.", "seconds", "5,30");
+    QCommandLineOption formatsOption("formats", "Comma separated source formats, defaults to all.", "formats");
+    QCommandLineOption workOption("work-folder", "Folder for generated inputs, reused between runs. "
+                                  "Defaults to temporary folder.", "folder");
+    QCommandLineOption outputOption({"o", "output"}, "Write results to file instead of stdout.", "file");
+    QCommandLineOption jobsOption({"j", "jobs"}, "Concurrent jobs, defaults to 1. Cpu time and rss of "
+                                  "single pair are only reported with one job.", "count", "1");
+    QCommandLineOption engineOption("engine", "Conversion engine: process or libav.", "engine");
+    QCommandLineOption profileOption({"p", "profile"}, "Encoder profile, defaults to archive.", "profile");
+    QCommandLineOption segmentsOption("segments", "Encode videos longer than five minutes as this many "
+                                      "segments at the same time.", "count");
+    QCommandLineOption cpusOption("cpus", "Run encoders only on these cores, for example 0-3. Keeps "
+                                  "results comparable on a busy host.", "list");
+    parser.addOptions({resolutionsOption, durationsOption, formatsOption, workOption, outputOption, jobsOption,
+                       engineOption, profileOption, segmentsOption, cpusOption});
+
+    parser.process(a);
+
+    if (!DependencyChecker::isFFmpegAvailable()) {
+        std::fputs("FFmpeg is not installed or not found in your system PATH.\n", stderr);
+        return 3;
+    }
+
+    BenchOptions options;
+    options.resolutions = parser.value(resolutionsOption).split(',', Qt::SkipEmptyParts);
+    for (const QString& duration : parser.value(durationsOption).split(',', Qt::SkipEmptyParts)) {
+        if (duration.toInt() > 0) { options.durations.append(duration.toInt()); }
+    }
+    options.formats = parser.value(formatsOption).toLower().split(',', Qt::SkipEmptyParts);
+    options.workFolder = parser.value(workOption);
+    options.workers = parser.value(jobsOption).toInt();
+
+    if (options.resolutions.isEmpty() || options.durations.isEmpty()) {
+        std::fputs("Give at least one resolution and duration.\n", stderr);
+        return 2;
+    }
+
+    Engine engine = Engine::DEFAULT;
+    if (parser.isSet(engineOption)) {
+        const QString engineName = parser.value(engineOption);
+        if (engineName == "process") {
+            engine = Engine::PROCESS;
+        } else if (engineName == "libav") {
+            engine = Engine::LIBAV;
+        } else {
+            std::fputs("Engine must be process or libav.\n", stderr);
+            return 2;
+        }
+    }
+    if (!Converter::isEngineAvailable(engine)) {
+        std::fputs("This build doesn't include libav engine.\n", stderr);
+        return 3;
+    }
+
+    QList<int> cpus;
+    if (parser.isSet(cpusOption) && !ProcessPriorities::parseCpus(parser.value(cpusOption), &cpus)) {
+        std::fprintf(stderr, "Invalid cpu list %s.\n", qPrintable(parser.value(cpusOption)));
+        return 2;
+    }
+
+    // measured processes run at the priority of the benchmark itself
+    Converter c;
+    c.setDefaultEngine(engine);
+    c.setSegmentedEncoding(parser.value(segmentsOption).toInt());
+    c.setPriority(JobPriority::INTERACTIVE);
+    c.setCpuAffinity(cpus);
+    if (parser.isSet(profileOption)) {
+        if (!c.encoderProfiles().contains(parser.value(profileOption))) {
+            std::fprintf(stderr, "Unknown encoder profile %s.\n", qPrintable(parser.value(profileOption)));
+            return 2;
+        }
+        c.setProfile(parser.value(profileOption));
+    }
+
+    BenchRunner runner(&c);
+    QObject::connect(&runner, &BenchRunner::finished, &a, [&runner, &parser, &outputOption]() {
+        QByteArray report = QJsonDocument(runner.report()).toJson();
+
+        if (!parser.isSet(outputOption)) {
+            std::fwrite(report.constData(), 1, report.size(), stdout);
+            QCoreApplication::exit(0);
+            return;
+        }
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(report) != report.size()) {
+            std::fprintf(stderr, "Results can't be written to %s.\n", qPrintable(parser.value(outputOption)));
+            QCoreApplication::exit(1);
+            return;
+        }
+        QCoreApplication::exit(0);
+    });
+
+    if (!runner.start(options)) {
+        std::fputs("No input could be generated.\n", stderr);
+        return 1;
+    }
+
+    return QCoreApplication::exec();
+}
\ No newline at end of file
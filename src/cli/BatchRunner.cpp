@@ -0,0 +1,244 @@
+#include "BatchRunner.h"
+
+#include <cstdio>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include "../FormatRegistry.h"
+
+
+BatchRunner::BatchRunner(Converter* converter, QObject* parent)
+: QObject(parent), converter_(converter)
+{
+    connect(converter_, &Converter::jobStarted, this, [](int jobId) {
+        printEvent({{"event", "started"}, {"job", jobId}});
+    });
+
+    // only changed percents are printed
+    connect(converter_, &Converter::jobProgress, this, [this](int jobId, int percent) {
+        if (jobPercents_.value(jobId, -1) == percent) { return; }
+        jobPercents_.insert(jobId, percent);
+        printEvent({{"event", "progress"}, {"job", jobId}, {"percent", percent}});
+    });
+
+    // throughput of running ffmpeg, printed for every progress block
+    connect(converter_, &Converter::jobStats, this, [](int jobId, const FfmpegStats& stats) {
+        printEvent({{"event", "stats"},
+                    {"job", jobId},
+                    {"out_time_us", stats.outTimeUs},
+                    {"frame", stats.frame},
+                    {"fps", stats.fps},
+                    {"speed", stats.speed},
+                    {"total_size", stats.totalSize},
+                    {"end", stats.finished}});
+    });
+
+    // fan-out jobs also tell how far each of their outputs is
+    connect(converter_, &Converter::jobOutputProgress, this,
+        [this](int jobId, const QString& outputFilePath, int percent, qint64 bytes) {
+        if (outputPercents_.value(outputFilePath, -1) == percent) { return; }
+        outputPercents_.insert(outputFilePath, percent);
+        printEvent({{"event", "output_progress"},
+                    {"job", jobId},
+                    {"output", outputFilePath},
+                    {"percent", percent},
+                    {"bytes", bytes}});
+    });
+
+    connect(converter_, &Converter::jobFinished, this, [this](int jobId, bool success) {
+        if (success) {
+            succeededJobs_++;
+        } else {
+            failedJobs_++;
+        }
+        jobPercents_.remove(jobId);
+        printEvent({{"event", "finished"}, {"job", jobId}, {"success", success}});
+    });
+
+    connect(converter_, &Converter::allDone, this, [this]() {
+        printEvent({{"event", "done"},
+                    {"succeeded", succeededJobs_},
+                    {"failed", failedJobs_},
+                    {"rejected", rejectedJobs_}});
+
+        if (failedJobs_ > 0 || rejectedJobs_ > 0) {
+            exitCode_ = ExitCode::JOBS_FAILED;
+        }
+        emit finished();
+    });
+}
+
+bool BatchRunner::start(const BatchOptions& options)
+{
+    if (options.workers > 0) {
+        converter_->setMaxWorkers(options.workers);
+    }
+
+    FormatInfo targetFormat = {FileType::UNKNOWN};
+    const QStringList targetFormats = options.targetFormat.toLower().split(',', Qt::SkipEmptyParts);
+    if (!options.removeMetadata) {
+        for (const QString& format : targetFormats) {
+            targetFormat = FormatRegistry::fromSuffix(format);
+            if (targetFormat.fileType == FileType::UNKNOWN) {
+                printEvent({{"event", "error"}, {"reason", "Target format '" + format + "' is not supported"}});
+                exitCode_ = ExitCode::INVALID_ARGUMENTS;
+                return false;
+            }
+            if (targetFormats.size() > 1 && targetFormat.fileType != FileType::AUDIO) {
+                printEvent({{"event", "error"}, {"reason", "Only audio formats can be given together"}});
+                exitCode_ = ExitCode::INVALID_ARGUMENTS;
+                return false;
+            }
+        }
+        if (!options.renditions.isEmpty() && (targetFormats.size() != 1 || targetFormat.fileType != FileType::VIDEO)) {
+            printEvent({{"event", "error"}, {"reason", "Ladder needs one video target format"}});
+            exitCode_ = ExitCode::INVALID_ARGUMENTS;
+            return false;
+        }
+    }
+
+    int queuedJobs = 0;
+    for (const QString& inputFilePath : expandInputs(options.inputs)) {
+        FormatInfo inputFormat = FormatRegistry::detect(inputFilePath);
+        if (inputFormat.fileType == FileType::UNKNOWN) {
+            reject(inputFilePath, "Input file type isn't supported");
+            continue;
+        }
+
+        QString outputFilePath = this->outputFilePath(options, inputFilePath, targetFormats.value(0));
+        int jobId;
+
+        // every target of the input is encoded from one decode
+        if (targetFormats.size() > 1) {
+            if (inputFormat.fileType != FileType::AUDIO) {
+                reject(inputFilePath, "Can't convert between different file types");
+                continue;
+            }
+
+            QStringList outputFilePaths;
+            bool sameAsInput = false;
+            for (const QString& format : targetFormats) {
+                outputFilePaths << this->outputFilePath(options, inputFilePath, format);
+                sameAsInput |= QFileInfo(inputFilePath).absoluteFilePath()
+                               == QFileInfo(outputFilePaths.last()).absoluteFilePath();
+            }
+            if (sameAsInput) {
+                reject(inputFilePath, "Input file is already in one of the target formats");
+                continue;
+            }
+            jobId = converter_->runFanOut(inputFilePath, outputFilePaths, options.saveMetadata);
+
+            printEvent({{"event", "queued"},
+                        {"job", jobId},
+                        {"input", inputFilePath},
+                        {"outputs", QJsonArray::fromStringList(outputFilePaths)}});
+            queuedJobs++;
+            continue;
+        }
+
+        // all renditions of the input are scaled from one decode
+        if (!options.renditions.isEmpty() && !options.removeMetadata) {
+            if (inputFormat.fileType != FileType::VIDEO) {
+                reject(inputFilePath, "Can't convert between different file types");
+                continue;
+            }
+
+            QStringList outputFilePaths;
+            bool sameAsInput = false;
+            for (const Rendition& rendition : options.renditions) {
+                outputFilePaths << Converter::renditionFilePath(outputFilePath, rendition);
+                sameAsInput |= QFileInfo(inputFilePath).absoluteFilePath()
+                               == QFileInfo(outputFilePaths.last()).absoluteFilePath();
+            }
+            if (sameAsInput) {
+                reject(inputFilePath, "Input file is already one of the renditions");
+                continue;
+            }
+            jobId = converter_->runLadder(inputFilePath, outputFilePaths, options.renditions, options.saveMetadata);
+
+            printEvent({{"event", "queued"},
+                        {"job", jobId},
+                        {"input", inputFilePath},
+                        {"outputs", QJsonArray::fromStringList(outputFilePaths)}});
+            queuedJobs++;
+            continue;
+        }
+
+        if (options.removeMetadata) {
+            jobId = converter_->runMetadataRemover(inputFilePath, outputFilePath);
+        } else {
+            // same rules as in main window, only conversions inside same file type are allowed
+            if (inputFormat.fileType != targetFormat.fileType) {
+                reject(inputFilePath, "Can't convert between different file types");
+                continue;
+            }
+            if (QFileInfo(inputFilePath).absoluteFilePath() == QFileInfo(outputFilePath).absoluteFilePath()) {
+                reject(inputFilePath, "Input file is already in target format");
+                continue;
+            }
+            jobId = converter_->runConverter(inputFilePath, outputFilePath, options.saveMetadata);
+        }
+
+        printEvent({{"event", "queued"},
+                    {"job", jobId},
+                    {"input", inputFilePath},
+                    {"output", outputFilePath}});
+        queuedJobs++;
+    }
+
+    if (queuedJobs == 0) {
+        exitCode_ = rejectedJobs_ > 0 ? ExitCode::JOBS_FAILED : ExitCode::INVALID_ARGUMENTS;
+        printEvent({{"event", "done"}, {"succeeded", 0}, {"failed", 0}, {"rejected", rejectedJobs_}});
+        return false;
+    }
+
+    return true;
+}
+
+QStringList BatchRunner::expandInputs(const QStringList& inputs)
+{
+    QStringList filePaths;
+    for (const QString& input : inputs) {
+
+        // plain paths are passed as is and missing files are reported by converter
+        QFileInfo info(input);
+        if (!input.contains('*') && !input.contains('?') && !input.contains('[')) {
+            filePaths << input;
+            continue;
+        }
+
+        // glob is only expanded in its last path component (shells have expanded the rest)
+        QDir dir = info.dir();
+        const QStringList matches = dir.entryList({info.fileName()}, QDir::Files, QDir::Name);
+        for (const QString& match : matches) {
+            filePaths << dir.filePath(match);
+        }
+    }
+    return filePaths;
+}
+
+QString BatchRunner::outputFilePath(const BatchOptions& options, const QString& inputFilePath,
+                                   const QString& targetFormat) const
+{
+    QFileInfo info(inputFilePath);
+    QString folder = options.outputFolder.isEmpty() ? info.path() : options.outputFolder;
+    QString suffix = options.removeMetadata ? info.suffix() : targetFormat;
+
+    return QDir(folder).filePath(info.completeBaseName() + "." + suffix);
+}
+
+void BatchRunner::reject(const QString& inputFilePath, const QString& reason)
+{
+    rejectedJobs_++;
+    printEvent({{"event", "rejected"}, {"input", inputFilePath}, {"reason", reason}});
+}
+
+void BatchRunner::printEvent(const QJsonObject& event)
+{
+    QByteArray line = QJsonDocument(event).toJson(QJsonDocument::Compact) + '\n';
+    std::fwrite(line.constData(), 1, line.size(), stdout);
+    std::fflush(stdout);
+}
\ No newline at end of file
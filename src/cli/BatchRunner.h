@@ -0,0 +1,69 @@
+#ifndef FORMAT_CONVERTER_BATCHRUNNER_H
+#define FORMAT_CONVERTER_BATCHRUNNER_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QStringList>
+
+#include "../Converter.h"
+
+enum class ExitCode {
+    SUCCESS = 0,
+    JOBS_FAILED = 1,
+    INVALID_ARGUMENTS = 2,
+    MISSING_DEPENDENCY = 3
+};
+
+struct BatchOptions {
+    QStringList inputs;             // file paths or glob patterns
+    QString targetFormat;           // empty when removing metadata, comma separated audio formats fan out
+    QString outputFolder;           // empty means next to the input file
+    bool removeMetadata = false;
+    bool saveMetadata = false;
+    int workers = 0;                // 0 uses converter default
+    QList<Rendition> renditions;    // ladder of the single video target format, empty converts once
+};
+
+// runs batch of jobs trough Converter and prints progress as json lines to stdout
+class BatchRunner : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit BatchRunner(Converter* converter, QObject* parent = nullptr);
+    ~BatchRunner() = default;
+
+    // returns false if nothing could be queued. exit code is set in that case
+    bool start(const BatchOptions& options);
+
+    ExitCode exitCode() const { return exitCode_; }
+
+    static QStringList expandInputs(const QStringList& inputs);
+
+    // one json line to stdout
+    static void printEvent(const QJsonObject& event);
+
+private:
+
+    Converter* converter_;
+    ExitCode exitCode_ = ExitCode::SUCCESS;
+
+    int succeededJobs_ = 0;
+    int failedJobs_ = 0;
+    int rejectedJobs_ = 0;
+
+    // last reported percent per job so only changes are printed
+    QHash<int, int> jobPercents_;
+    QHash<QString, int> outputPercents_;
+
+    QString outputFilePath(const BatchOptions& options, const QString& inputFilePath,
+                           const QString& targetFormat) const;
+    void reject(const QString& inputFilePath, const QString& reason);
+
+signals:
+    void finished();
+};
+
+
+#endif //FORMAT_CONVERTER_BATCHRUNNER_H
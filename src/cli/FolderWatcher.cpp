@@ -0,0 +1,376 @@
+#include "FolderWatcher.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "../FormatRegistry.h"
+#include "BatchRunner.h"
+
+
+FolderWatcher::FolderWatcher(Converter* converter, QObject* parent)
+: QObject(parent), converter_(converter)
+{
+    connect(converter_, &Converter::jobFinished, this, &FolderWatcher::jobFinished);
+
+    // candidates are checked in rounds instead of timer per file so bursts stay cheap
+    settleTimer_.setInterval(500);
+    connect(&settleTimer_, &QTimer::timeout, this, &FolderWatcher::checkCandidates);
+}
+
+FolderWatcher::~FolderWatcher()
+{
+#ifdef Q_OS_LINUX
+    if (inotifyFd_ >= 0) {
+        ::close(inotifyFd_);
+    }
+#endif
+}
+
+bool FolderWatcher::loadRules(const QString& filePath, QString* errorMessage)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        *errorMessage = "Watch rules " + filePath + " can't be read: " + file.errorString();
+        return false;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (!document.isObject()) {
+        *errorMessage = "Watch rules " + filePath + " aren't valid: " + parseError.errorString();
+        return false;
+    }
+
+    QJsonObject root = document.object();
+    settleMs_ = qRound(root["settle-seconds"].toDouble(2.0) * 1000);
+
+    QList<WatchRule> rules;
+    for (const QJsonValue& value : root["folders"].toArray()) {
+        QJsonObject folder = value.toObject();
+
+        WatchRule rule;
+        rule.folder = QFileInfo(folder["path"].toString()).absoluteFilePath();
+        rule.targetFormat = folder["format"].toString().toLower();
+        rule.outputFolder = folder["output-folder"].toString();
+        rule.removeMetadata = folder["remove-metadata"].toBool();
+        rule.saveMetadata = folder["preserve-metadata"].toBool();
+        rule.priority = converter_->priority();
+        if (folder.contains("priority") && !jobPriorityFromString(folder["priority"].toString(), &rule.priority)) {
+            *errorMessage = "Priority of " + rule.folder + " must be interactive, normal or background";
+            return false;
+        }
+
+        if (!QFileInfo(rule.folder).isDir()) {
+            *errorMessage = "Watched folder " + rule.folder + " doesn't exist";
+            return false;
+        }
+        for (const WatchRule& it : std::as_const(rules)) {
+            if (it.folder == rule.folder) {
+                *errorMessage = "Folder " + rule.folder + " has more than one rule";
+                return false;
+            }
+        }
+        if (!rule.removeMetadata && FormatRegistry::fromSuffix(rule.targetFormat).fileType == FileType::UNKNOWN) {
+            *errorMessage = "Target format '" + rule.targetFormat + "' of " + rule.folder + " is not supported";
+            return false;
+        }
+        rules.append(rule);
+    }
+
+    if (rules.isEmpty()) {
+        *errorMessage = "Watch rules " + filePath + " have no folders";
+        return false;
+    }
+    rules_ = rules;
+    return true;
+}
+
+bool FolderWatcher::start(QString* errorMessage)
+{
+#ifdef Q_OS_LINUX
+    if (!watchInotify(errorMessage)) { return false; }
+#else
+    Q_UNUSED(errorMessage);
+    watchFallback();
+#endif
+
+    // files dropped before start are handled like new ones, unless they were converted by an
+    // earlier run
+    for (int rule = 0; rule < rules_.size(); rule++) {
+        scanFolder(rule, true);
+        BatchRunner::printEvent({{"event", "watching"}, {"folder", rules_[rule].folder}});
+    }
+    return true;
+}
+
+#ifdef Q_OS_LINUX
+bool FolderWatcher::watchInotify(QString* errorMessage)
+{
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd_ < 0) {
+        watchFallback();
+        return true;
+    }
+
+    // close_write and moved_to end most writes, modify keeps slow copies from settling
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY | IN_DELETE | IN_MOVED_FROM;
+    for (int rule = 0; rule < rules_.size(); rule++) {
+        int wd = inotify_add_watch(inotifyFd_, QFile::encodeName(rules_[rule].folder).constData(), mask);
+        if (wd < 0) {
+            *errorMessage = "Folder " + rules_[rule].folder + " can't be watched";
+            return false;
+        }
+        watchRules_.insert(wd, rule);
+    }
+
+    notifier_ = new QSocketNotifier(inotifyFd_, QSocketNotifier::Read, this);
+    connect(notifier_, &QSocketNotifier::activated, this, &FolderWatcher::readInotifyEvents);
+    return true;
+}
+
+void FolderWatcher::readInotifyEvents()
+{
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    // descriptor is non blocking so loop ends when queue is empty
+    for (;;) {
+        ssize_t length = ::read(inotifyFd_, buffer, sizeof(buffer));
+        if (length <= 0) { break; }
+
+        for (char* it = buffer; it < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(it);
+            it += sizeof(inotify_event) + event->len;
+
+            // events were lost, only time whole folders are listed again
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (int rule = 0; rule < rules_.size(); rule++) { scanFolder(rule, true); }
+                continue;
+            }
+
+            int rule = watchRules_.value(event->wd, -1);
+            if (rule < 0 || event->len == 0 || (event->mask & IN_ISDIR)) { continue; }
+
+            QString filePath = QDir(rules_[rule].folder).filePath(QFile::decodeName(event->name));
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                fileRemoved(filePath);
+            } else {
+                fileChanged(rule, filePath);
+            }
+        }
+    }
+}
+#endif
+
+void FolderWatcher::watchFallback()
+{
+    fallbackWatcher_ = new QFileSystemWatcher(this);
+    for (const WatchRule& rule : std::as_const(rules_)) {
+        fallbackWatcher_->addPath(rule.folder);
+    }
+
+    connect(fallbackWatcher_, &QFileSystemWatcher::directoryChanged, this, [this](const QString& folder) {
+        for (int rule = 0; rule < rules_.size(); rule++) {
+            if (QFileInfo(rules_[rule].folder) == QFileInfo(folder)) {
+                scanFolder(rule, false);
+                return;
+            }
+        }
+    });
+}
+
+void FolderWatcher::scanFolder(int rule, bool skipConverted)
+{
+    QDir folder(rules_[rule].folder);
+    const QStringList entries = folder.entryList(QDir::Files);
+    QSet<QString> current(entries.cbegin(), entries.cend());
+
+    // without inotify only names which weren't there before are new, growth of known files
+    // is noticed by settling
+    if (fallbackWatcher_) {
+        QSet<QString>& known = folderEntries_[folder.path()];
+        for (const QString& name : std::as_const(known)) {
+            if (!current.contains(name)) { fileRemoved(folder.filePath(name)); }
+        }
+        for (const QString& name : std::as_const(current)) {
+            if (known.contains(name)) { continue; }
+            if (skipConverted && isConverted(rules_[rule], folder.filePath(name))) { continue; }
+            fileChanged(rule, folder.filePath(name));
+        }
+        known = current;
+        return;
+    }
+
+    for (const QString& name : std::as_const(current)) {
+        if (skipConverted && isConverted(rules_[rule], folder.filePath(name))) { continue; }
+        fileChanged(rule, folder.filePath(name));
+    }
+}
+
+bool FolderWatcher::isConverted(const WatchRule& rule, const QString& inputFilePath) const
+{
+    QFileInfo input(inputFilePath);
+    QFileInfo output(outputFilePath(rule, inputFilePath));
+
+    // metadata removed in place leaves nothing to compare with
+    if (!output.isFile() || output.absoluteFilePath() == input.absoluteFilePath()) { return false; }
+    if (output.lastModified() < input.lastModified()) { return false; }
+
+    BatchRunner::printEvent({{"event", "skipped"},
+                             {"input", inputFilePath},
+                             {"output", output.filePath()},
+                             {"reason", "Output is newer than input"}});
+    return true;
+}
+
+void FolderWatcher::fileChanged(int rule, const QString& filePath)
+{
+    // hidden files are temporary files of copy tools and segmented encoding
+    if (QFileInfo(filePath).fileName().startsWith('.')) { return; }
+    if (busyFiles_.contains(filePath)) { return; }
+
+    Candidate& candidate = candidates_[filePath];
+    candidate.rule = rule;
+    candidate.changed.start();
+
+    if (!settleTimer_.isActive()) {
+        settleTimer_.start();
+    }
+}
+
+void FolderWatcher::fileRemoved(const QString& filePath)
+{
+    candidates_.remove(filePath);
+}
+
+void FolderWatcher::checkCandidates()
+{
+    QList<QPair<int, QString>> settled;
+    for (auto it = candidates_.begin(); it != candidates_.end();) {
+        if (it->changed.elapsed() < settleMs_) {
+            ++it;
+            continue;
+        }
+
+        QFileInfo info(it.key());
+        if (!info.isFile()) {
+            it = candidates_.erase(it);
+            continue;
+        }
+
+        // still changing, checked again after settle time
+        if (info.size() != it->size || info.lastModified() != it->modified) {
+            it->size = info.size();
+            it->modified = info.lastModified();
+            it->changed.start();
+            ++it;
+            continue;
+        }
+
+        // empty file is most likely a placeholder, writes to it make it a candidate again
+        if (info.size() > 0) {
+            settled.append({it->rule, it.key()});
+        }
+        it = candidates_.erase(it);
+    }
+
+    if (candidates_.isEmpty()) {
+        settleTimer_.stop();
+    }
+
+    for (const auto& [rule, filePath] : std::as_const(settled)) {
+        queue(rule, filePath);
+    }
+}
+
+void FolderWatcher::queue(int rule, const QString& filePath)
+{
+    const WatchRule& watchRule = rules_[rule];
+
+    // output of an earlier job in watched folder, unless it has been changed since
+    auto produced = producedFiles_.constFind(filePath);
+    if (produced != producedFiles_.constEnd()) {
+        QFileInfo info(filePath);
+        bool unchanged = produced->first == info.size() && produced->second == info.lastModified();
+        producedFiles_.erase(produced);
+        if (unchanged) { return; }
+    }
+
+    FormatInfo inputFormat = FormatRegistry::detect(filePath);
+    if (inputFormat.fileType == FileType::UNKNOWN) {
+        reject(filePath, "Input file type isn't supported");
+        return;
+    }
+
+    QString outputFilePath = this->outputFilePath(watchRule, filePath);
+
+    // same rules as in batch mode
+    if (!watchRule.removeMetadata) {
+        if (inputFormat.fileType != FormatRegistry::fromSuffix(watchRule.targetFormat).fileType) {
+            reject(filePath, "Can't convert between different file types");
+            return;
+        }
+        if (QFileInfo(filePath).absoluteFilePath() == QFileInfo(outputFilePath).absoluteFilePath()) {
+            reject(filePath, "Input file is already in target format");
+            return;
+        }
+    }
+
+    ConversionJob job;
+    job.type = watchRule.removeMetadata ? JobType::REMOVE_METADATA : JobType::CONVERT;
+    job.inputFilePath = filePath;
+    job.outputFilePath = outputFilePath;
+    job.saveMetadata = !watchRule.removeMetadata && watchRule.saveMetadata;
+    job.priority = watchRule.priority;
+    int jobId = converter_->runJob(job);
+
+    busyFiles_ << filePath << outputFilePath;
+    jobs_.insert(jobId, {filePath, outputFilePath});
+    BatchRunner::printEvent({{"event", "queued"},
+                             {"job", jobId},
+                             {"input", filePath},
+                             {"output", outputFilePath}});
+}
+
+void FolderWatcher::jobFinished(int jobId, bool success)
+{
+    if (!jobs_.contains(jobId)) { return; }
+    const JobFiles files = jobs_.take(jobId);
+    busyFiles_.remove(files.inputFilePath);
+    busyFiles_.remove(files.outputFilePath);
+
+    // events of output in a watched folder were ignored while job was running, output is made
+    // candidate here so it is settled once and then dropped as produced file
+    QFileInfo output(files.outputFilePath);
+    for (int rule = 0; success && rule < rules_.size(); rule++) {
+        if (QFileInfo(rules_[rule].folder) == QFileInfo(output.absolutePath())) {
+            producedFiles_.insert(files.outputFilePath, {output.size(), output.lastModified()});
+            fileChanged(rule, files.outputFilePath);
+            break;
+        }
+    }
+
+    BatchRunner::printEvent({{"event", "finished"}, {"job", jobId}, {"success", success}});
+}
+
+QString FolderWatcher::outputFilePath(const WatchRule& rule, const QString& inputFilePath) const
+{
+    QFileInfo info(inputFilePath);
+    QString folder = rule.outputFolder.isEmpty() ? info.path() : rule.outputFolder;
+    QString suffix = rule.removeMetadata ? info.suffix() : rule.targetFormat;
+
+    return QDir(folder).filePath(info.completeBaseName() + "." + suffix);
+}
+
+void FolderWatcher::reject(const QString& inputFilePath, const QString& reason)
+{
+    BatchRunner::printEvent({{"event", "rejected"}, {"input", inputFilePath}, {"reason", reason}});
+}
\ No newline at end of file
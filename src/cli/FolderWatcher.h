@@ -0,0 +1,102 @@
+#ifndef FORMAT_CONVERTER_FOLDERWATCHER_H
+#define FORMAT_CONVERTER_FOLDERWATCHER_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "../Converter.h"
+
+// what is done to files appearing in one watched folder
+struct WatchRule {
+    QString folder;
+    QString targetFormat;           // empty when removing metadata
+    QString outputFolder;           // empty means the watched folder
+    bool removeMetadata = false;
+    bool saveMetadata = false;
+    JobPriority priority = JobPriority::NORMAL;
+};
+
+// watches drop folders and queues every new file to converter once it has stopped changing.
+// on linux only the changed names come from inotify so folders are never rescanned (except
+// when the kernel queue overflows), elsewhere QFileSystemWatcher and folder listing are used.
+// events are printed as json lines like in batch mode
+class FolderWatcher : public QObject {
+    Q_OBJECT
+
+public:
+
+    explicit FolderWatcher(Converter* converter, QObject* parent = nullptr);
+    ~FolderWatcher() override;
+
+    // rules file: {"settle-seconds": 2, "folders": [{"path", "format", "output-folder",
+    // "preserve-metadata", "remove-metadata", "priority"}]}. priority defaults to the one of
+    // converter. returns false and sets error if it is invalid
+    bool loadRules(const QString& filePath, QString* errorMessage);
+
+    // existing files are queued too, except those whose output exists and isn't older than them.
+    // returns false if a folder can't be watched
+    bool start(QString* errorMessage);
+
+private:
+
+    // file is queued when its size and modification time stay same for settle time
+    struct Candidate {
+        int rule = 0;
+        qint64 size = -1;
+        QDateTime modified;
+        QElapsedTimer changed;
+    };
+
+    struct JobFiles {
+        QString inputFilePath;
+        QString outputFilePath;
+    };
+
+    Converter* converter_;
+    QList<WatchRule> rules_;
+    int settleMs_ = 2000;
+
+    QHash<QString, Candidate> candidates_;
+    QTimer settleTimer_;
+
+    // files of running jobs are ignored, outputs written to watched folders are remembered
+    // so they aren't queued again when their events arrive
+    QHash<int, JobFiles> jobs_;
+    QSet<QString> busyFiles_;
+    QHash<QString, QPair<qint64, QDateTime>> producedFiles_;
+
+#ifdef Q_OS_LINUX
+    int inotifyFd_ = -1;
+    QSocketNotifier* notifier_ = nullptr;
+    QHash<int, int> watchRules_;        // watch descriptor -> rule
+    bool watchInotify(QString* errorMessage);
+    void readInotifyEvents();
+#endif
+
+    // fallback keeps folder listings to find new names
+    QFileSystemWatcher* fallbackWatcher_ = nullptr;
+    QHash<QString, QSet<QString>> folderEntries_;
+    void watchFallback();
+
+    // listing finds files which appeared without events. skipConverted leaves out files whose
+    // output was written after them, used at start and after lost events
+    void scanFolder(int rule, bool skipConverted);
+    bool isConverted(const WatchRule& rule, const QString& inputFilePath) const;
+    void fileChanged(int rule, const QString& filePath);
+    void fileRemoved(const QString& filePath);
+    void checkCandidates();
+    void queue(int rule, const QString& filePath);
+    void jobFinished(int jobId, bool success);
+
+    QString outputFilePath(const WatchRule& rule, const QString& inputFilePath) const;
+    void reject(const QString& inputFilePath, const QString& reason);
+};
+
+
+#endif //FORMAT_CONVERTER_FOLDERWATCHER_H
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include <cstdio>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTimer>
+
+#include "../Converter.h"
+#include "../FormatRegistry.h"
+#include "../MetadataStripper.h"
+#include "../utils/DependencyChecker.h"
+#include "BatchRunner.h"
+#include "FolderWatcher.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("format-converter-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless batch mode of Format Converter. "
+                                     "Progress is printed to stdout as json lines.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("inputs", "Input files or glob patterns.", "<inputs...>");
+
+    QCommandLineOption formatOption({"f", "format"}, "Target format, for example mp4. Comma separated audio "
+                                    "formats (mp3,aac,flac) are encoded from one decode.", "format");
+    QCommandLineOption removeOption({"r", "remove-metadata"}, "Remove metadata instead of converting.");
+    QCommandLineOption preserveOption({"m", "preserve-metadata"}, "Preserve metadata when converting.");
+    QCommandLineOption outputOption({"o", "output-folder"}, "Output folder, defaults to input folder.", "folder");
+    QCommandLineOption jobsOption({"j", "jobs"}, "Concurrent jobs, defaults to core count.", "count");
+    QCommandLineOption verboseOption({"v", "verbose"}, "Print process logs to stderr.");
+    QCommandLineOption engineOption("engine", "Conversion engine: process or libav.", "engine");
+    QCommandLineOption profileOption({"p", "profile"}, "Encoder profile: archive, balanced, fast, realtime "
+                                     "or one from profile file. Defaults to archive.", "profile");
+    QCommandLineOption profilesFileOption("profiles-file", "Json file tuning encoder profiles, defaults to "
+                                          "profiles.json in config folder.", "file");
+    QCommandLineOption segmentsOption("segments", "Encode videos longer than five minutes as this many "
+                                      "segments at the same time.", "count");
+    QCommandLineOption cacheOption("cache-dir", "Keep outputs in this folder and link repeated conversions "
+                                   "from it.", "folder");
+    QCommandLineOption cacheSizeOption("cache-size", "Size limit of the cache in MB, defaults to 10240.", "mb",
+                                       "10240");
+    QCommandLineOption metricsOption("metrics-file", "Write job metrics to this file in Prometheus text "
+                                     "format every few seconds while jobs finish.", "file");
+    QCommandLineOption watchOption("watch", "Keep watching folders given in json rules file and convert "
+                                   "files dropped there.", "rules");
+    QCommandLineOption journalOption("journal", "Record job states to this file. Completed outputs are "
+                                     "skipped when run again, without inputs unfinished jobs are resumed.",
+                                     "file");
+    QCommandLineOption probeCacheOption("probe-cache", "Keep ffprobe results in this file so unchanged inputs "
+                                        "aren't probed again.", "file");
+    QCommandLineOption ladderOption("ladder", "Encode video input once to several heights, given as "
+                                    "height:kbps pairs, for example 1080:5000,720:2800,480:1400. Bitrate "
+                                    "can be left out to keep quality mode of the profile.", "renditions");
+    QCommandLineOption priorityOption("priority", "Job priority: interactive, normal or background. Queued "
+                                      "jobs are ordered by it and background encoders get lower cpu and io "
+                                      "priority. Defaults to normal.", "class", "normal");
+    QCommandLineOption cpusOption("cpus", "Run spawned processes only on these cores, for example 0-3,8.",
+                                  "list");
+    parser.addOptions({watchOption, formatOption, removeOption, preserveOption, outputOption, jobsOption, verboseOption,
+                       engineOption, profileOption, profilesFileOption, segmentsOption, cacheOption,
+                       cacheSizeOption, metricsOption, journalOption, probeCacheOption, ladderOption,
+                       priorityOption, cpusOption});
+
+    parser.process(a);
+
+    BatchOptions options;
+    options.inputs = parser.positionalArguments();
+    options.targetFormat = parser.value(formatOption);
+    options.outputFolder = parser.value(outputOption);
+    options.removeMetadata = parser.isSet(removeOption);
+    options.saveMetadata = parser.isSet(preserveOption);
+    options.workers = parser.value(jobsOption).toInt();
+
+    // renditions are height:kbps pairs, for example 720:2800 or only 720
+    const QStringList renditions = parser.value(ladderOption).split(',', Qt::SkipEmptyParts);
+    for (const QString& value : renditions) {
+        const QStringList parts = value.split(':');
+        Rendition rendition;
+        bool heightValid = false;
+        bool bitrateValid = true;
+        rendition.height = parts.value(0).toInt(&heightValid);
+        if (parts.size() > 1) {
+            rendition.bitrate = parts.value(1).toInt(&bitrateValid);
+        }
+        if (!heightValid || !bitrateValid || parts.size() > 2 || rendition.height < 2 || rendition.bitrate < 0) {
+            std::fprintf(stderr, "Invalid rendition %s, use height:kbps.\n", qPrintable(value));
+            return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+        }
+        options.renditions.append(rendition);
+    }
+
+    const bool watch = parser.isSet(watchOption);
+    const bool resume = parser.isSet(journalOption) && options.inputs.isEmpty() && !options.removeMetadata
+                        && options.targetFormat.isEmpty();
+    if (!watch && !resume
+        && (options.inputs.isEmpty() || options.removeMetadata == !options.targetFormat.isEmpty())) {
+        std::fputs("Give input files and either --format or --remove-metadata, --watch or --journal.\n", stderr);
+        return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+    }
+
+    // dont start program if ffmpeg isn't installed
+    if (!DependencyChecker::isFFmpegAvailable()) {
+        std::fputs("FFmpeg is not installed or not found in your system PATH.\n", stderr);
+        return static_cast<int>(ExitCode::MISSING_DEPENDENCY);
+    }
+
+    // exiftool is needed for metadata removal of files the native stripper can't parse, without it
+    // only image metadata isn't preserved
+    bool needsExifTool = false;
+    if (options.removeMetadata) {
+        for (const QString& inputFilePath : BatchRunner::expandInputs(options.inputs)) {
+            FormatInfo format = FormatRegistry::detect(inputFilePath);
+            needsExifTool = needsExifTool
+                            || (format.fileType != FileType::UNKNOWN && !MetadataStripper::canStrip(format));
+        }
+    }
+    if (needsExifTool && !DependencyChecker::isExifToolAvailable()) {
+        std::fputs("ExifTool is not installed or not found in your system PATH.\n", stderr);
+        return static_cast<int>(ExitCode::MISSING_DEPENDENCY);
+    }
+
+    Engine engine = Engine::DEFAULT;
+    if (parser.isSet(engineOption)) {
+        const QString engineName = parser.value(engineOption);
+        if (engineName == "process") {
+            engine = Engine::PROCESS;
+        } else if (engineName == "libav") {
+            engine = Engine::LIBAV;
+        } else {
+            std::fputs("Engine must be process or libav.\n", stderr);
+            return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+        }
+    }
+    if (!Converter::isEngineAvailable(engine)) {
+        std::fputs("This build doesn't include libav engine.\n", stderr);
+        return static_cast<int>(ExitCode::MISSING_DEPENDENCY);
+    }
+
+    JobPriority priority;
+    if (!jobPriorityFromString(parser.value(priorityOption), &priority)) {
+        std::fputs("Priority must be interactive, normal or background.\n", stderr);
+        return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+    }
+    QList<int> cpus;
+    if (parser.isSet(cpusOption) && !ProcessPriorities::parseCpus(parser.value(cpusOption), &cpus)) {
+        std::fprintf(stderr, "Invalid cpu list %s.\n", qPrintable(parser.value(cpusOption)));
+        return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+    }
+
+    Converter c;
+    c.setDefaultEngine(engine);
+    c.setSegmentedEncoding(parser.value(segmentsOption).toInt());
+    c.setPriority(priority);
+    c.setCpuAffinity(cpus);
+
+    qint64 cacheSize = parser.value(cacheSizeOption).toLongLong() * 1024 * 1024;
+    if (!c.setCache(parser.value(cacheOption), cacheSize)) {
+        std::fprintf(stderr, "Cache folder %s can't be created.\n", qPrintable(parser.value(cacheOption)));
+        return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+    }
+
+    QString probeCacheError;
+    if (!c.setProbeCache(parser.value(probeCacheOption), &probeCacheError)) {
+        std::fprintf(stderr, "%s\n", qPrintable(probeCacheError));
+        return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+    }
+
+    QString profileError;
+    bool profilesLoaded = parser.isSet(profilesFileOption)
+                          ? c.encoderProfiles().load(parser.value(profilesFileOption), &profileError)
+                          : c.encoderProfiles().loadDefaultFile(&profileError);
+    if (!profilesLoaded) {
+        std::fprintf(stderr, "%s\n", qPrintable(profileError));
+        return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+    }
+    if (parser.isSet(profileOption)) {
+        if (!c.encoderProfiles().contains(parser.value(profileOption))) {
+            std::fprintf(stderr, "Unknown encoder profile %s.\n", qPrintable(parser.value(profileOption)));
+            return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+        }
+        c.setProfile(parser.value(profileOption));
+    }
+    if (parser.isSet(verboseOption)) {
+        QObject::connect(&c, &Converter::jobLogMessage, [](int jobId, const QString& message) {
+            std::fprintf(stderr, "[%d] %s\n", jobId, qPrintable(message.trimmed()));
+        });
+    }
+
+    // textfile collector of node exporter picks the file up. file is rewritten at most every few
+    // seconds so short jobs don't cause a write each, and once more when all jobs are done
+    QTimer metricsTimer;
+    if (parser.isSet(metricsOption)) {
+        const QString metricsFilePath = parser.value(metricsOption);
+        const auto writeMetrics = [&c, &metricsTimer, metricsFilePath]() {
+            metricsTimer.stop();
+            QString metricsError;
+            if (!c.metrics().writeTextfile(metricsFilePath, &metricsError)) {
+                std::fprintf(stderr, "Metrics can't be written: %s\n", qPrintable(metricsError));
+            }
+        };
+        metricsTimer.setSingleShot(true);
+        metricsTimer.setInterval(5000);
+        QObject::connect(&metricsTimer, &QTimer::timeout, writeMetrics);
+        QObject::connect(&c, &Converter::jobFinished, [&metricsTimer]() {
+            if (!metricsTimer.isActive()) { metricsTimer.start(); }
+        });
+        QObject::connect(&c, &Converter::allDone, writeMetrics);
+    }
+
+    QString journalError;
+    if (!c.setJournal(parser.value(journalOption), &journalError)) {
+        std::fprintf(stderr, "%s\n", qPrintable(journalError));
+        return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+    }
+
+    // watch mode runs until it is killed
+    if (watch) {
+        if (options.workers > 0) {
+            c.setMaxWorkers(options.workers);
+        }
+        FolderWatcher watcher(&c);
+        QString watchError;
+        if (!watcher.loadRules(parser.value(watchOption), &watchError) || !watcher.start(&watchError)) {
+            std::fprintf(stderr, "%s\n", qPrintable(watchError));
+            return static_cast<int>(ExitCode::INVALID_ARGUMENTS);
+        }
+        return QCoreApplication::exec();
+    }
+
+    BatchRunner runner(&c);
+    QObject::connect(&runner, &BatchRunner::finished, &a, [&runner]() {
+        QCoreApplication::exit(static_cast<int>(runner.exitCode()));
+    });
+
+    // jobs left unfinished by an earlier run, their progress is printed like in batch
+    if (resume) {
+        if (options.workers > 0) {
+            c.setMaxWorkers(options.workers);
+        }
+        if (c.resumeJournal() == 0) {
+            BatchRunner::printEvent({{"event", "done"}, {"succeeded", 0}, {"failed", 0}, {"rejected", 0}});
+            return static_cast<int>(ExitCode::SUCCESS);
+        }
+        return QCoreApplication::exec();
+    }
+
+    if (!runner.start(options)) {
+        return static_cast<int>(runner.exitCode());
+    }
+
+    return QCoreApplication::exec();
+}
@@ -22,12 +22,20 @@ int main(int argc, char *argv[])
     if (!DependencyChecker::isExifToolAvailable()) {
         QMessageBox::warning(nullptr, "ExifTool Not Found",
                      "ExifTool is not installed or not found in your system PATH.\n"
-                     "Without ExifTool conversions can't save metadata.\n"
+                     "Without ExifTool image metadata can't be preserved, and metadata is only removed\n"
+                     "from JPEG, PNG, WebP, MP3, MP4, MOV and M4A files.\n"
                      "You can download it from: https://exiftool.org/install.html");
     }
 
     Converter c;
 
+    // profiles can be tuned with profiles.json in config folder
+    QString profileError;
+    if (!c.encoderProfiles().loadDefaultFile(&profileError)) {
+        QMessageBox::warning(nullptr, "Invalid Encoder Profiles",
+                             profileError + "\nBuilt-in encoder profiles are used.");
+    }
+
     MainWindow w(&c);
     w.show();
 
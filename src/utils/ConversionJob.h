@@ -0,0 +1,81 @@
+#ifndef FORMAT_CONVERTER_CONVERSIONJOB_H
+#define FORMAT_CONVERTER_CONVERSIONJOB_H
+
+#include <QString>
+#include <QStringList>
+
+#include "ProcessPriority.h"
+
+enum class JobType {
+    CONVERT,
+    REMOVE_METADATA,
+    FAN_OUT,            // one audio input encoded to several formats in the same ffmpeg run
+    LADDER              // one video input scaled to several renditions in the same ffmpeg run
+};
+
+// names used in job journal and metrics
+inline QString jobTypeToString(JobType type)
+{
+    switch (type) {
+        case JobType::REMOVE_METADATA:  return "remove_metadata";
+        case JobType::FAN_OUT:          return "fan_out";
+        case JobType::LADDER:           return "ladder";
+        default:                        return "convert";
+    }
+}
+
+inline JobType jobTypeFromString(const QString& name)
+{
+    if (name == "remove_metadata")  { return JobType::REMOVE_METADATA; }
+    if (name == "fan_out")          { return JobType::FAN_OUT; }
+    if (name == "ladder")           { return JobType::LADDER; }
+    return JobType::CONVERT;
+}
+
+// how ffmpeg conversions are run. default is chosen at build time (FORMAT_CONVERTER_LIBAV_DEFAULT)
+enum class Engine {
+    DEFAULT,
+    PROCESS,            // ffmpeg process per conversion
+    LIBAV               // libavformat/libavcodec linked into converter, runs in worker thread
+};
+
+enum class State {
+    QUEUED,             // waiting for free worker
+    RUNNING,            // some function is running
+    FFMPEG_RUNNING,     // while FFmpeg running in QProcess
+    EXIFTOOL_RUNNING,   // while ExifTool running in QProcess
+    LIBAV_RUNNING,      // while libav engine is converting in worker thread
+    IMAGE_RUNNING,      // while Qt image engine is converting in worker thread
+    STRIPPER_RUNNING,   // while metadata stripper is copying in worker thread
+    DONE,
+    FAILED
+};
+
+// one output of a ladder job
+struct Rendition {
+    int height = 0;         // width follows aspect ratio of input
+    int bitrate = 0;        // video kbit/s cap, 0 leaves quality mode of the profile alone
+};
+
+struct ConversionJob {
+    int id = 0;
+    JobType type = JobType::CONVERT;
+    QString inputFilePath;
+    QString outputFilePath;
+    QString finalOutputFilePath;    // running job writes to outputFilePath and it is renamed here on success
+    QStringList extraOutputFilePaths;       // outputs after the first one, written in the same run
+    QStringList finalExtraOutputFilePaths;  // renamed like finalOutputFilePath
+    QList<Rendition> renditions;            // LADDER, one for each output in the same order
+    bool saveMetadata = false;
+    Engine engine = Engine::DEFAULT;
+    QString profile;            // encoder profile name, see EncoderProfiles
+    JobPriority priority = JobPriority::NORMAL;
+
+    State state = State::QUEUED;
+    int percent = 0;
+
+    bool isFinished() const { return state == State::DONE || state == State::FAILED; }
+};
+
+
+#endif //FORMAT_CONVERTER_CONVERSIONJOB_H
@@ -5,20 +5,75 @@
 #include <QStringList>
 
 #include "CommonEnums.h"
+#include "EncoderSettings.h"
+#include "MediaInfo.h"
+
+namespace FFmpeg {
+
+    // common arguments for every ffmpeg run. progress is written to stdout as key=value blocks
+    // and only warnings and errors to stderr
+    inline QStringList progressArgs()
+    {
+        return {
+            "-hide_banner",
+            "-nostats",
+            "-loglevel", "level+warning",
+            "-progress", "pipe:1"
+        };
+    }
+}
 
 namespace FFmpeg::Converter {
 
-    inline QStringList audioArgs(const QString& inputFilePath,
-                                      const QString& outputFilePath,
-                                      int enumValue)
+    // streams which already fit to target container are copied instead of re-encoded. plan is
+    // made for the first stream of each type, so the same streams are mapped with mapArgs
+    struct StreamPlan {
+        bool copyVideo = false;
+        bool copyAudio = false;
+        bool copySubtitles = false;     // first subtitle stream, dropped when container can't take it
+        bool copyCover = false;         // attached picture of audio file
+    };
+
+    // without -map ffmpeg would choose streams by its own rules instead of those of the plan
+    inline QStringList videoMapArgs(StreamPlan plan)
+    {
+        QStringList args;
+        args << "-map" << "0:v:0?"
+             << "-map" << "0:a:0?";
+        if (plan.copySubtitles) {
+            args << "-map" << "0:s:0" << "-c:s" << "copy";
+        }
+        return args;
+    }
+
+    inline QStringList audioMapArgs(StreamPlan plan)
+    {
+        QStringList args;
+        args << "-map" << "0:a:0";
+        if (plan.copyCover) {
+            args << "-map" << "0:v:0" << "-c:v" << "copy" << "-disposition:v:0" << "attached_pic";
+        }
+        return args;
+    }
+
+    // settings of the profile which are used with every codec
+    inline QStringList threadArgs(const EncoderSettings& settings)
+    {
+        if (settings.threads <= 0) { return {}; }
+        return {"-threads", QString::number(settings.threads)};
+    }
+
+    inline QStringList audioCodecArgs(int enumValue, const EncoderSettings& settings)
     {
         QStringList args;
-        args << "-y" << "-i" << inputFilePath;
 
         switch (static_cast<AudioFormats>(enumValue)) {
             case AudioFormats::MP3:
-                args << "-c:a" << "libmp3lame"
-                     << "-q:a" << "0";
+                args << "-c:a" << "libmp3lame";
+                if (settings.quality >= 0) { args << "-q:a" << QString::number(settings.quality); }
+                if (settings.compressionLevel >= 0) {
+                    args << "-compression_level" << QString::number(settings.compressionLevel);
+                }
                 break;
             case AudioFormats::WAV:
                 args << "-c:a" << "pcm_s16le";
@@ -31,8 +86,8 @@ namespace FFmpeg::Converter {
                 args << "-c:a" << "flac";
                 break;
             case AudioFormats::OGG:
-                args << "-c:a" << "libvorbis"
-                     << "-q:a" << "6";
+                args << "-c:a" << "libvorbis";
+                if (settings.quality >= 0) { args << "-q:a" << QString::number(settings.quality); }
                 break;
             case AudioFormats::WMA:
                 args << "-c:a" << "wmav2";
@@ -46,72 +101,257 @@ namespace FFmpeg::Converter {
             default: break;
         }
 
-        args << outputFilePath;
         return args;
     }
 
-    inline QStringList videoArgs(const QString& inputFilePath,
-                                  const QString& outputFilePath,
-                                  int enumValue)
+    inline QStringList audioArgs(const QString& inputFilePath,
+                                      const QString& outputFilePath,
+                                      int enumValue,
+                                      const EncoderSettings& settings,
+                                      StreamPlan plan = {},
+                                      const QStringList& outputOptions = {})
+    {
+        QStringList args;
+        args << "-y" << "-i" << inputFilePath
+             << audioMapArgs(plan);
+
+        if (plan.copyAudio) {
+            args << "-c:a" << "copy";
+        } else {
+            args << audioCodecArgs(enumValue, settings) << threadArgs(settings);
+        }
+
+        args << outputOptions << outputFilePath;
+        return args;
+    }
+
+    // one output of a fan-out run. options are given just before its path so they apply only to it
+    struct FanOutput {
+        QString filePath;
+        int enumValue = 0;
+        EncoderSettings settings;
+        StreamPlan plan;
+        QStringList outputOptions;
+    };
+
+    // input is decoded once and each output encodes the same decoded audio with the codec
+    // audioArgs would give it
+    inline QStringList fanOutArgs(const QString& inputFilePath, const QList<FanOutput>& outputs)
     {
         QStringList args;
         args << "-y" << "-i" << inputFilePath;
 
+        for (const FanOutput& output : outputs) {
+            args << audioMapArgs(output.plan);
+            if (output.plan.copyAudio) {
+                args << "-c:a" << "copy";
+            } else {
+                args << audioCodecArgs(output.enumValue, output.settings) << threadArgs(output.settings);
+            }
+            args << output.outputOptions << output.filePath;
+        }
+        return args;
+    }
+
+    inline QStringList videoCodecArgs(int enumValue, const EncoderSettings& settings)
+    {
+        QStringList args;
+
         switch (enumValue) {
             case static_cast<int>(VideoFormats::MP4):
             case static_cast<int>(VideoFormats::M4V):
-                args << "-c:v" << "libx264"
-                     << "-preset" << "slow"
-                     << "-crf" << "18"
-                     << "-c:a" << "aac"
-                     << "-b:a" << "192k";
-                break;
-            case static_cast<int>(VideoFormats::AVI):
-                args << "-c:v" << "mpeg4"
-                     << "-q:v" << "2"
-                     << "-c:a" << "libmp3lame";
-                break;
             case static_cast<int>(VideoFormats::MKV):
-                args << "-c:v" << "libx264"
-                     << "-preset" << "slow"
-                     << "-crf" << "18"
-                     << "-c:a" << "aac";
-                break;
             case static_cast<int>(VideoFormats::MOV):
-                args << "-c:v" << "libx264"
-                     << "-preset" << "slow"
-                     << "-crf" << "18"
-                     << "-c:a" << "aac";
+                args << "-c:v" << "libx264";
+                if (!settings.preset.isEmpty()) { args << "-preset" << settings.preset; }
+                if (settings.crf >= 0) { args << "-crf" << QString::number(settings.crf); }
+                break;
+            case static_cast<int>(VideoFormats::AVI):
+                args << "-c:v" << "mpeg4";
+                if (settings.quality >= 0) { args << "-q:v" << QString::number(settings.quality); }
                 break;
             case static_cast<int>(VideoFormats::WMV):
-                args << "-c:v" << "wmv2"
-                     << "-c:a" << "wmav2";
+                args << "-c:v" << "wmv2";
                 break;
             case static_cast<int>(VideoFormats::FLV):
-                args << "-c:v" << "flv1"
-                     << "-c:a" << "libmp3lame";
+                args << "-c:v" << "flv1";
                 break;
             case static_cast<int>(VideoFormats::WEBM):
+                // constant quality mode needs zero bitrate
                 args << "-c:v" << "libvpx-vp9"
-                     << "-b:v" << "0"
-                     << "-crf" << "30"
-                     << "-c:a" << "libopus";
+                     << "-b:v" << "0";
+                if (settings.crf >= 0) { args << "-crf" << QString::number(settings.crf); }
+                if (!settings.deadline.isEmpty()) { args << "-deadline" << settings.deadline; }
+                if (settings.cpuUsed >= 0) { args << "-cpu-used" << QString::number(settings.cpuUsed); }
+                if (settings.rowMt) { args << "-row-mt" << "1"; }
                 break;
             case static_cast<int>(VideoFormats::MPEG):
-                args << "-c:v" << "mpeg2video"
-                     << "-q:v" << "2"
-                     << "-c:a" << "mp2";
+                args << "-c:v" << "mpeg2video";
+                if (settings.quality >= 0) { args << "-q:v" << QString::number(settings.quality); }
                 break;
             default: break;
         }
 
-        args << outputFilePath;
+        return args;
+    }
+
+    // audio codec used inside video containers
+    inline QStringList videoAudioCodecArgs(int enumValue)
+    {
+        QStringList args;
+
+        switch (enumValue) {
+            case static_cast<int>(VideoFormats::MP4):
+            case static_cast<int>(VideoFormats::M4V):
+                args << "-c:a" << "aac"
+                     << "-b:a" << "192k";
+                break;
+            case static_cast<int>(VideoFormats::MKV):
+            case static_cast<int>(VideoFormats::MOV):
+                args << "-c:a" << "aac";
+                break;
+            case static_cast<int>(VideoFormats::AVI):
+            case static_cast<int>(VideoFormats::FLV):
+                args << "-c:a" << "libmp3lame";
+                break;
+            case static_cast<int>(VideoFormats::WMV):
+                args << "-c:a" << "wmav2";
+                break;
+            case static_cast<int>(VideoFormats::WEBM):
+                args << "-c:a" << "libopus";
+                break;
+            case static_cast<int>(VideoFormats::MPEG):
+                args << "-c:a" << "mp2";
+                break;
+            default: break;
+        }
+
+        return args;
+    }
+
+    inline QStringList videoArgs(const QString& inputFilePath,
+                                  const QString& outputFilePath,
+                                  int enumValue,
+                                  const EncoderSettings& settings,
+                                  StreamPlan plan = {},
+                                  const QStringList& outputOptions = {})
+    {
+        QStringList args;
+        args << "-y" << "-i" << inputFilePath
+             << videoMapArgs(plan);
+
+        if (plan.copyVideo) {
+            args << "-c:v" << "copy";
+        } else {
+            args << videoCodecArgs(enumValue, settings);
+        }
+
+        if (plan.copyAudio) {
+            args << "-c:a" << "copy";
+        } else {
+            args << videoAudioCodecArgs(enumValue);
+        }
+
+        if (!plan.copyVideo || !plan.copyAudio) {
+            args << threadArgs(settings);
+        }
+
+        args << outputOptions << outputFilePath;
+        return args;
+    }
+
+    // one output of a ladder run, options are given just before its path like in fan-out
+    struct LadderOutput {
+        QString filePath;
+        int height = 0;
+        int bitrate = 0;            // kbit/s, 0 keeps quality mode of the codec
+        bool copyAudio = false;
+        QStringList outputOptions;
+    };
+
+    // input is decoded once and split, each branch is scaled to its height and encoded to its
+    // own output. inputs smaller than a rendition aren't upscaled
+    inline QStringList ladderArgs(const QString& inputFilePath,
+                                  int enumValue,
+                                  const EncoderSettings& settings,
+                                  const QList<LadderOutput>& outputs,
+                                  bool hasAudio)
+    {
+        QString graph = QString("[0:v:0]split=%1").arg(outputs.size());
+        for (int i = 0; i < outputs.size(); i++) {
+            graph += QString("[s%1]").arg(i);
+        }
+        for (int i = 0; i < outputs.size(); i++) {
+            graph += QString(";[s%1]scale=-2:trunc(min(%2\\,ih)/2)*2[v%1]").arg(i).arg(outputs[i].height);
+        }
+
+        QStringList args;
+        args << "-y" << "-i" << inputFilePath
+             << "-filter_complex" << graph;
+
+        for (int i = 0; i < outputs.size(); i++) {
+            const LadderOutput& output = outputs[i];
+            args << "-map" << QString("[v%1]").arg(i);
+
+            // bitrate caps quality mode (crf) instead of replacing it, vp9 takes it as its target
+            QStringList codecArgs = videoCodecArgs(enumValue, settings);
+            if (output.bitrate > 0) {
+                int bitrateIndex = codecArgs.indexOf("-b:v");
+                if (bitrateIndex >= 0) {
+                    codecArgs[bitrateIndex + 1] = QString("%1k").arg(output.bitrate);
+                }
+                codecArgs << "-maxrate" << QString("%1k").arg(output.bitrate)
+                          << "-bufsize" << QString("%1k").arg(output.bitrate * 2);
+            }
+            args << codecArgs;
+
+            if (hasAudio) {
+                args << "-map" << "0:a:0";
+                if (output.copyAudio) {
+                    args << "-c:a" << "copy";
+                } else {
+                    args << videoAudioCodecArgs(enumValue);
+                }
+            }
+
+            args << threadArgs(settings) << output.outputOptions << output.filePath;
+        }
+        return args;
+    }
+
+    // global tags, chapters and stream tags are carried by ffmpeg while encoding audio and video
+    inline QStringList metadataArgs(FormatInfo format, const MediaInfo& info)
+    {
+        QStringList args;
+        args << "-map_metadata" << "0"
+             << "-map_chapters" << "0";
+
+        // stream specifier of input is fatal error if input doesn't have such stream
+        if (info.firstStream("video")) {
+            args << "-map_metadata:s:v" << "0:s:v";
+        }
+        if (info.firstStream("audio")) {
+            args << "-map_metadata:s:a" << "0:s:a";
+        }
+
+        // mp4 family muxer drops tags it doesn't know without this
+        bool quickTime = format.fileType == FileType::VIDEO
+                         && (format.enumValue == static_cast<int>(VideoFormats::MP4)
+                             || format.enumValue == static_cast<int>(VideoFormats::M4V)
+                             || format.enumValue == static_cast<int>(VideoFormats::MOV));
+        bool m4a = format.fileType == FileType::AUDIO
+                   && format.enumValue == static_cast<int>(AudioFormats::ALAC_M4A);
+        if (quickTime || m4a) {
+            args << "-movflags" << "use_metadata_tags";
+        }
+
         return args;
     }
 
     inline QStringList imageArgs(const QString& inputFilePath,
                                  const QString& outputFilePath,
-                                 int enumValue)
+                                 int enumValue,
+                                 const EncoderSettings& settings)
     {
         QStringList args;
         args << "-y" << "-i" << inputFilePath
@@ -120,28 +360,254 @@ namespace FFmpeg::Converter {
 
         switch (enumValue) {
             case static_cast<int>(ImageFormats::JPEG):
-                args << "-q:v" << "1";
+                if (settings.quality >= 0) { args << "-q:v" << QString::number(settings.quality); }
                 break;
             case static_cast<int>(ImageFormats::GIF):
                 args << "-f" << "gif";
                 break;
             case static_cast<int>(ImageFormats::HEIF):
-                args << "-c:v" << "libx265"
-                     << "-x265-params" << "lossless=1"
-                     << "-pix_fmt" << "yuv420p"
+                args << "-c:v" << "libx265";
+                if (settings.lossless) {
+                    args << "-x265-params" << "lossless=1";
+                } else {
+                    if (!settings.preset.isEmpty()) { args << "-preset" << settings.preset; }
+                    if (settings.crf >= 0) { args << "-crf" << QString::number(settings.crf); }
+                }
+                args << "-pix_fmt" << "yuv420p"
                      << "-tag:v" << "hvc1"
                      << "-f" << "heif";
                 break;
             case static_cast<int>(ImageFormats::WEBP):
-                args << "-c:v" << "libwebp"
-                     << "-lossless" << "1";
+                args << "-c:v" << "libwebp";
+                if (settings.lossless) {
+                    args << "-lossless" << "1";
+                } else if (settings.quality >= 0) {
+                    args << "-quality" << QString::number(settings.quality);
+                }
+                if (settings.compressionLevel >= 0) {
+                    args << "-compression_level" << QString::number(settings.compressionLevel);
+                }
                 break;
             default: break;
         }
 
+        args << threadArgs(settings) << outputFilePath;
+        return args;
+    }
+}
+
+namespace FFmpeg::Segmented {
+
+    // video is cut without re-encoding. segment muxer cuts only at keyframes so every
+    // segment can be decoded alone. segment names are listed to listPath
+    inline QStringList splitArgs(const QString& inputFilePath,
+                                 const QString& listPath,
+                                 const QString& segmentPattern,
+                                 double segmentTime)
+    {
+        return {
+            "-y", "-i", inputFilePath,
+            "-map", "0:v:0",
+            "-c", "copy",
+            "-f", "segment",
+            "-segment_time", QString::number(segmentTime, 'f', 3),
+            "-segment_list", listPath,
+            "-segment_list_type", "flat",
+            "-reset_timestamps", "1",
+            segmentPattern
+        };
+    }
+
+    // same video settings as videoArgs uses for whole file
+    inline QStringList segmentArgs(const QString& segmentPath,
+                                   const QString& outputFilePath,
+                                   int enumValue,
+                                   const EncoderSettings& settings)
+    {
+        QStringList args;
+        args << "-y" << "-i" << segmentPath
+             << FFmpeg::Converter::videoCodecArgs(enumValue, settings)
+             << FFmpeg::Converter::threadArgs(settings)
+             << "-an" << "-sn"
+             << outputFilePath;
+        return args;
+    }
+
+    // audio is encoded once for the whole file so there are no gaps between segments
+    inline QStringList audioArgs(const QString& inputFilePath,
+                                 const QString& outputFilePath,
+                                 int enumValue,
+                                 FFmpeg::Converter::StreamPlan plan)
+    {
+        QStringList args;
+        args << "-y" << "-i" << inputFilePath
+             << "-map" << "0:a:0"
+             << "-vn" << "-sn";
+
+        if (plan.copyAudio) {
+            args << "-c:a" << "copy";
+        } else {
+            args << FFmpeg::Converter::videoAudioCodecArgs(enumValue);
+        }
+
         args << outputFilePath;
         return args;
     }
+
+    // original input is kept as first input so metadataArgs (which read input 0) work as they are
+    inline QStringList concatArgs(const QString& inputFilePath,
+                                  const QString& listPath,
+                                  const QString& audioPath,
+                                  const QString& outputFilePath,
+                                  const QStringList& outputOptions = {})
+    {
+        QStringList args;
+        args << "-y" << "-i" << inputFilePath
+             << "-f" << "concat" << "-safe" << "0" << "-i" << listPath;
+        if (!audioPath.isEmpty()) {
+            args << "-i" << audioPath;
+        }
+
+        args << "-map" << "1:v:0";
+        if (!audioPath.isEmpty()) {
+            args << "-map" << "2:a:0";
+        }
+
+        args << "-c" << "copy"
+             << outputOptions << outputFilePath;
+        return args;
+    }
+}
+
+namespace FFmpeg::StreamCopy {
+
+    // codecs that target containers accept as they are
+    inline QStringList videoCodecs(VideoFormats format)
+    {
+        switch (format) {
+            case VideoFormats::MP4:     return {"h264", "hevc", "mpeg4", "av1"};
+            case VideoFormats::M4V:     return {"h264", "mpeg4"};
+            case VideoFormats::MOV:     return {"h264", "hevc", "mpeg4", "prores", "mjpeg"};
+            case VideoFormats::MKV:     return {"h264", "hevc", "vp8", "vp9", "av1", "mpeg4",
+                                                "mpeg2video", "theora"};
+            case VideoFormats::WEBM:    return {"vp8", "vp9", "av1"};
+            case VideoFormats::AVI:     return {"mpeg4", "mjpeg"};
+            case VideoFormats::FLV:     return {"flv1", "h264"};
+            case VideoFormats::WMV:     return {"wmv1", "wmv2"};
+            case VideoFormats::MPEG:    return {"mpeg1video", "mpeg2video"};
+            default:                    return {};
+        }
+    }
+
+    inline QStringList videoAudioCodecs(VideoFormats format)
+    {
+        switch (format) {
+            case VideoFormats::MP4:
+            case VideoFormats::M4V:     return {"aac", "mp3", "ac3"};
+            case VideoFormats::MOV:     return {"aac", "mp3", "alac", "ac3", "pcm_s16le", "pcm_s16be"};
+            case VideoFormats::MKV:     return {"aac", "mp3", "opus", "vorbis", "flac", "ac3", "eac3",
+                                                "dts", "mp2", "alac", "pcm_s16le"};
+            case VideoFormats::WEBM:    return {"opus", "vorbis"};
+            case VideoFormats::AVI:     return {"mp3", "ac3", "mp2", "pcm_s16le"};
+            case VideoFormats::FLV:     return {"mp3", "aac"};
+            case VideoFormats::WMV:     return {"wmav1", "wmav2"};
+            case VideoFormats::MPEG:    return {"mp2", "mp3", "ac3"};
+            default:                    return {};
+        }
+    }
+
+    inline QStringList audioCodecs(AudioFormats format)
+    {
+        switch (format) {
+            case AudioFormats::MP3:         return {"mp3"};
+            case AudioFormats::WAV:         return {"pcm_s16le"};
+            case AudioFormats::AAC:         return {"aac"};
+            case AudioFormats::FLAC:        return {"flac"};
+            case AudioFormats::OGG:         return {"vorbis", "opus"};
+            case AudioFormats::WMA:         return {"wmav1", "wmav2"};
+            case AudioFormats::ALAC_M4A:    return {"alac", "aac"};
+            case AudioFormats::AIFF:        return {"pcm_s16be"};
+            default:                        return {};
+        }
+    }
+
+    inline QStringList subtitleCodecs(VideoFormats format)
+    {
+        switch (format) {
+            case VideoFormats::MP4:
+            case VideoFormats::M4V:
+            case VideoFormats::MOV:     return {"mov_text"};
+            case VideoFormats::MKV:     return {"subrip", "ass", "ssa", "webvtt", "hdmv_pgs_subtitle",
+                                                "dvd_subtitle"};
+            case VideoFormats::WEBM:    return {"webvtt"};
+            default:                    return {};
+        }
+    }
+
+    // attached pictures are kept only by muxers which write them as cover tags
+    inline QStringList coverCodecs(AudioFormats format)
+    {
+        switch (format) {
+            case AudioFormats::MP3:
+            case AudioFormats::FLAC:
+            case AudioFormats::ALAC_M4A:    return {"mjpeg", "png"};
+            default:                        return {};
+        }
+    }
+
+    // missing stream fits anything, invalid probe never fits
+    inline bool fits(const MediaInfo& info, const QString& codecType, const QStringList& codecs)
+    {
+        if (!info.valid) { return false; }
+        const StreamInfo* stream = info.firstStream(codecType);
+        return !stream || codecs.contains(stream->codecName);
+    }
+
+    inline FFmpeg::Converter::StreamPlan streamPlan(FormatInfo format, const MediaInfo& info)
+    {
+        FFmpeg::Converter::StreamPlan plan;
+
+        switch (format.fileType) {
+            case FileType::VIDEO: {
+                auto videoFormat = static_cast<VideoFormats>(format.enumValue);
+                plan.copyVideo = info.firstStream("video") && fits(info, "video", videoCodecs(videoFormat));
+                plan.copyAudio = fits(info, "audio", videoAudioCodecs(videoFormat));
+                plan.copySubtitles = info.firstStream("subtitle")
+                                     && fits(info, "subtitle", subtitleCodecs(videoFormat));
+                break;
+            }
+            case FileType::AUDIO: {
+                auto audioFormat = static_cast<AudioFormats>(format.enumValue);
+                plan.copyAudio = info.firstStream("audio") && fits(info, "audio", audioCodecs(audioFormat));
+                plan.copyCover = info.firstStream("video") && fits(info, "video", coverCodecs(audioFormat));
+                break;
+            }
+
+            case FileType::IMAGE:
+            case FileType::UNKNOWN:
+                break;
+        }
+
+        return plan;
+    }
+
+    inline QString describe(FFmpeg::Converter::StreamPlan plan, FileType type)
+    {
+        if (type == FileType::AUDIO) {
+            return plan.copyAudio ? "Stream copy: audio fits target container, copying without re-encoding"
+                                  : "Re-encoding audio";
+        }
+        if (plan.copyVideo && plan.copyAudio) {
+            return "Stream copy: all streams fit target container, remuxing without re-encoding";
+        }
+        if (plan.copyVideo) {
+            return "Stream copy: copying video, re-encoding audio";
+        }
+        if (plan.copyAudio) {
+            return "Stream copy: re-encoding video, copying audio";
+        }
+        return "Re-encoding all streams";
+    }
 }
 
 namespace FFmpeg::RemoveMetadata {
@@ -160,7 +626,7 @@ namespace FFmpeg::RemoveMetadata {
     inline QStringList mkvArgs(const QString& inputFilePath, const QString& outputFilePath)
     {
         return {
-            "-i", "-y",
+            "-y", "-i",
             inputFilePath,
             "-map", "0",
             "-map_metadata", "-1",
@@ -171,59 +637,65 @@ namespace FFmpeg::RemoveMetadata {
 }
 
 namespace FFprobe {
-    inline QStringList fragmentedArgs (const QString& filePath)
+    inline QStringList streamArgs(const QString& filePath)
     {
-        QStringList args;
-        args << "-v" << "error"
-         << "-show_entries" << "moof"
-         << "-of" << "default=nw=1"
-         << filePath;
-
-        return args;
+        return {
+            "-v", "error",
+            "-show_format",
+            "-show_streams",
+            "-of", "json",
+            filePath
+        };
     }
 }
 
 namespace ExifTool::RemoveMetadata {
 
+    // when output differs from input exiftool writes the cleaned file straight to output (-o)
+    // so original doesn't have to be copied first. -o doesn't replace existing files.
+    inline QStringList targetArgs(const QString& inputFilePath, const QString& outputFilePath)
+    {
+        if (inputFilePath == outputFilePath) {
+            return {"-overwrite_original", inputFilePath};
+        }
+        return {"-o", outputFilePath, inputFilePath};
+    }
+
     // images
     // legacyVideos (AVI, FLV, WMV)
     // standard audio (FLAC, OGG, ACC, WMA, AIFF, ?WAV?)
-    inline QStringList standardArgs (const QString& filePath)
+    inline QStringList standardArgs (const QString& inputFilePath, const QString& outputFilePath)
     {
-        return {
-            "-all=",
-            "-overwrite_original",
-            filePath
-        };
+        return QStringList{
+            "-all="
+        } + targetArgs(inputFilePath, outputFilePath);
     }
 
     // videos MP4, MOV, M4V
     // audio ALAC, M4A
-    inline QStringList quickTimeArgs(const QString& filePath)
+    inline QStringList quickTimeArgs(const QString& inputFilePath, const QString& outputFilePath)
     {
-        return {
+        return QStringList{
             "-all=",
             "-XMP:all=",
             "-QuickTime:all=",
             "-UserData:all=",
-            "-Keys:all=",
-            "-overwrite_original",
-            filePath
-        };
+            "-Keys:all="
+        } + targetArgs(inputFilePath, outputFilePath);
     }
 
-    inline QStringList audioArgs(const QString& filePath, int enumValue)
+    inline QStringList audioArgs(const QString& inputFilePath, const QString& outputFilePath, int enumValue)
     {
         switch (static_cast<AudioFormats>(enumValue)) {
             case AudioFormats::ALAC_M4A:
-                return quickTimeArgs(filePath);
+                return quickTimeArgs(inputFilePath, outputFilePath);
 
             case AudioFormats::AAC:
             case AudioFormats::AIFF:
             case AudioFormats::FLAC:
             case AudioFormats::OGG:
             case AudioFormats::WMA:
-                return standardArgs(filePath);
+                return standardArgs(inputFilePath, outputFilePath);
 
             // ExifTool doesn't support MP3, WAV
             case AudioFormats::MP3:
@@ -233,23 +705,23 @@ namespace ExifTool::RemoveMetadata {
         }
     }
 
-    inline QStringList imageArgs(QString filePath, int enumValue)
+    inline QStringList imageArgs(const QString& inputFilePath, const QString& outputFilePath, int enumValue)
     {
-        return standardArgs(filePath);
+        return standardArgs(inputFilePath, outputFilePath);
     }
 
-    inline QStringList videoArgs(QString filePath, int enumValue)
+    inline QStringList videoArgs(const QString& inputFilePath, const QString& outputFilePath, int enumValue)
     {
         switch (static_cast<VideoFormats>(enumValue)) {
             case VideoFormats::MP4:
             case VideoFormats::MOV:
             case VideoFormats::M4V:
-                return quickTimeArgs(filePath);
+                return quickTimeArgs(inputFilePath, outputFilePath);
 
             case VideoFormats::AVI:
             case VideoFormats::FLV:
             case VideoFormats::WMV:
-                return standardArgs(filePath);
+                return standardArgs(inputFilePath, outputFilePath);
 
             // Exiftool doesn't support WEBM MPEG or MKV
             case VideoFormats::WEBM:
@@ -277,20 +749,25 @@ namespace ExifTool::CopyMetadata {
 namespace Arguments {
     inline QStringList converter(const QString& inputFilePath,
                                  const QString& outputFilePath,
-                                 FormatInfo format)
+                                 FormatInfo format,
+                                 const EncoderSettings& settings,
+                                 FFmpeg::Converter::StreamPlan plan = {},
+                                 const QStringList& outputOptions = {})
     {
         QStringList args;
         switch (format.fileType) {
             case FileType::AUDIO:
-                args = FFmpeg::Converter::audioArgs(inputFilePath, outputFilePath, format.enumValue);
+                args = FFmpeg::Converter::audioArgs(inputFilePath, outputFilePath, format.enumValue,
+                                                    settings, plan, outputOptions);
                 break;
 
             case FileType::VIDEO:
-                args = FFmpeg::Converter::videoArgs(inputFilePath, outputFilePath, format.enumValue);
+                args = FFmpeg::Converter::videoArgs(inputFilePath, outputFilePath, format.enumValue,
+                                                    settings, plan, outputOptions);
                 break;
 
             case FileType::IMAGE:
-                args = FFmpeg::Converter::imageArgs(inputFilePath, outputFilePath, format.enumValue);
+                args = FFmpeg::Converter::imageArgs(inputFilePath, outputFilePath, format.enumValue, settings);
                 break;
 
             case FileType::UNKNOWN:
@@ -301,22 +778,23 @@ namespace Arguments {
         return args;
     }
 
-    inline QStringList metadataRemoval(const QString& filePath,
+    inline QStringList metadataRemoval(const QString& inputFilePath,
+                                const QString& outputFilePath,
                                 FormatInfo format)
     {
         QStringList args;
 
         switch (format.fileType) {
             case FileType::AUDIO:
-                args = ExifTool::RemoveMetadata::audioArgs(filePath, format.enumValue);
+                args = ExifTool::RemoveMetadata::audioArgs(inputFilePath, outputFilePath, format.enumValue);
                 break;
 
             case FileType::IMAGE:
-                args = ExifTool::RemoveMetadata::imageArgs(filePath, format.enumValue);
+                args = ExifTool::RemoveMetadata::imageArgs(inputFilePath, outputFilePath, format.enumValue);
                 break;
 
             case FileType::VIDEO:
-                args = ExifTool::RemoveMetadata::videoArgs(filePath, format.enumValue);
+                args = ExifTool::RemoveMetadata::videoArgs(inputFilePath, outputFilePath, format.enumValue);
                 break;
 
             case FileType::UNKNOWN:
@@ -2,6 +2,9 @@
 #define FORMAT_CONVERTER_DEPENDENCYCHECKER_H
 #include <cstdlib>
 
+#include <QProcess>
+#include <QString>
+
 class DependencyChecker {
 public:
 
@@ -19,8 +22,23 @@ public:
         return available;
     }
 
+    // first line of ffmpeg -version, empty if ffmpeg can't be run
+    static QString ffmpegVersion()
+    {
+        static const QString version = readFFmpegVersion();
+        return version;
+    }
+
 private:
 
+    static QString readFFmpegVersion()
+    {
+        QProcess process;
+        process.start("ffmpeg", {"-version"});
+        if (!process.waitForFinished(5000)) { return {}; }
+        return QString::fromUtf8(process.readAllStandardOutput()).section('\n', 0, 0).trimmed();
+    }
+
     static bool checkFFmpeg()
     {
 #ifdef _WIN32
@@ -0,0 +1,21 @@
+#ifndef FORMAT_CONVERTER_ENCODERSETTINGS_H
+#define FORMAT_CONVERTER_ENCODERSETTINGS_H
+
+#include <QString>
+
+// encoder tuning of one format inside a profile. unset values are left to encoder defaults and
+// values that don't apply to the codec of the format are ignored by argument builders
+struct EncoderSettings {
+    QString preset;             // x264/x265 -preset
+    int crf = -1;               // x264/x265/vp9 -crf
+    int quality = -1;           // -q:v / -q:a (mpeg4, mpeg2, jpeg, lame, vorbis), -quality for webp
+    int cpuUsed = -1;           // vp9 -cpu-used, higher is faster
+    bool rowMt = false;         // vp9 -row-mt, row based multithreading
+    QString deadline;           // vp9 -deadline (good, realtime)
+    bool lossless = false;      // x265 and webp lossless mode
+    int compressionLevel = -1;  // lame and webp -compression_level, speed of the algorithm
+    int threads = 0;            // -threads, 0 lets encoder decide
+};
+
+
+#endif //FORMAT_CONVERTER_ENCODERSETTINGS_H
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef FORMAT_CONVERTER_FILEUTILS_H
+#define FORMAT_CONVERTER_FILEUTILS_H
+
+#include <cstdio>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace FileUtils {
+
+    // copy-on-write clone of the file, only some filesystems support it (btrfs, xfs)
+    inline bool reflink(const QString& sourcePath, const QString& targetPath)
+    {
+#ifdef Q_OS_LINUX
+        int source = ::open(QFile::encodeName(sourcePath).constData(), O_RDONLY | O_CLOEXEC);
+        if (source < 0) { return false; }
+
+        int target = ::open(QFile::encodeName(targetPath).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (target < 0) {
+            ::close(source);
+            return false;
+        }
+
+        bool cloned = ::ioctl(target, FICLONE, source) == 0;
+        ::close(source);
+        ::close(target);
+        if (!cloned) { ::unlink(QFile::encodeName(targetPath).constData()); }
+        return cloned;
+#else
+        return false;
+#endif
+    }
+
+    // target is a file of its own, so changing either one never changes the other. copy-on-write
+    // clone shares the data blocks until one of them is written
+    inline bool cloneOrCopy(const QString& sourcePath, const QString& targetPath)
+    {
+        if (QFile::exists(targetPath) && !QFile::remove(targetPath)) { return false; }
+
+        return reflink(sourcePath, targetPath) || QFile::copy(sourcePath, targetPath);
+    }
+
+    // hidden name next to the file, outputs are written there until the job has succeeded.
+    // suffix is kept as ffmpeg and exiftool pick the format from it
+    inline QString partialFilePath(const QString& filePath)
+    {
+        QFileInfo info(filePath);
+        return info.dir().filePath("." + info.completeBaseName() + ".part." + info.suffix());
+    }
+
+    // target is replaced in one step where the platform allows it, so it is never missing
+    // or half written
+    inline bool replaceFile(const QString& sourcePath, const QString& targetPath)
+    {
+#ifdef Q_OS_UNIX
+        return std::rename(QFile::encodeName(sourcePath).constData(), QFile::encodeName(targetPath).constData()) == 0;
+#else
+        if (QFile::exists(targetPath) && !QFile::remove(targetPath)) { return false; }
+        return QFile::rename(sourcePath, targetPath);
+#endif
+    }
+}
+
+
+#endif //FORMAT_CONVERTER_FILEUTILS_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef FORMAT_CONVERTER_MEDIAINFO_H
+#define FORMAT_CONVERTER_MEDIAINFO_H
+
+#include <QString>
+#include <QVector>
+
+struct StreamInfo {
+    int index = 0;
+    QString codecType;      // video, audio, subtitle, data, attachment
+    QString codecName;
+    qint64 bitRate = 0;     // 0 when container doesn't tell
+
+    // video
+    int width = 0;
+    int height = 0;
+    QString pixelFormat;
+
+    // audio
+    int sampleRate = 0;
+    int channels = 0;
+};
+
+// parsed ffprobe result of one input file
+struct MediaInfo {
+    bool valid = false;
+    double duration = 0.0;
+    qint64 bitRate = 0;
+    QString formatName;
+    QVector<StreamInfo> streams;
+
+    // conversions map the first stream of each type explicitly (0:v:0, 0:a:0), ffmpeg would
+    // pick the stream with highest resolution or most channels on its own
+    const StreamInfo* firstStream(const QString& codecType) const
+    {
+        for (const StreamInfo& stream : streams) {
+            if (stream.codecType == codecType) {
+                return &stream;
+            }
+        }
+        return nullptr;
+    }
+};
+
+
+#endif //FORMAT_CONVERTER_MEDIAINFO_H
@@ -0,0 +1,130 @@
+#ifndef FORMAT_CONVERTER_PROCESSPRIORITY_H
+#define FORMAT_CONVERTER_PROCESSPRIORITY_H
+
+#include <QList>
+#include <QProcess>
+#include <QString>
+#include <QStringList>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+// scheduling class of a job. interactive jobs go before queued normal and background jobs
+enum class JobPriority {
+    INTERACTIVE,        // started from the window, runs at the priority of the converter
+    NORMAL,
+    BACKGROUND          // batch work which should give cpu and disk to everything else
+};
+
+// names used in job journal and rules files
+inline QString jobPriorityToString(JobPriority priority)
+{
+    switch (priority) {
+        case JobPriority::INTERACTIVE:  return "interactive";
+        case JobPriority::BACKGROUND:   return "background";
+        default:                        return "normal";
+    }
+}
+
+inline bool jobPriorityFromString(const QString& name, JobPriority* priority)
+{
+    if (name == "interactive")      { *priority = JobPriority::INTERACTIVE; }
+    else if (name == "normal")      { *priority = JobPriority::NORMAL; }
+    else if (name == "background")  { *priority = JobPriority::BACKGROUND; }
+    else                            { return false; }
+    return true;
+}
+
+// how a spawned process is scheduled. values are applied in the child before exec, so the
+// converter itself keeps its own priority
+struct ProcessPriority {
+    int nice = 0;               // added to niceness of the converter, only raising is allowed
+    int ioClass = 0;            // 0 keeps io priority, 2 best-effort, 3 idle
+    int ioLevel = 4;            // 0 (highest) - 7 of best-effort class
+    QList<int> cpus;            // cores the process may run on, empty allows all
+
+    bool isDefault() const { return nice == 0 && ioClass == 0 && cpus.isEmpty(); }
+};
+
+namespace ProcessPriorities {
+
+    inline ProcessPriority forJob(JobPriority priority, const QList<int>& cpus)
+    {
+        ProcessPriority processPriority;
+        processPriority.cpus = cpus;
+        switch (priority) {
+            case JobPriority::INTERACTIVE:
+                break;
+            case JobPriority::NORMAL:
+                processPriority.nice = 5;
+                break;
+            case JobPriority::BACKGROUND:
+                processPriority.nice = 15;
+                processPriority.ioClass = 2;
+                processPriority.ioLevel = 7;
+                break;
+        }
+        return processPriority;
+    }
+
+    // cpu list like taskset: 0-3,8,10-11. returns false if it is invalid
+    inline bool parseCpus(const QString& text, QList<int>* cpus)
+    {
+        cpus->clear();
+        for (const QString& part : text.split(',', Qt::SkipEmptyParts)) {
+            const QStringList range = part.trimmed().split('-');
+            bool firstValid = false;
+            bool lastValid = false;
+            int first = range.value(0).toInt(&firstValid);
+            int last = range.size() > 1 ? range.value(1).toInt(&lastValid) : first;
+            if (range.size() == 1) { lastValid = firstValid; }
+            if (!firstValid || !lastValid || range.size() > 2 || first < 0 || last < first || last >= 1024) {
+                return false;
+            }
+            for (int cpu = first; cpu <= last; cpu++) {
+                if (!cpus->contains(cpu)) { cpus->append(cpu); }
+            }
+        }
+        return !cpus->isEmpty();
+    }
+
+    // must be called before process is started. modifier runs between fork and exec so it only
+    // makes system calls, cpu set is built here in the parent. failures are ignored, process is
+    // better run with default scheduling than not at all
+    inline void apply(QProcess* process, const ProcessPriority& priority)
+    {
+        if (priority.isDefault()) { return; }
+#if defined(Q_OS_LINUX)
+        const int niceIncrement = priority.nice;
+        // ioprio_set has no glibc wrapper, class is above IOPRIO_CLASS_SHIFT (13)
+        const int ioPriority = priority.ioClass > 0 ? (priority.ioClass << 13) | priority.ioLevel : 0;
+        const bool setAffinity = !priority.cpus.isEmpty();
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu : priority.cpus) {
+            CPU_SET(cpu, &cpuSet);
+        }
+        process->setChildProcessModifier([niceIncrement, ioPriority, setAffinity, cpuSet]() {
+            if (niceIncrement > 0) { (void) ::nice(niceIncrement); }
+            if (ioPriority > 0) { ::syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, ioPriority); }
+            if (setAffinity) { ::sched_setaffinity(0, sizeof(cpuSet), &cpuSet); }
+        });
+#elif defined(Q_OS_UNIX)
+        // io priority and affinity are linux only
+        const int niceIncrement = priority.nice;
+        process->setChildProcessModifier([niceIncrement]() {
+            if (niceIncrement > 0) { (void) ::nice(niceIncrement); }
+        });
+#else
+        Q_UNUSED(process);
+#endif
+    }
+}
+
+
+#endif //FORMAT_CONVERTER_PROCESSPRIORITY_H
\ No newline at end of file
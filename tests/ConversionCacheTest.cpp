@@ -0,0 +1,156 @@
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "ConversionCache.h"
+
+namespace {
+
+    bool writeFile(const QString& filePath, const QByteArray& data)
+    {
+        QFile file(filePath);
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+    }
+
+    QByteArray readFile(const QString& filePath)
+    {
+        QFile file(filePath);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+}
+
+class ConversionCacheTest : public QObject {
+    Q_OBJECT
+
+private:
+
+    // key is given to callback from event loop
+    static QString keyOf(ConversionCache& cache, const QString& inputFilePath, const QStringList& keyArgs)
+    {
+        QString key;
+        bool called = false;
+        cache.computeKey(inputFilePath, keyArgs, [&key, &called](const QString& computed) {
+            key = computed;
+            called = true;
+        });
+        if (!QTest::qWaitFor([&called]() { return called; }, 5000)) { return "timeout"; }
+        return key;
+    }
+
+private slots:
+
+    void normalizeArgs_data()
+    {
+        QTest::addColumn<QStringList>("args");
+        QTest::addColumn<QStringList>("expected");
+
+        QTest::newRow("convert")
+                << QStringList{"-y", "-i", "/in/a.mkv", "-c:v", "libx264", "/out/a.mp4"}
+                << QStringList{"-y", "-i", "{input}", "-c:v", "libx264", "{output}.mp4"};
+        QTest::newRow("upper case suffix")
+                << QStringList{"-i", "/in/a.mkv", "/out/a.MP4"}
+                << QStringList{"-i", "{input}", "{output}.mp4"};
+        QTest::newRow("paths inside other args stay")
+                << QStringList{"-i", "/in/a.mkv", "-metadata", "comment=/in/a.mkv", "/out/a.mp4"}
+                << QStringList{"-i", "{input}", "-metadata", "comment=/in/a.mkv", "{output}.mp4"};
+    }
+
+    void normalizeArgs()
+    {
+        QFETCH(QStringList, args);
+        QFETCH(QStringList, expected);
+
+        QCOMPARE(ConversionCache::normalizeArgs(args, "/in/a.mkv", args.last()), expected);
+    }
+
+    // key follows content and arguments, not the path
+    void computeKey()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        ConversionCache cache(dir.filePath("cache"), 1024 * 1024);
+        QVERIFY(cache.isValid());
+
+        QVERIFY(writeFile(dir.filePath("a.wav"), "same content"));
+        QVERIFY(writeFile(dir.filePath("b.wav"), "same content"));
+        QVERIFY(writeFile(dir.filePath("c.wav"), "other content"));
+        const QStringList args{"-i", "{input}", "{output}.mp3"};
+
+        const QString key = keyOf(cache, dir.filePath("a.wav"), args);
+        QCOMPARE(key.size(), qsizetype(64));
+        QCOMPARE(keyOf(cache, dir.filePath("b.wav"), args), key);
+        QVERIFY(keyOf(cache, dir.filePath("c.wav"), args) != key);
+        QVERIFY(keyOf(cache, dir.filePath("a.wav"), args + QStringList{"-b:a", "320k"}) != key);
+        QCOMPARE(keyOf(cache, dir.filePath("missing.wav"), args), QString());
+    }
+
+    // restored output is a copy, changing it in place leaves the entry alone
+    void storeAndRestore()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        ConversionCache cache(dir.filePath("cache"), 1024 * 1024);
+        const QString key = "ab12cd34";
+
+        QVERIFY(!cache.restore(key, dir.filePath("restored.mp3")));
+
+        QVERIFY(writeFile(dir.filePath("output.mp3"), "encoded"));
+        cache.store(key, dir.filePath("output.mp3"));
+        QVERIFY(cache.restore(key, dir.filePath("restored.mp3")));
+        QCOMPARE(readFile(dir.filePath("restored.mp3")), QByteArray("encoded"));
+
+        QFile restored(dir.filePath("restored.mp3"));
+        QVERIFY(restored.open(QIODevice::ReadWrite));
+        restored.write("stripped");
+        restored.close();
+
+        QVERIFY(cache.restore(key, dir.filePath("again.mp3")));
+        QCOMPARE(readFile(dir.filePath("again.mp3")), QByteArray("encoded"));
+    }
+
+    // restore counts as use, so entry stored earlier outlives one stored later
+    void evictsLeastRecentlyUsed()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        ConversionCache cache(dir.filePath("cache"), 25);
+
+        QVERIFY(writeFile(dir.filePath("output.mp3"), "0123456789"));
+        cache.store("aa11", dir.filePath("output.mp3"));
+        cache.store("bb22", dir.filePath("output.mp3"));
+        QVERIFY(cache.restore("aa11", dir.filePath("restored.mp3")));
+        cache.store("cc33", dir.filePath("output.mp3"));
+
+        QVERIFY(!cache.restore("bb22", dir.filePath("restored.mp3")));
+        QVERIFY(cache.restore("aa11", dir.filePath("restored.mp3")));
+        QVERIFY(cache.restore("cc33", dir.filePath("restored.mp3")));
+    }
+
+    // order of entries left by an earlier run comes from their modification times
+    void evictsByEarlierUse()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(writeFile(dir.filePath("output.mp3"), "0123456789"));
+        {
+            ConversionCache cache(dir.filePath("cache"), 25);
+            cache.store("aa11", dir.filePath("output.mp3"));
+            cache.store("bb22", dir.filePath("output.mp3"));
+        }
+
+        // entry of second output was used an hour ago
+        QFile entry(dir.filePath("cache/bb/bb22"));
+        QVERIFY(entry.open(QIODevice::ReadOnly));
+        QVERIFY(entry.setFileTime(QDateTime::currentDateTime().addSecs(-3600), QFileDevice::FileModificationTime));
+        entry.close();
+
+        ConversionCache cache(dir.filePath("cache"), 25);
+        cache.store("cc33", dir.filePath("output.mp3"));
+
+        QVERIFY(!cache.restore("bb22", dir.filePath("restored.mp3")));
+        QVERIFY(cache.restore("aa11", dir.filePath("restored.mp3")));
+    }
+};
+
+QTEST_GUILESS_MAIN(ConversionCacheTest)
+#include "ConversionCacheTest.moc"
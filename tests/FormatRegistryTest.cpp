@@ -0,0 +1,102 @@
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtEndian>
+
+#include "FormatRegistry.h"
+
+namespace {
+
+    QByteArray bigEndian32(quint32 value)
+    {
+        QByteArray bytes(4, 0);
+        qToBigEndian<quint32>(value, bytes.data());
+        return bytes;
+    }
+
+    // first box of 256 bytes starts like an ico header
+    QByteArray box256(const char* type, const QByteArray& payload)
+    {
+        QByteArray box = bigEndian32(256) + type + payload;
+        return box + QByteArray(256 - box.size(), '\0');
+    }
+}
+
+class FormatRegistryTest : public QObject {
+    Q_OBJECT
+
+private slots:
+
+    void fromSuffix()
+    {
+        QCOMPARE(FormatRegistry::fromSuffix("MP4").label, QString("mp4"));
+        QVERIFY(FormatRegistry::fromSuffix("jpg").fileType == FileType::IMAGE);
+        QVERIFY(FormatRegistry::fromSuffix("xyz").fileType == FileType::UNKNOWN);
+        QCOMPARE(FormatRegistry::fromPath("/tmp/song.Flac").label, QString("flac"));
+        QCOMPARE(FormatRegistry::canonical(FileType::IMAGE, static_cast<int>(ImageFormats::JPEG)).label,
+                 QString("jpeg"));
+    }
+
+    void sniff_data()
+    {
+        QTest::addColumn<QByteArray>("header");
+        QTest::addColumn<QString>("hint");
+        QTest::addColumn<QString>("expected");
+
+        QTest::newRow("jpeg") << QByteArray("\xFF\xD8\xFF\xE0", 4) << "" << "jpeg";
+        QTest::newRow("png") << QByteArray("\x89PNG\r\n\x1A\n", 8) << "" << "png";
+        QTest::newRow("gif") << QByteArray("GIF89a") << "" << "gif";
+        QTest::newRow("tiff") << QByteArray("II*\0", 4) << "" << "tif";
+        QTest::newRow("ico") << QByteArray("\0\0\x01\0\x01\0\x10\x10\0\0\x01\0\x20\0\x68\x04\0\0\x16\0\0\0", 22)
+                             << "" << "ico";
+        QTest::newRow("ico without images")
+                << QByteArray("\0\0\x01\0\0\0\x10\x10\0\0\x01\0\x20\0\0\0\0\0\0\0\0\0", 22) << "mp4" << "mp4";
+        QTest::newRow("ftyp box of 256 bytes") << box256("ftyp", "isom") << "" << "mp4";
+        QTest::newRow("ftyp box of 256 bytes as mov") << box256("ftyp", "qt  ") << "" << "mov";
+        QTest::newRow("moov box of 256 bytes") << box256("moov", bigEndian32(108) + "mvhd") << "m4v" << "m4v";
+        QTest::newRow("m4a brand") << QByteArray("\0\0\0\x20" "ftypM4A ", 12) << "" << "m4a";
+        QTest::newRow("heif brand") << QByteArray("\0\0\0\x18" "ftypheic", 12) << "mp4" << "heif";
+        QTest::newRow("mp4 as m4v") << QByteArray("\0\0\0\x18" "ftypisom", 12) << "m4v" << "m4v";
+        QTest::newRow("wav") << QByteArray("RIFF\0\0\0\0WAVE", 12) << "" << "wav";
+        QTest::newRow("webp") << QByteArray("RIFF\0\0\0\0WEBP", 12) << "" << "webp";
+        QTest::newRow("webm") << QByteArray("\x1A\x45\xDF\xA3\x87\x42\x82\x84webm", 12) << "mkv" << "webm";
+        QTest::newRow("mkv") << QByteArray("\x1A\x45\xDF\xA3\x8B\x42\x82\x88matroska", 16) << "" << "mkv";
+        QTest::newRow("padded doctype after version")
+                << QByteArray("\x1A\x45\xDF\xA3\x8C\x42\x86\x81\x01\x42\x82\x85webm\0", 17) << "" << "webm";
+        QTest::newRow("webm outside doctype")
+                << QByteArray("\x1A\x45\xDF\xA3\x8B\x42\x82\x88matroska\xEC\x84webm", 22) << "webm" << "mkv";
+        QTest::newRow("id3 mp3") << QByteArray("ID3\x04\0\0", 6) << "" << "mp3";
+        QTest::newRow("id3 aac") << QByteArray("ID3\x04\0\0", 6) << "aac" << "aac";
+        QTest::newRow("adts") << QByteArray("\xFF\xF1\x50\x80", 4) << "" << "aac";
+        QTest::newRow("mpeg audio") << QByteArray("\xFF\xFB\x90\x64", 4) << "" << "mp3";
+        QTest::newRow("unknown keeps hint") << QByteArray("fLaX") << "flac" << "flac";
+    }
+
+    void sniff()
+    {
+        QFETCH(QByteArray, header);
+        QFETCH(QString, hint);
+        QFETCH(QString, expected);
+
+        FormatInfo hintFormat = FormatRegistry::fromSuffix(hint);
+        QCOMPARE(FormatRegistry::sniff(header, hintFormat).label, expected);
+    }
+
+    // content wins over a wrong suffix
+    void detect()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        QFile file(dir.filePath("clip.mp3"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(box256("ftyp", "qt  "));
+        file.close();
+
+        QCOMPARE(FormatRegistry::detect(file.fileName()).label, QString("mov"));
+        QCOMPARE(FormatRegistry::detect(dir.filePath("missing.png")).label, QString("png"));
+    }
+};
+
+QTEST_GUILESS_MAIN(FormatRegistryTest)
+#include "FormatRegistryTest.moc"
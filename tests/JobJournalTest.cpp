@@ -0,0 +1,177 @@
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "JobJournal.h"
+#include "utils/FileUtils.h"
+
+namespace {
+
+    bool writeFile(const QString& filePath, const QByteArray& data)
+    {
+        QFile file(filePath);
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+    }
+}
+
+class JobJournalTest : public QObject {
+    Q_OBJECT
+
+private:
+
+    QTemporaryDir dir_;
+
+    QString journalPath() const { return dir_.filePath("journal.jsonl"); }
+
+    ConversionJob job(const QString& name) const
+    {
+        ConversionJob job;
+        job.inputFilePath = dir_.filePath(name + ".wav");
+        job.outputFilePath = dir_.filePath(name + ".mp3");
+        job.profile = "balanced";
+        return job;
+    }
+
+    // converts job like converter does and records it as done
+    void complete(JobJournal& journal, const ConversionJob& job)
+    {
+        journal.record(job, State::QUEUED);
+        journal.record(job, State::RUNNING);
+        QVERIFY(writeFile(job.outputFilePath, "encoded " + job.inputFilePath.toUtf8()));
+        journal.record(job, State::DONE);
+    }
+
+private slots:
+
+    void init()
+    {
+        QVERIFY(dir_.isValid());
+        QFile::remove(journalPath());
+        QVERIFY(writeFile(job("song").inputFilePath, "pcm samples"));
+        QFile::remove(job("song").outputFilePath);
+    }
+
+    void doneJobIsReplayed()
+    {
+        {
+            JobJournal journal(journalPath());
+            QString errorMessage;
+            QVERIFY2(journal.open(&errorMessage), qPrintable(errorMessage));
+            QVERIFY(!journal.isDone(job("song")));
+            complete(journal, job("song"));
+            QVERIFY(journal.isDone(job("song")));
+        }
+
+        JobJournal journal(journalPath());
+        QString errorMessage;
+        QVERIFY2(journal.open(&errorMessage), qPrintable(errorMessage));
+        QVERIFY(journal.isDone(job("song")));
+        QVERIFY(journal.unfinishedJobs().isEmpty());
+    }
+
+    // other settings give other output, so earlier completion doesn't count
+    void changedSettingsAreNotDone()
+    {
+        JobJournal journal(journalPath());
+        QString errorMessage;
+        QVERIFY2(journal.open(&errorMessage), qPrintable(errorMessage));
+        complete(journal, job("song"));
+
+        ConversionJob otherProfile = job("song");
+        otherProfile.profile = "fast";
+        QVERIFY(!journal.isDone(otherProfile));
+
+        ConversionJob withMetadata = job("song");
+        withMetadata.saveMetadata = true;
+        QVERIFY(!journal.isDone(withMetadata));
+
+        ConversionJob otherEngine = job("song");
+        otherEngine.engine = Engine::LIBAV;
+        QVERIFY(!journal.isDone(otherEngine));
+    }
+
+    void changedFilesAreNotDone()
+    {
+        JobJournal journal(journalPath());
+        QString errorMessage;
+        QVERIFY2(journal.open(&errorMessage), qPrintable(errorMessage));
+
+        complete(journal, job("song"));
+        QVERIFY(writeFile(job("song").outputFilePath, "edited afterwards"));
+        QVERIFY(!journal.isDone(job("song")));
+
+        complete(journal, job("song"));
+        QVERIFY(QFile::remove(job("song").outputFilePath));
+        QVERIFY(!journal.isDone(job("song")));
+
+        complete(journal, job("song"));
+        QVERIFY(writeFile(job("song").inputFilePath, "other pcm samples"));
+        QVERIFY(!journal.isDone(job("song")));
+    }
+
+    // queued and running jobs come back in queue order, partial outputs are removed and
+    // failed jobs dropped
+    void unfinishedJobsAreResumed()
+    {
+        ConversionJob queued = job("queued");
+        queued.priority = JobPriority::BACKGROUND;
+        ConversionJob running = job("running");
+        running.type = JobType::FAN_OUT;
+        running.extraOutputFilePaths = {dir_.filePath("running.flac")};
+        ConversionJob failed = job("failed");
+
+        {
+            JobJournal journal(journalPath());
+            QString errorMessage;
+            QVERIFY2(journal.open(&errorMessage), qPrintable(errorMessage));
+            journal.record(queued, State::QUEUED);
+            journal.record(running, State::QUEUED);
+            journal.record(failed, State::QUEUED);
+            journal.record(running, State::RUNNING);
+            journal.record(failed, State::RUNNING);
+            journal.record(failed, State::FAILED);
+        }
+        QVERIFY(writeFile(FileUtils::partialFilePath(running.outputFilePath), "half"));
+        QVERIFY(writeFile(FileUtils::partialFilePath(running.extraOutputFilePaths.first()), "half"));
+
+        JobJournal journal(journalPath());
+        QString errorMessage;
+        QVERIFY2(journal.open(&errorMessage), qPrintable(errorMessage));
+
+        const QList<ConversionJob> jobs = journal.unfinishedJobs();
+        QCOMPARE(jobs.size(), qsizetype(2));
+        QCOMPARE(jobs[0].outputFilePath, queued.outputFilePath);
+        QVERIFY(jobs[0].priority == JobPriority::BACKGROUND);
+        QCOMPARE(jobs[1].outputFilePath, running.outputFilePath);
+        QVERIFY(jobs[1].type == JobType::FAN_OUT);
+        QCOMPARE(jobs[1].extraOutputFilePaths, running.extraOutputFilePaths);
+        QCOMPARE(jobs[1].profile, QString("balanced"));
+
+        QVERIFY(!QFile::exists(FileUtils::partialFilePath(running.outputFilePath)));
+        QVERIFY(!QFile::exists(FileUtils::partialFilePath(running.extraOutputFilePaths.first())));
+    }
+
+    // crash can cut the last line
+    void truncatedLineIsSkipped()
+    {
+        {
+            JobJournal journal(journalPath());
+            QString errorMessage;
+            QVERIFY2(journal.open(&errorMessage), qPrintable(errorMessage));
+            complete(journal, job("song"));
+        }
+        QFile file(journalPath());
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+        file.write("{\"state\":\"queued\",\"input\":\"");
+        file.close();
+
+        JobJournal journal(journalPath());
+        QString errorMessage;
+        QVERIFY2(journal.open(&errorMessage), qPrintable(errorMessage));
+        QVERIFY(journal.isDone(job("song")));
+        QVERIFY(journal.unfinishedJobs().isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(JobJournalTest)
+#include "JobJournalTest.moc"
@@ -0,0 +1,336 @@
+#include <atomic>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtEndian>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "FormatRegistry.h"
+#include "MetadataStripper.h"
+
+namespace {
+
+    QByteArray bigEndian16(quint16 value)
+    {
+        QByteArray bytes(2, 0);
+        qToBigEndian<quint16>(value, bytes.data());
+        return bytes;
+    }
+
+    QByteArray bigEndian32(quint32 value)
+    {
+        QByteArray bytes(4, 0);
+        qToBigEndian<quint32>(value, bytes.data());
+        return bytes;
+    }
+
+    QByteArray littleEndian32(quint32 value)
+    {
+        QByteArray bytes(4, 0);
+        qToLittleEndian<quint32>(value, bytes.data());
+        return bytes;
+    }
+
+    // marker and length which counts itself
+    QByteArray jpegSegment(uchar marker, const QByteArray& payload)
+    {
+        return QByteArray("\xFF", 1) + char(marker) + bigEndian16(payload.size() + 2) + payload;
+    }
+
+    // crc isn't checked by the stripper
+    QByteArray pngChunk(const char* type, const QByteArray& payload)
+    {
+        return bigEndian32(payload.size()) + type + payload + QByteArray(4, '\x5A');
+    }
+
+    QByteArray webpChunk(const char* fourcc, const QByteArray& payload)
+    {
+        QByteArray chunk = fourcc + littleEndian32(payload.size()) + payload;
+        if (payload.size() & 1) { chunk.append('\0'); }
+        return chunk;
+    }
+
+    QByteArray riff(const QByteArray& chunks)
+    {
+        return "RIFF" + littleEndian32(4 + chunks.size()) + "WEBP" + chunks;
+    }
+
+    // ID3v2 header with syncsafe size of the frames following it
+    QByteArray id3v2Header(const QByteArray& frames)
+    {
+        const int size = frames.size();
+        QByteArray header("ID3\x03\0\0", 6);
+        header += char((size >> 21) & 0x7F);
+        header += char((size >> 14) & 0x7F);
+        header += char((size >> 7) & 0x7F);
+        header += char(size & 0x7F);
+        return header;
+    }
+
+    QByteArray mp3Frames()
+    {
+        return QByteArray("\xFF\xFB\x90\x64", 4) + QByteArray(200, '\x11') + QByteArray("\xFF\xFB\x90\x64", 4)
+               + QByteArray(200, '\x22');
+    }
+
+    QByteArray isoBox(const char* type, const QByteArray& payload)
+    {
+        return bigEndian32(8 + payload.size()) + type + payload;
+    }
+
+    // moov with one track whose only chunk is at chunkOffset. metadata adds udta to moov and
+    // meta to the track
+    QByteArray moov(quint32 chunkOffset, bool metadata)
+    {
+        const QByteArray chunkOffsets = isoBox("stco", bigEndian32(0) + bigEndian32(1) + bigEndian32(chunkOffset));
+        const QByteArray media = isoBox("mdia", isoBox("minf", isoBox("stbl", chunkOffsets)));
+        const QByteArray trackMeta = metadata ? isoBox("meta", QByteArray(12, 'm')) : QByteArray();
+        const QByteArray track = isoBox("trak", trackMeta + media);
+        const QByteArray userData = metadata ? isoBox("udta", isoBox("\xA9nam", "title")) : QByteArray();
+        return isoBox("moov", isoBox("mvhd", QByteArray(20, '\0')) + userData + track);
+    }
+
+    QByteArray ftyp()
+    {
+        return isoBox("ftyp", "isom" + bigEndian32(0x200) + "isommp41");
+    }
+
+    bool writeFile(const QString& filePath, const QByteArray& data)
+    {
+        QFile file(filePath);
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+    }
+
+    QByteArray readFile(const QString& filePath)
+    {
+        QFile file(filePath);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+}
+
+class MetadataStripperTest : public QObject {
+    Q_OBJECT
+
+private:
+
+    QTemporaryDir dir_;
+
+    // strips input written to a file named by suffix and returns the output, empty on failure
+    QByteArray strip(const QByteArray& input, const QString& suffix, QString* errorMessage = nullptr)
+    {
+        const QString inputFilePath = dir_.filePath("input." + suffix);
+        const QString outputFilePath = dir_.filePath("output." + suffix);
+        QFile::remove(outputFilePath);
+        if (!writeFile(inputFilePath, input)) { return {}; }
+
+        std::atomic_bool cancelled(false);
+        QString error;
+        bool stripped = MetadataStripper::strip(inputFilePath, outputFilePath, FormatRegistry::fromSuffix(suffix),
+                                                cancelled, &error);
+        if (errorMessage) { *errorMessage = error; }
+        return stripped ? readFile(outputFilePath) : QByteArray();
+    }
+
+private slots:
+
+    void initTestCase()
+    {
+        QVERIFY(dir_.isValid());
+    }
+
+    void canStrip()
+    {
+        QVERIFY(MetadataStripper::canStrip(FormatRegistry::fromSuffix("jpg")));
+        QVERIFY(MetadataStripper::canStrip(FormatRegistry::fromSuffix("png")));
+        QVERIFY(MetadataStripper::canStrip(FormatRegistry::fromSuffix("webp")));
+        QVERIFY(MetadataStripper::canStrip(FormatRegistry::fromSuffix("mp3")));
+        QVERIFY(MetadataStripper::canStrip(FormatRegistry::fromSuffix("mp4")));
+        QVERIFY(MetadataStripper::canStrip(FormatRegistry::fromSuffix("mov")));
+        QVERIFY(MetadataStripper::canStrip(FormatRegistry::fromSuffix("m4a")));
+        QVERIFY(!MetadataStripper::canStrip(FormatRegistry::fromSuffix("gif")));
+        QVERIFY(!MetadataStripper::canStrip(FormatRegistry::fromSuffix("tiff")));
+        QVERIFY(!MetadataStripper::canStrip(FormatRegistry::fromSuffix("flac")));
+    }
+
+    void jpegDropsMetadataSegments()
+    {
+        const QByteArray soi("\xFF\xD8", 2);
+        const QByteArray jfif = jpegSegment(0xE0, QByteArray("JFIF\0\x01\x01\0\0\x01\0\x01\0\0", 14));
+        const QByteArray exif = jpegSegment(0xE1, QByteArray("Exif\0\0MM\0*", 10));
+        const QByteArray comment = jpegSegment(0xFE, "comment");
+        const QByteArray quantization = jpegSegment(0xDB, QByteArray("\0\x01\x02", 3));
+        const QByteArray scanHeader = jpegSegment(0xDA, QByteArray("\x01\x01\0\0\x3F\0", 6));
+        // stuffed zero and restart marker are part of entropy coded data
+        const QByteArray scan("\x12\xFF\x00\x34\xFF\xD0\x56", 7);
+        const QByteArray eoi("\xFF\xD9", 2);
+
+        const QByteArray input = soi + jfif + exif + comment + quantization + scanHeader + scan + eoi + "trailer";
+        QCOMPARE(strip(input, "jpg"), soi + jfif + quantization + scanHeader + scan + eoi);
+    }
+
+    void jpegKeepsAdobeSegment()
+    {
+        const QByteArray soi("\xFF\xD8", 2);
+        const QByteArray adobe = jpegSegment(0xEE, QByteArray("Adobe\0\x64\0\0\0\0\x01", 12));
+        const QByteArray xmp = jpegSegment(0xE1, "http://ns.adobe.com/xap/1.0/");
+        const QByteArray eoi("\xFF\xD9", 2);
+
+        QCOMPARE(strip(soi + xmp + adobe + eoi, "jpg"), soi + adobe + eoi);
+    }
+
+    void jpegRejectsTruncatedSegment()
+    {
+        QString errorMessage;
+        const QByteArray input = QByteArray("\xFF\xD8\xFF\xE1\x01\x00", 6) + "short";
+        QVERIFY(strip(input, "jpg", &errorMessage).isEmpty());
+        QVERIFY(errorMessage.contains("truncated"));
+    }
+
+    void pngDropsMetadataChunks()
+    {
+        const QByteArray signature("\x89PNG\r\n\x1A\n", 8);
+        const QByteArray header = pngChunk("IHDR", QByteArray(13, '\x01'));
+        const QByteArray text = pngChunk("tEXt", QByteArray("Comment\0hello", 13));
+        const QByteArray icc = pngChunk("iCCP", "profile");
+        const QByteArray time = pngChunk("tIME", QByteArray(7, '\x02'));
+        const QByteArray image = pngChunk("IDAT", "pixels");
+        const QByteArray end = pngChunk("IEND", {});
+
+        QCOMPARE(strip(signature + header + text + icc + image + time + end, "png"),
+                 signature + header + image + end);
+    }
+
+    void pngRejectsMissingEnd()
+    {
+        QString errorMessage;
+        const QByteArray input = QByteArray("\x89PNG\r\n\x1A\n", 8) + pngChunk("IHDR", QByteArray(13, '\x01'));
+        QVERIFY(strip(input, "png", &errorMessage).isEmpty());
+        QVERIFY(!errorMessage.isEmpty());
+    }
+
+    void webpDropsMetadataChunksAndFlags()
+    {
+        // icc, alpha, exif and xmp flags set, canvas size after reserved bytes
+        const QByteArray canvas("\0\0\0\x0F\0\0\x0F\0\0", 9);
+        const QByteArray extended = webpChunk("VP8X", char(0x20 | 0x10 | 0x08 | 0x04) + canvas);
+        const QByteArray icc = webpChunk("ICCP", "icc!");
+        const QByteArray image = webpChunk("VP8L", "odd");
+        const QByteArray exif = webpChunk("EXIF", QByteArray("MM\0*\0\0", 6));
+        const QByteArray xmp = webpChunk("XMP ", "<x:xmpmeta/>");
+
+        const QByteArray strippedExtended = webpChunk("VP8X", char(0x10) + canvas);
+        QCOMPARE(strip(riff(extended + icc + image + exif + xmp), "webp"), riff(strippedExtended + image));
+    }
+
+    void mp3KeepsOnlyAudioFrames()
+    {
+        const QByteArray frames = mp3Frames();
+        const QByteArray title("TIT2\0\0\0\x05\0\0title", 15);
+        const QByteArray leadingTag = id3v2Header(title) + title;
+        const QByteArray id3v1 = "TAG" + QByteArray(125, ' ');
+        const QByteArray ape = QByteArray(16, 'a') + "APETAGEX" + littleEndian32(2000) + littleEndian32(48)
+                               + littleEndian32(1) + littleEndian32(0) + QByteArray(8, '\0');
+
+        QCOMPARE(strip(leadingTag + leadingTag + frames + ape + id3v1, "mp3"), frames);
+    }
+
+    void mp3RejectsFileWithoutFrames()
+    {
+        QString errorMessage;
+        QVERIFY(strip("TAG" + QByteArray(125, ' '), "mp3", &errorMessage).isEmpty());
+        QCOMPARE(errorMessage, QString("MP3 file has no audio frames"));
+    }
+
+    // trailing tags are cut from the file itself
+    void mp3StripsInPlace()
+    {
+        const QString filePath = dir_.filePath("in-place.mp3");
+        const QByteArray frames = mp3Frames();
+        QVERIFY(writeFile(filePath, frames + "TAG" + QByteArray(125, ' ')));
+
+        std::atomic_bool cancelled(false);
+        QString errorMessage;
+        QVERIFY2(MetadataStripper::strip(filePath, filePath, FormatRegistry::fromSuffix("mp3"), cancelled,
+                                         &errorMessage), qPrintable(errorMessage));
+        QCOMPARE(readFile(filePath), frames);
+    }
+
+    // other names of the inode must keep the original content
+    void inPlaceKeepsHardlinks()
+    {
+#ifdef Q_OS_UNIX
+        const QString filePath = dir_.filePath("linked.mp3");
+        const QString linkPath = dir_.filePath("backup.mp3");
+        const QByteArray frames = mp3Frames();
+        const QByteArray original = frames + "TAG" + QByteArray(125, ' ');
+        QVERIFY(writeFile(filePath, original));
+        QFile::remove(linkPath);
+        QCOMPARE(::link(QFile::encodeName(filePath).constData(), QFile::encodeName(linkPath).constData()), 0);
+
+        std::atomic_bool cancelled(false);
+        QString errorMessage;
+        QVERIFY2(MetadataStripper::strip(filePath, filePath, FormatRegistry::fromSuffix("mp3"), cancelled,
+                                         &errorMessage), qPrintable(errorMessage));
+        QCOMPARE(readFile(filePath), frames);
+        QCOMPARE(readFile(linkPath), original);
+#else
+        QSKIP("Hardlinks are tested on unix only");
+#endif
+    }
+
+    // chunk offsets follow mdat when moov in front of it gets smaller
+    void isoBmffRebuildsMoov()
+    {
+        const QByteArray fileType = ftyp();
+        const QByteArray mediaData = isoBox("mdat", "media-sample-data");
+        const QByteArray topLevelMeta = isoBox("meta", QByteArray(24, 'x'));
+        const qint64 inputMoovSize = moov(0, true).size();
+        const qint64 outputMoovSize = moov(0, false).size();
+
+        const QByteArray input = fileType + moov(fileType.size() + inputMoovSize + topLevelMeta.size() + 8, true)
+                                 + topLevelMeta + mediaData;
+        const QByteArray expected = fileType + moov(fileType.size() + outputMoovSize + 8, false) + mediaData;
+        QCOMPARE(strip(input, "mp4"), expected);
+    }
+
+    // moov at the end is rewritten over the old one and offsets of mdat stay
+    void isoBmffStripsMoovAtEndInPlace()
+    {
+        const QString filePath = dir_.filePath("in-place.mp4");
+        const QByteArray fileType = ftyp();
+        const QByteArray mediaData = isoBox("mdat", "media-sample-data");
+        const quint32 chunkOffset = fileType.size() + 8;
+        QVERIFY(writeFile(filePath, fileType + mediaData + moov(chunkOffset, true)));
+
+        std::atomic_bool cancelled(false);
+        QString errorMessage;
+        QVERIFY2(MetadataStripper::strip(filePath, filePath, FormatRegistry::fromSuffix("mp4"), cancelled,
+                                         &errorMessage), qPrintable(errorMessage));
+        QCOMPARE(readFile(filePath), fileType + mediaData + moov(chunkOffset, false));
+    }
+
+    void isoBmffRejectsBrokenFiles()
+    {
+        QString errorMessage;
+        QVERIFY(strip(ftyp() + isoBox("mdat", "data"), "mp4", &errorMessage).isEmpty());
+        QCOMPARE(errorMessage, QString("File has no moov box"));
+
+        const QByteArray input = ftyp() + moov(1000000, true) + isoBox("mdat", "data");
+        QVERIFY(strip(input, "mp4", &errorMessage).isEmpty());
+        QCOMPARE(errorMessage, QString("Chunk offset table points outside of media data"));
+    }
+
+    void rejectsOtherContent()
+    {
+        QString errorMessage;
+        QVERIFY(strip("GIF89a", "png", &errorMessage).isEmpty());
+        QCOMPARE(errorMessage, QString("Not a PNG file"));
+    }
+};
+
+QTEST_GUILESS_MAIN(MetadataStripperTest)
+#include "MetadataStripperTest.moc"
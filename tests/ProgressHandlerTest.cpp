@@ -0,0 +1,106 @@
+#include <QSignalSpy>
+#include <QTest>
+
+#include "ProgressHandler.h"
+
+class ProgressHandlerTest : public QObject {
+    Q_OBJECT
+
+private:
+
+    ProgressHandler* handler_ = nullptr;
+    QList<FfmpegStats> stats_;
+
+private slots:
+
+    void init()
+    {
+        handler_ = new ProgressHandler(this);
+        stats_.clear();
+        connect(handler_, &ProgressHandler::statsUpdated, this, [this](const FfmpegStats& stats) {
+            stats_.append(stats);
+        });
+    }
+
+    void cleanup()
+    {
+        delete handler_;
+        handler_ = nullptr;
+    }
+
+    // chunks from the pipe end anywhere, block is reported once progress line is complete
+    void blockSplitAcrossChunks()
+    {
+        QSignalSpy progress(handler_, &ProgressHandler::updateProgress);
+        handler_->setTotalDuration(4.0);
+
+        handler_->handleFfmpegProgress("frame=120\nfps=29.5\nout_ti");
+        handler_->handleFfmpegProgress("me_us=2000000\ntotal_size=4096\nspeed=1.5x\nprogr");
+        QVERIFY(stats_.isEmpty());
+
+        handler_->handleFfmpegProgress("ess=continue\n");
+        QCOMPARE(stats_.size(), qsizetype(1));
+        QCOMPARE(stats_[0].frame, qint64(120));
+        QCOMPARE(stats_[0].fps, 29.5);
+        QCOMPARE(stats_[0].outTimeUs, qint64(2000000));
+        QCOMPARE(stats_[0].totalSize, qint64(4096));
+        QCOMPARE(stats_[0].speed, 1.5);
+        QVERIFY(!stats_[0].finished);
+
+        QCOMPARE(progress.size(), qsizetype(1));
+        QCOMPARE(progress[0][0].toInt(), 50);
+    }
+
+    // values are N/A before first frame, carriage returns end lines too
+    void unknownValuesAreSkipped()
+    {
+        handler_->handleFfmpegProgress("out_time_ms=1000000\r\nspeed=N/A\r\nfps=N/A\r\nbitrate=N/A\r\n"
+                                       "progress=continue\r\n");
+        QCOMPARE(stats_.size(), qsizetype(1));
+        QCOMPARE(stats_[0].outTimeUs, qint64(1000000));
+        QCOMPARE(stats_[0].speed, 0.0);
+        QCOMPARE(stats_[0].fps, 0.0);
+    }
+
+    void endBlockFinishes()
+    {
+        QSignalSpy progress(handler_, &ProgressHandler::updateProgress);
+        handler_->setTotalDuration(1.0);
+
+        handler_->handleFfmpegProgress("out_time_us=5000000\nprogress=continue\n");
+        QCOMPARE(progress.size(), qsizetype(1));
+        QCOMPARE(progress[0][0].toInt(), 100);
+
+        handler_->handleFfmpegProgress("total_size=1048576\nprogress=end\n");
+        QCOMPARE(stats_.size(), qsizetype(2));
+        QVERIFY(stats_[1].finished);
+        QCOMPARE(stats_[1].totalSize, qint64(1048576));
+        QCOMPARE(progress.size(), qsizetype(1));
+    }
+
+    // segments run side by side so their times add up, finished ones don't count for speed
+    void segmentsAreSummed()
+    {
+        handler_->startSegments(2);
+        handler_->handleSegmentProgress(0, "out_time_us=1000000\ntotal_size=100\nspeed=2.0x\nprogress=continue\n");
+        QCOMPARE(stats_.size(), qsizetype(1));
+        QCOMPARE(stats_[0].outTimeUs, qint64(1000000));
+
+        handler_->handleSegmentProgress(1, "out_time_us=3000000\ntotal_size=300\nspeed=1.0x\nprogress=continue\n");
+        QCOMPARE(stats_.size(), qsizetype(2));
+        QCOMPARE(stats_[1].outTimeUs, qint64(4000000));
+        QCOMPARE(stats_[1].totalSize, qint64(400));
+        QCOMPARE(stats_[1].speed, 3.0);
+
+        handler_->handleSegmentProgress(0, "speed=2.0x\nprogress=end\n");
+        QCOMPARE(stats_.size(), qsizetype(3));
+        QCOMPARE(stats_[2].speed, 1.0);
+
+        // unknown segment is ignored
+        handler_->handleSegmentProgress(5, "progress=continue\n");
+        QCOMPARE(stats_.size(), qsizetype(3));
+    }
+};
+
+QTEST_GUILESS_MAIN(ProgressHandlerTest)
+#include "ProgressHandlerTest.moc"